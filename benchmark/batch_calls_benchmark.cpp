@@ -0,0 +1,70 @@
+/** ==========================================================================
+ * 2014 by KjellKod.cc. This is PUBLIC DOMAIN to use at your own risk and comes
+ * with no warranties. This code is yours to share, use and modify with no
+ * strings attached and no restrictions or obligations.
+ * ============================================================================
+ *
+ * One producer firing inserts into a sorted index behind a concurrent<T>. One by one
+ * every insert shifts the tail of the index. With batch_calls the queued inserts
+ * arrive together, are sorted once and merged into the index in one pass.
+ * ============================================================================*/
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include "benchmark_helper.hpp"
+#include "concurrent.hpp"
+
+using namespace benchmark_helper;
+
+namespace {
+   const size_t kInserts = 100000;
+
+   struct SortedIndex {
+      std::vector<uint64_t> keys;
+
+      void insert(uint64_t key) {
+         keys.insert(std::lower_bound(keys.begin(), keys.end(), key), key);
+      }
+
+      void insert_batch(std::vector<std::tuple<uint64_t>>& calls) {
+         const size_t middle = keys.size();
+         for (auto& call : calls) {
+            keys.push_back(std::get<0>(call));
+         }
+         std::sort(keys.begin() + middle, keys.end());
+         std::inplace_merge(keys.begin(), keys.begin() + middle, keys.end());
+      }
+
+      size_t size() { return keys.size(); }
+   };
+
+   void fill(const std::string& name, bool batched) {
+      concurrent<SortedIndex> index;
+      if (batched) {
+         index.batch_calls(&SortedIndex::insert, &SortedIndex::insert_batch);
+      }
+      std::mt19937_64 random(42);
+      const auto start = clock::now();
+      for (size_t insert = 0; insert < kInserts; ++insert) {
+         index.fire(&SortedIndex::insert, random());
+      }
+      const size_t size = index.call_and_wait(&SortedIndex::size);
+      const auto elapsed = clock::now() - start;
+      print_throughput(name, ops_per_second(size, elapsed));
+      std::printf("%-40s %14.1f calls per worker invocation\n", "",
+                  static_cast<double>(kInserts) / (kInserts - index.fused()));
+   }
+} // namespace
+
+int main() {
+   print_throughput_header("100k fire(&SortedIndex::insert) from one producer");
+   fill("one call per insert", false);
+   fill("batch_calls", true);
+   return 0;
+}
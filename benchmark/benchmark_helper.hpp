@@ -0,0 +1,95 @@
+/** ==========================================================================
+ * 2014 by KjellKod.cc. This is PUBLIC DOMAIN to use at your own risk and comes
+ * with no warranties. This code is yours to share, use and modify with no
+ * strings attached and no restrictions or obligations.
+ * ============================================================================
+ *
+ * Small helpers shared by the benchmark executables. Each benchmark is its own
+ * executable, run it from the build directory, e.g.  ./flat_combining_benchmark
+ * ============================================================================*/
+
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace benchmark_helper {
+   typedef std::chrono::steady_clock clock;
+   typedef std::chrono::nanoseconds nanoseconds;
+
+   inline long long to_ns(clock::duration duration) {
+      return std::chrono::duration_cast<nanoseconds>(duration).count();
+   }
+
+   /// Start 'threads' threads running work(thread_index) and @return the wall time until all are done
+   template<typename Work>
+   clock::duration run_threads(size_t threads, Work work) {
+      std::vector<std::thread> running;
+      auto start = clock::now();
+      for (size_t index = 0; index < threads; ++index) {
+         running.emplace_back([&work, index] { work(index); });
+      }
+      for (auto& thread : running) {
+         thread.join();
+      }
+      return clock::now() - start;
+   }
+
+   /** Latency distribution summary in nanoseconds */
+   struct Percentiles {
+      long long p50;
+      long long p99;
+      long long p999;
+      long long max;
+      long long mean;
+   };
+
+   inline Percentiles percentiles(std::vector<long long> samples) {
+      Percentiles result{0, 0, 0, 0, 0};
+      if (samples.empty()) {
+         return result;
+      }
+      std::sort(samples.begin(), samples.end());
+      auto at = [&samples](double fraction) {
+         size_t index = static_cast<size_t>(fraction * (samples.size() - 1));
+         return samples[index];
+      };
+      long double sum = 0;
+      for (auto sample : samples) {
+         sum += sample;
+      }
+      result.p50 = at(0.50);
+      result.p99 = at(0.99);
+      result.p999 = at(0.999);
+      result.max = samples.back();
+      result.mean = static_cast<long long>(sum / samples.size());
+      return result;
+   }
+
+   inline void print_header(const std::string& title) {
+      std::printf("\n%s\n", title.c_str());
+      std::printf("%-34s %12s %10s %10s %10s %10s\n", "configuration", "ops/s", "p50 ns", "p99 ns", "p99.9 ns", "max ns");
+   }
+
+   inline void print_row(const std::string& name, double ops_per_second, const Percentiles& latency) {
+      std::printf("%-34s %12.0f %10lld %10lld %10lld %10lld\n", name.c_str(), ops_per_second,
+                  latency.p50, latency.p99, latency.p999, latency.max);
+   }
+
+   inline void print_throughput_header(const std::string& title) {
+      std::printf("\n%s\n", title.c_str());
+      std::printf("%-40s %14s\n", "configuration", "ops/s");
+   }
+
+   inline void print_throughput(const std::string& name, double ops_per_second) {
+      std::printf("%-40s %14.0f\n", name.c_str(), ops_per_second);
+   }
+
+   inline double ops_per_second(size_t operations, clock::duration elapsed) {
+      return operations / std::chrono::duration<double>(elapsed).count();
+   }
+} // namespace benchmark_helper
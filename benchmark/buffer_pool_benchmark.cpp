@@ -0,0 +1,70 @@
+/** ==========================================================================
+ * 2014 by KjellKod.cc. This is PUBLIC DOMAIN to use at your own risk and comes
+ * with no warranties. This code is yours to share, use and modify with no
+ * strings attached and no restrictions or obligations.
+ * ============================================================================
+ *
+ * 64 KB frames handed to a concurrent<T> with fire(): copied in a std::vector,
+ * moved in a MoveOnCopy<std::unique_ptr>, or leased from a buffer_pool.
+ * ============================================================================*/
+
+#include <cstring>
+#include <memory>
+#include <vector>
+
+#include "benchmark_helper.hpp"
+#include "buffer_pool.hpp"
+#include "concurrent.hpp"
+#include "moveoncopy.hpp"
+
+using namespace benchmark_helper;
+
+namespace {
+   const size_t kFrameBytes = 64 * 1024;
+   const size_t kFrames = 50000;
+
+   struct Decoder {
+      size_t bytes = 0;
+      void vector_frame(std::vector<char> frame) { bytes += frame[0] + frame.size(); }
+      void unique_frame(MoveOnCopy<std::unique_ptr<char[]>> frame) { bytes += frame.get()[0] + kFrameBytes; }
+      void pooled_frame(pooled_buffer frame) { bytes += frame.data()[0] + frame.size(); }
+      size_t get() { return bytes; }
+   };
+
+   template<typename Produce>
+   void run(const std::string& name, Produce produce) {
+      concurrent<Decoder> decoder;
+      auto start = clock::now();
+      for (size_t frame = 0; frame < kFrames; ++frame) {
+         produce(decoder);
+      }
+      decoder.call(&Decoder::get).get();
+      print_throughput(name, ops_per_second(kFrames, clock::now() - start));
+   }
+} // namespace
+
+int main() {
+   print_throughput_header("64 KB frames -> one concurrent<T>, frames per second");
+   std::vector<char> source(kFrameBytes, 1);
+
+   run("std::vector<char>, copied by bind", [&source](concurrent<Decoder>& decoder) {
+      std::vector<char> frame(source);
+      decoder.fire(&Decoder::vector_frame, frame);
+   });
+   run("unique_ptr<char[]>, one allocation", [&source](concurrent<Decoder>& decoder) {
+      std::unique_ptr<char[]> frame(new char[kFrameBytes]);
+      std::memcpy(frame.get(), source.data(), kFrameBytes);
+      decoder.fire(&Decoder::unique_frame, MoveOnCopy<std::unique_ptr<char[]>>(std::move(frame)));
+   });
+   buffer_pool pool(64, kFrameBytes);
+   run("pooled_buffer", [&source, &pool](concurrent<Decoder>& decoder) {
+      pooled_buffer frame = pool.lease();
+      std::memcpy(frame.data(), source.data(), kFrameBytes);
+      frame.resize(kFrameBytes);
+      decoder.fire(&Decoder::pooled_frame, std::move(frame));
+   });
+   auto stats = pool.stats();
+   std::printf("pool: %zu buffers, peak in use %zu, waited for a buffer %zu times\n",
+               stats.buffers, stats.peak_in_use, stats.exhausted);
+   return 0;
+}
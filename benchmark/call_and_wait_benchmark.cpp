@@ -0,0 +1,83 @@
+/** ==========================================================================
+ * 2014 by KjellKod.cc. This is PUBLIC DOMAIN to use at your own risk and comes
+ * with no warranties. This code is yours to share, use and modify with no
+ * strings attached and no restrictions or obligations.
+ * ============================================================================
+ *
+ * Synchronous round trips to a concurrent<T>: call(...).get() with its packaged_task and
+ * shared state, against call_and_wait with the call and result on the caller's stack.
+ * Latency per round trip, and heap allocations per round trip. The fractions left for
+ * call_and_wait are the std::deque of the shared_queue, a new block every 16 calls.
+ * ============================================================================*/
+
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <string>
+#include <vector>
+
+#include "benchmark_helper.hpp"
+#include "concurrent.hpp"
+
+using namespace benchmark_helper;
+
+namespace {
+   std::atomic<size_t> g_allocations{0};
+   const size_t kRoundTrips = 100000;
+
+   struct Counter {
+      size_t value = 0;
+      size_t add(size_t v) { return value += v; }
+   };
+
+   template<typename RoundTrip>
+   void measure(const std::string& name, RoundTrip round_trip) {
+      concurrent<Counter> counter;
+      for (size_t warmup = 0; warmup < 1000; ++warmup) {
+         round_trip(counter);
+      }
+      std::vector<long long> samples;
+      samples.reserve(kRoundTrips);
+      const size_t allocations = g_allocations.load();
+      const auto start = clock::now();
+      for (size_t trip = 0; trip < kRoundTrips; ++trip) {
+         const auto before = clock::now();
+         round_trip(counter);
+         samples.push_back(to_ns(clock::now() - before));
+      }
+      const auto elapsed = clock::now() - start;
+      const double per_trip = static_cast<double>(g_allocations.load() - allocations) / kRoundTrips;
+      print_row(name, ops_per_second(kRoundTrips, elapsed), percentiles(samples));
+      std::printf("%-34s %.2f heap allocations per round trip\n", "", per_trip);
+   }
+} // namespace
+
+void* operator new(std::size_t size) {
+   ++g_allocations;
+   if (void* memory = std::malloc(size ? size : 1)) {
+      return memory;
+   }
+   throw std::bad_alloc();
+}
+
+void operator delete(void* memory) noexcept {
+   std::free(memory);
+}
+
+void operator delete(void* memory, std::size_t) noexcept {
+   std::free(memory);
+}
+
+int main() {
+   print_header("synchronous round trip to one concurrent<T>");
+   measure("call(...).get()", [](concurrent<Counter>& c) { c.call(&Counter::add, 1).get(); });
+   measure("lambda(...).get()", [](concurrent<Counter>& c) { c.lambda([](Counter& counter) { return counter.add(1); }).get(); });
+   measure("call_and_wait(...)", [](concurrent<Counter>& c) { c.call_and_wait(&Counter::add, 1); });
+   measure("lambda_and_wait(...)", [](concurrent<Counter>& c) { c.lambda_and_wait([](Counter& counter) { return counter.add(1); }); });
+   measure("call_and_wait(...), call_site_tag", [](concurrent<Counter>& c) {
+      concurrent_helper::call_site_tag tag("Counter::add");
+      c.call_and_wait(&Counter::add, 1);
+   });
+   return 0;
+}
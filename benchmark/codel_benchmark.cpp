@@ -0,0 +1,83 @@
+/** ==========================================================================
+ * 2014 by KjellKod.cc. This is PUBLIC DOMAIN to use at your own risk and comes
+ * with no warranties. This code is yours to share, use and modify with no
+ * strings attached and no restrictions or obligations.
+ * ============================================================================
+ *
+ * A concurrent<T> offered twice the calls it can serve. Without queue management the
+ * queue and the latency grow for as long as the overload lasts. With the controlled
+ * delay policy the droppable calls that are served keep a bounded latency.
+ * ============================================================================*/
+
+#include <cstdio>
+#include <future>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "benchmark_helper.hpp"
+#include "codel_policy.hpp"
+#include "concurrent.hpp"
+
+using namespace benchmark_helper;
+
+namespace {
+   const auto kServiceTime = std::chrono::microseconds(100);
+   const auto kArrivalGap = std::chrono::microseconds(50);
+   const auto kOverload = std::chrono::seconds(2);
+
+   struct Service {
+      std::vector<long long> latency_ns;
+      void serve(clock::time_point submitted) {
+         const auto until = clock::now() + kServiceTime;
+         while (clock::now() < until) {} // busy, like real work
+         latency_ns.push_back(to_ns(clock::now() - submitted));
+      }
+      std::vector<long long> latencies() { return latency_ns; }
+   };
+
+   codel_config config(int target_us, int interval_us) {
+      codel_config c;
+      c.target = std::chrono::microseconds(target_us);
+      c.interval = std::chrono::microseconds(interval_us);
+      return c;
+   }
+
+   void overload(const std::string& name, bool codel, codel_config config = codel_config()) {
+      concurrent<Service> service;
+      if (codel) {
+         service.enable_codel(config);
+      }
+      std::vector<std::future<void>> results;
+      const auto start = clock::now();
+      auto next = start;
+      while (clock::now() - start < kOverload) {
+         results.push_back(service.call_droppable(&Service::serve, clock::now()));
+         next += kArrivalGap;
+         while (clock::now() < next) {
+            std::this_thread::yield();
+         }
+      }
+      size_t shed = 0;
+      for (auto& result : results) {
+         try {
+            result.get();
+         } catch (const overload_error&) {
+            ++shed;
+         }
+      }
+      const auto elapsed = clock::now() - start;
+      auto latencies = service.call(&Service::latencies).get();
+      print_row(name, ops_per_second(latencies.size(), elapsed), percentiles(latencies));
+      std::printf("%-34s %zu offered, %zu served, %zu shed\n", "", results.size(), latencies.size(), shed);
+   }
+} // namespace
+
+int main() {
+   print_header("2x overload for 2s, 100us per call: served calls and their latency");
+   overload("no queue management", false);
+   overload("codel, target 5ms, interval 100ms", true);
+   overload("codel, target 2ms, interval 20ms", true, config(2000, 20000));
+   overload("codel, target 1ms, interval 5ms", true, config(1000, 5000));
+   return 0;
+}
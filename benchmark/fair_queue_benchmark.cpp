@@ -0,0 +1,75 @@
+/** ==========================================================================
+ * 2014 by KjellKod.cc. This is PUBLIC DOMAIN to use at your own risk and comes
+ * with no warranties. This code is yours to share, use and modify with no
+ * strings attached and no restrictions or obligations.
+ * ============================================================================
+ *
+ * Tail latency for quiet producers while one noisy producer floods the same
+ * concurrent<T> with fire() calls. FIFO shared_queue compared with fair_queue.
+ * ============================================================================*/
+
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "benchmark_helper.hpp"
+#include "concurrent.hpp"
+#include "fair_queue.hpp"
+
+using namespace benchmark_helper;
+
+namespace {
+   struct Service {
+      size_t value = 0;
+      /// a few microseconds of work per call
+      void work() {
+         auto end = clock::now() + std::chrono::microseconds(5);
+         while (clock::now() < end) {
+            ++value;
+         }
+      }
+      size_t query() { return value; }
+   };
+
+   const size_t kNoisyCalls = 100000;
+   const size_t kQuietProducers = 3;
+   const size_t kQuietCalls = 200;
+
+   template<typename Queue>
+   void noisy_neighbour(const std::string& name) {
+      concurrent<Service, Queue> service;
+      std::atomic<bool> flooding{true};
+      std::thread noisy{[&] {
+         for (size_t call = 0; call < kNoisyCalls; ++call) {
+            service.fire(&Service::work);
+         }
+         flooding = false;
+      }};
+
+      std::vector<std::vector<long long>> latencies(kQuietProducers);
+      auto elapsed = run_threads(kQuietProducers, [&](size_t index) {
+         std::this_thread::sleep_for(std::chrono::milliseconds(10)); // let the backlog build
+         for (size_t call = 0; call < kQuietCalls; ++call) {
+            auto start = clock::now();
+            service.call(&Service::query).get();
+            latencies[index].push_back(to_ns(clock::now() - start));
+            std::this_thread::sleep_for(std::chrono::microseconds(500));
+         }
+      });
+      noisy.join();
+
+      std::vector<long long> all;
+      for (auto& samples : latencies) {
+         all.insert(all.end(), samples.begin(), samples.end());
+      }
+      print_row(name, ops_per_second(all.size(), elapsed), percentiles(all));
+   }
+} // namespace
+
+int main() {
+   print_header("quiet producer call().get() latency with one noisy fire() producer");
+   noisy_neighbour<shared_queue<concurrent_helper::Callback>>("FIFO shared_queue");
+   noisy_neighbour<fair_queue<concurrent_helper::Callback>>("deficit round robin fair_queue");
+   return 0;
+}
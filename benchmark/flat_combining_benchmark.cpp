@@ -0,0 +1,59 @@
+/** ==========================================================================
+ * 2014 by KjellKod.cc. This is PUBLIC DOMAIN to use at your own risk and comes
+ * with no warranties. This code is yours to share, use and modify with no
+ * strings attached and no restrictions or obligations.
+ * ============================================================================
+ *
+ * Threaded concurrent<T> compared with flat combining concurrent_fc<T>.
+ * Each producer does synchronous call(...).get() round trips, the latency critical use case,
+ * at increasing contention levels.
+ * ============================================================================*/
+
+#include <atomic>
+#include <string>
+#include <vector>
+
+#include "benchmark_helper.hpp"
+#include "concurrent.hpp"
+#include "concurrent_fc.hpp"
+
+using namespace benchmark_helper;
+
+namespace {
+   struct Counter {
+      size_t value = 0;
+      size_t add(size_t v) { value += v; return value; }
+   };
+
+   const size_t kCallsPerProducer = 20000;
+
+   template<typename Wrapper>
+   void round_trips(const std::string& name, size_t producers) {
+      Wrapper counter;
+      std::vector<std::vector<long long>> latencies(producers);
+      auto elapsed = run_threads(producers, [&](size_t index) {
+         auto& samples = latencies[index];
+         samples.reserve(kCallsPerProducer);
+         for (size_t call = 0; call < kCallsPerProducer; ++call) {
+            auto start = clock::now();
+            counter.call(&Counter::add, 1).get();
+            samples.push_back(to_ns(clock::now() - start));
+         }
+      });
+
+      std::vector<long long> all;
+      for (auto& samples : latencies) {
+         all.insert(all.end(), samples.begin(), samples.end());
+      }
+      print_row(name + " x" + std::to_string(producers), ops_per_second(all.size(), elapsed), percentiles(all));
+   }
+} // namespace
+
+int main() {
+   print_header("call(...).get() round trip, producers x N");
+   for (size_t producers : {1, 2, 4, 8}) {
+      round_trips<concurrent<Counter>>("threaded concurrent<T>", producers);
+      round_trips<concurrent_fc<Counter>>("flat combining concurrent_fc<T>", producers);
+   }
+   return 0;
+}
@@ -0,0 +1,118 @@
+/** ==========================================================================
+ * 2014 by KjellKod.cc. This is PUBLIC DOMAIN to use at your own risk and comes
+ * with no warranties. This code is yours to share, use and modify with no
+ * strings attached and no restrictions or obligations.
+ * ============================================================================
+ *
+ * One consumer thread serving four shared_queues with a light load. Polling them with
+ * try_and_pop and a sleep when all are empty, against blocking on all of them with a
+ * queue_selector. Latency from push until the consumer has the item, and the CPU time
+ * the consumer burns.
+ * ============================================================================*/
+
+#include <cstdio>
+#include <ctime>
+#include <memory>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "benchmark_helper.hpp"
+#include "queue_select.hpp"
+#include "shared_queue.hpp"
+
+using namespace benchmark_helper;
+
+namespace {
+   const size_t kQueues = 4;
+   const size_t kItems = 5000;
+   const auto kArrivalGap = std::chrono::microseconds(200);
+
+   typedef shared_queue<clock::time_point> Queue;
+
+   double thread_cpu_ms() {
+      timespec now;
+      clock_gettime(CLOCK_THREAD_CPUTIME_ID, &now);
+      return now.tv_sec * 1000.0 + now.tv_nsec / 1000000.0;
+   }
+
+   /// pushes kItems timestamps to random queues, kArrivalGap apart
+   void produce(std::vector<std::unique_ptr<Queue>>& queues) {
+      std::mt19937 random(7);
+      auto next = clock::now();
+      for (size_t item = 0; item < kItems; ++item) {
+         next += kArrivalGap;
+         std::this_thread::sleep_until(next);
+         queues[random() % kQueues]->push(clock::now());
+      }
+   }
+
+   template<typename Consume>
+   void measure(const std::string& name, Consume consume) {
+      std::vector<std::unique_ptr<Queue>> queues;
+      for (size_t index = 0; index < kQueues; ++index) {
+         queues.emplace_back(new Queue());
+      }
+      std::vector<long long> latencies;
+      latencies.reserve(kItems);
+      double cpu_ms = 0;
+      const auto start = clock::now();
+      std::thread consumer([&] {
+         const double cpu_start = thread_cpu_ms();
+         consume(queues, latencies);
+         cpu_ms = thread_cpu_ms() - cpu_start;
+      });
+      produce(queues);
+      consumer.join();
+      print_row(name, ops_per_second(latencies.size(), clock::now() - start), percentiles(latencies));
+      std::printf("%-34s %.0f ms consumer CPU\n", "", cpu_ms);
+   }
+
+   void poll(std::vector<std::unique_ptr<Queue>>& queues, std::vector<long long>& latencies, std::chrono::microseconds pause) {
+      clock::time_point pushed;
+      while (latencies.size() < kItems) {
+         bool found = false;
+         for (auto& queue : queues) {
+            while (queue->try_and_pop(pushed)) {
+               latencies.push_back(to_ns(clock::now() - pushed));
+               found = true;
+            }
+         }
+         if (!found) {
+            std::this_thread::sleep_for(pause);
+         }
+      }
+   }
+
+   void consume_with_selector(std::vector<std::unique_ptr<Queue>>& queues, std::vector<long long>& latencies) {
+      queue_selector selector;
+      for (auto& queue : queues) {
+         selector.add(*queue);
+      }
+      std::vector<size_t> ready;
+      std::vector<clock::time_point> pushed;
+      while (latencies.size() < kItems) {
+         selector.wait(ready);
+         for (size_t index : ready) {
+            pushed.clear();
+            queues[index]->try_pop_n(pushed, 64);
+            for (auto& at : pushed) {
+               latencies.push_back(to_ns(clock::now() - at));
+            }
+         }
+      }
+   }
+} // namespace
+
+int main() {
+   print_header("one consumer, four queues, an item every 200us");
+   measure("poll, sleep 1ms when empty", [](std::vector<std::unique_ptr<Queue>>& q, std::vector<long long>& l) {
+      poll(q, l, std::chrono::microseconds(1000));
+   });
+   measure("poll, sleep 10us when empty", [](std::vector<std::unique_ptr<Queue>>& q, std::vector<long long>& l) {
+      poll(q, l, std::chrono::microseconds(10));
+   });
+   measure("queue_selector", consume_with_selector);
+   return 0;
+}
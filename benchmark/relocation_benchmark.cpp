@@ -0,0 +1,92 @@
+/** ==========================================================================
+ * 2014 by KjellKod.cc. This is PUBLIC DOMAIN to use at your own risk and comes
+ * with no warranties. This code is yours to share, use and modify with no
+ * strings attached and no restrictions or obligations.
+ * ============================================================================
+ *
+ * Push and pop of small captured lambdas through the queue storage. A task type that
+ * is std2::is_trivially_relocatable leaves the queue as a byte copy. The same
+ * std::function in a wrapper that does not opt in is move assigned and destroyed.
+ * ============================================================================*/
+
+#include <algorithm>
+#include <cstdio>
+#include <functional>
+#include <string>
+
+#include "benchmark_helper.hpp"
+#include "segmented_queue.hpp"
+#include "shared_queue.hpp"
+#include "spsc_queue.hpp"
+
+using namespace benchmark_helper;
+
+namespace {
+   const size_t kBatch = 512;
+   const size_t kRounds = 4000;
+
+   /// the same std::function, but not opted in as trivially relocatable
+   struct MovedTask {
+      std::function<void()> call;
+      MovedTask() = default;
+      template<typename F>
+      MovedTask(F f) : call(std::move(f)) {}
+      void operator()() { call(); }
+   };
+
+   static_assert(!std2::is_trivially_relocatable_v<MovedTask>, "the baseline must take the move path");
+
+   const size_t kRepeats = 5;
+
+   /// pop and run one task, through the queue's own try_and_pop
+   template<typename Queue, typename Task>
+   void pop_and_run(Queue& queue, Task& task) {
+      queue.try_and_pop(task);
+      task();
+   }
+
+   /// the bare segmented_queue, pop(T&) relocates or moves depending on the trait
+   template<typename Task>
+   void pop_and_run(segmented_queue<Task>& queue, Task& task) {
+      queue.pop(task);
+      task();
+   }
+
+   /// best of kRepeats, to filter out scheduling noise
+   template<typename Task, typename Queue>
+   void push_pop(const std::string& name) {
+      double best = 0;
+      for (size_t repeat = 0; repeat < kRepeats; ++repeat) {
+         Queue queue;
+         size_t sum = 0;
+         size_t* total = &sum;
+         Task task;
+         const auto start = clock::now();
+         for (size_t round = 0; round < kRounds; ++round) {
+            for (size_t item = 0; item < kBatch; ++item) {
+               queue.push(Task([total, item] { *total += item; })); // small, stored inside the std::function
+            }
+            for (size_t item = 0; item < kBatch; ++item) {
+               pop_and_run(queue, task);
+            }
+         }
+         best = std::max(best, ops_per_second(kRounds * kBatch, clock::now() - start));
+         if (sum != kRounds * (kBatch * (kBatch - 1) / 2)) {
+            std::printf("unexpected sum %zu\n", sum);
+         }
+      }
+      print_throughput(name, best);
+   }
+} // namespace
+
+int main() {
+   print_throughput_header("push + pop + run of a small captured lambda, one thread");
+   typedef std::function<void()> Task;
+   push_pop<MovedTask, segmented_queue<MovedTask>>("segmented_queue, move");
+   push_pop<Task, segmented_queue<Task>>("segmented_queue, relocate");
+   push_pop<MovedTask, shared_queue<MovedTask, segmented_queue<MovedTask>>>("shared_queue<segmented>, move");
+   push_pop<Task, shared_queue<Task, segmented_queue<Task>>>("shared_queue<segmented>, relocate");
+   push_pop<MovedTask, spsc_queue<MovedTask>>("spsc_queue, move");
+   push_pop<Task, spsc_queue<Task>>("spsc_queue, relocate");
+   return 0;
+}
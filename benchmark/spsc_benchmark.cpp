@@ -0,0 +1,66 @@
+/** ==========================================================================
+ * 2014 by KjellKod.cc. This is PUBLIC DOMAIN to use at your own risk and comes
+ * with no warranties. This code is yours to share, use and modify with no
+ * strings attached and no restrictions or obligations.
+ * ============================================================================
+ *
+ * One producer thread feeding one consumer. The mutex protected shared_queue compared
+ * with the wait-free spsc_queue, raw and as the queue of a concurrent<T>.
+ * ============================================================================*/
+
+#include <string>
+#include <thread>
+
+#include "benchmark_helper.hpp"
+#include "concurrent.hpp"
+#include "shared_queue.hpp"
+#include "spsc_queue.hpp"
+
+using namespace benchmark_helper;
+
+namespace {
+   const size_t kItems = 2000000;
+
+   template<typename Queue>
+   void raw_queue(const std::string& name) {
+      Queue queue;
+      auto start = clock::now();
+      std::thread producer{[&queue] {
+         for (size_t item = 0; item < kItems; ++item) {
+            queue.push(item);
+         }
+      }};
+      size_t item = 0;
+      for (size_t count = 0; count < kItems; ++count) {
+         queue.wait_and_pop(item);
+      }
+      producer.join();
+      print_throughput(name, ops_per_second(kItems, clock::now() - start));
+   }
+
+   struct Counter {
+      size_t value = 0;
+      void add(size_t v) { value += v; }
+      size_t get() { return value; }
+   };
+
+   template<typename Queue>
+   void concurrent_fire(const std::string& name) {
+      concurrent<Counter, Queue> counter;
+      auto start = clock::now();
+      for (size_t item = 0; item < kItems; ++item) {
+         counter.fire(&Counter::add, 1);
+      }
+      counter.call(&Counter::get).get();
+      print_throughput(name, ops_per_second(kItems, clock::now() - start));
+   }
+} // namespace
+
+int main() {
+   print_throughput_header("single producer -> single consumer throughput");
+   raw_queue<shared_queue<size_t>>("shared_queue (mutex)");
+   raw_queue<spsc_queue<size_t, 4096>>("spsc_queue (wait-free ring)");
+   concurrent_fire<shared_queue<concurrent_helper::Callback>>("concurrent<T> fire()");
+   concurrent_fire<single_producer>("concurrent<T, single_producer> fire()");
+   return 0;
+}
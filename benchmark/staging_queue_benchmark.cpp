@@ -0,0 +1,54 @@
+/** ==========================================================================
+ * 2014 by KjellKod.cc. This is PUBLIC DOMAIN to use at your own risk and comes
+ * with no warranties. This code is yours to share, use and modify with no
+ * strings attached and no restrictions or obligations.
+ * ============================================================================
+ *
+ * Many producer threads calling fire() on one concurrent<T>. The shared_queue takes its
+ * mutex once per call, the staging_queue once per buffer of calls.
+ * ============================================================================*/
+
+#include <algorithm>
+#include <string>
+#include <thread>
+
+#include "benchmark_helper.hpp"
+#include "concurrent.hpp"
+#include "shared_queue.hpp"
+#include "staging_queue.hpp"
+
+using namespace benchmark_helper;
+
+namespace {
+   const size_t kCallsPerProducer = 200000;
+
+   struct Counter {
+      size_t value = 0;
+      void add(size_t v) { value += v; }
+      size_t get() { return value; }
+   };
+
+   template<typename Queue>
+   void concurrent_fire(const std::string& name, size_t producers) {
+      concurrent<Counter, Queue> counter;
+      auto elapsed = run_threads(producers, [&counter](size_t) {
+         for (size_t call = 0; call < kCallsPerProducer; ++call) {
+            counter.fire(&Counter::add, 1);
+         }
+      });
+      auto start = clock::now() - elapsed;
+      counter.call(&Counter::get).get();
+      print_throughput(name + ", " + std::to_string(producers) + " producers",
+                       ops_per_second(producers * kCallsPerProducer, clock::now() - start));
+   }
+} // namespace
+
+int main() {
+   const size_t cores = std::max<size_t>(2, std::thread::hardware_concurrency());
+   print_throughput_header("many producers -> one concurrent<T>, fire() throughput");
+   for (size_t producers : {cores, 4 * cores}) {
+      concurrent_fire<shared_queue<concurrent_helper::Callback>>("shared_queue", producers);
+      concurrent_fire<staging_queue<concurrent_helper::Callback>>("staging_queue", producers);
+   }
+   return 0;
+}
@@ -0,0 +1,98 @@
+/** ==========================================================================
+ * 2014 by KjellKod.cc. This is PUBLIC DOMAIN to use at your own risk and comes
+ * with no warranties. This code is yours to share, use and modify with no
+ * strings attached and no restrictions or obligations.
+ * ============================================================================
+ *
+ * Replays a recorded workload against concurrent<T> with each queue, to compare them
+ * on production shaped load.
+ *
+ *    ./workload_replay_benchmark service.workload [speed]
+ *
+ * A workload file is saved with workload_recorder::save. Without a file a bursty
+ * workload of four producers is recorded first, and saved to ./sample.workload.
+ * Arrivals are replayed 'speed' times faster than recorded, the service times are kept.
+ * ============================================================================*/
+
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+
+#include "benchmark_helper.hpp"
+#include "concurrent.hpp"
+#include "fair_queue.hpp"
+#include "staging_queue.hpp"
+#include "workload_recorder.hpp"
+#include "workload_replay.hpp"
+#if defined(__linux__)
+#include "reactor_queue.hpp"
+#endif
+
+using namespace benchmark_helper;
+
+namespace {
+   struct Store {
+      size_t value = 0;
+      void busy(std::chrono::microseconds duration) {
+         const auto until = clock::now() + duration;
+         while (clock::now() < until) {
+            ++value;
+         }
+      }
+      void read() { busy(std::chrono::microseconds(10)); }
+      void write() { busy(std::chrono::microseconds(200)); }
+   };
+
+   /// four producers: bursts of reads with an occasional write, then a pause
+   workload record_sample() {
+      workload_recorder recorder;
+      concurrent<Store> store;
+      store.start_recording(recorder);
+      run_threads(4, [&store](size_t producer) {
+         for (size_t burst = 0; burst < 40; ++burst) {
+            for (size_t call = 0; call < 50; ++call) {
+               if (0 == (call + producer) % 25) {
+                  concurrent_helper::call_site_tag tag("write");
+                  store.fire(&Store::write);
+               } else {
+                  concurrent_helper::call_site_tag tag("read");
+                  store.fire(&Store::read);
+               }
+               std::this_thread::sleep_for(std::chrono::microseconds(20));
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(5 + producer));
+         }
+      });
+      store.stop_recording();
+      return recorder.recorded();
+   }
+
+   template<typename Queue>
+   void replay_with(const std::string& name, const workload& recorded, double speed) {
+      replay_result result = replay<Queue>(recorded, speed);
+      print_row(name, ops_per_second(result.latency_ns.size(), result.elapsed), percentiles(result.latency_ns));
+   }
+} // namespace
+
+int main(int argc, char** argv) {
+   workload recorded;
+   if (argc > 1) {
+      recorded = workload::load(argv[1]);
+   } else {
+      recorded = record_sample();
+      recorded.save("sample.workload");
+   }
+   const double speed = argc > 2 ? std::atof(argv[2]) : 1.0;
+   std::printf("\n%zu calls, %zu call site tags, replayed at %.2fx\n", recorded.records.size(), recorded.tags.size() - 1, speed);
+
+   typedef concurrent_helper::Callback Callback;
+   print_header("replayed workload, latency from submit until done");
+   replay_with<shared_queue<Callback>>("shared_queue", recorded, speed);
+   replay_with<staging_queue<Callback>>("staging_queue", recorded, speed);
+   replay_with<fair_queue<Callback>>("fair_queue", recorded, speed);
+#if defined(__linux__)
+   replay_with<reactor_queue<Callback>>("reactor_queue", recorded, speed);
+#endif
+   return 0;
+}
@@ -0,0 +1,193 @@
+/** ==========================================================================
+ * 2014 by KjellKod.cc. This is PUBLIC DOMAIN to use at your own risk and comes
+ * with no warranties. This code is yours to share, use and modify with no
+ * strings attached and no restrictions or obligations.
+ * ============================================================================
+ *
+ * Fusion of consecutive calls to the same member function, behind concurrent<T>::batch_calls.
+ *
+ * A fire(&T::insert, k, v) for a registered method queues a thunk holding a batch of
+ * argument tuples. While that thunk waits in the queue, the following fire(&T::insert, ...)
+ * calls from the same thread only append their arguments to it. Any other call made
+ * to the object closes the batch, so nothing runs out of order. When the worker
+ * reaches the thunk it closes the batch and calls T::insert_batch once with all the tuples.
+ *
+ * Closing is a single atomic store on the push path of the other calls. It is done after
+ * their push, so a call that happens after another call can never join a batch that is
+ * queued before it.
+ *
+ * fire() of a method that is not registered finds that out from an immutable list of the
+ * registered methods, published atomically by batch_calls, without taking the table's lock.
+ * ============================================================================*/
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <tuple>
+#include <type_traits>
+#include <typeindex>
+#include <utility>
+#include <vector>
+
+namespace concurrent_helper {
+   template<typename T>
+   class batch_table {
+      typedef std::function<void()> Call;
+
+      struct lane_base {
+         explicit lane_base(std::type_index t) : type(t) {}
+         virtual ~lane_base() = default;
+         const std::type_index type; // of the single call's member function pointer
+      };
+
+      template<typename R, typename... Params>
+      struct lane : lane_base {
+         typedef std::tuple<typename std::decay<Params>::type...> arguments;
+         typedef R (T::*single_type)(Params...);
+         typedef void (T::*batched_type)(std::vector<arguments>&);
+
+         lane(single_type s, batched_type b) : lane_base(typeid(single_type)), single(s), batched(b) {}
+         const single_type single;
+         const batched_type batched;
+      };
+
+      struct batch_base {
+         virtual ~batch_base() = default;
+         uint64_t id;
+         std::thread::id producer;
+         const lane_base* owner;
+      };
+
+      template<typename Arguments>
+      struct batch : batch_base {
+         std::vector<Arguments> calls;
+      };
+
+      typedef std::vector<const lane_base*> lane_list;
+
+      mutable std::mutex _m;
+      std::vector<std::unique_ptr<lane_base>> _lanes;             // owned, guarded by _m
+      std::vector<std::unique_ptr<const lane_list>> _lane_lists;  // every published list, kept until destruction
+      std::atomic<const lane_list*> _registered;                  // immutable, read without the lock
+      std::atomic<uint64_t> _open;          // id of the batch that can still grow, 0 if none
+      std::shared_ptr<batch_base> _current; // the batch with id _open
+      uint64_t _next_id;
+      size_t _fused;
+
+      batch_table(const batch_table&) = delete;
+      batch_table& operator=(const batch_table&) = delete;
+
+      /// lock free, registration publishes a new list
+      template<typename R, typename... Params>
+      const lane<R, Params...>* find(R (T::*single)(Params...)) const {
+         typedef lane<R, Params...> lane_type;
+         const lane_list* registered = _registered.load(std::memory_order_acquire);
+         if (nullptr == registered) {
+            return nullptr;
+         }
+         for (const lane_base* candidate : *registered) {
+            if (candidate->type == std::type_index(typeid(single))
+                && static_cast<const lane_type*>(candidate)->single == single) {
+               return static_cast<const lane_type*>(candidate);
+            }
+         }
+         return nullptr;
+      }
+
+      /// worker side, the batch stops growing
+      void take_locked(const batch_base& taken) {
+         uint64_t expected = taken.id;
+         _open.compare_exchange_strong(expected, 0);
+         if (_current.get() == &taken) {
+            _current.reset();
+         }
+      }
+
+    public:
+      batch_table() : _registered(nullptr), _open(0), _next_id(1), _fused(0) {}
+
+      /// calls to single are from now on fused into calls to batched
+      template<typename R, typename... Params>
+      void add(R (T::*single)(Params...), typename lane<R, Params...>::batched_type batched) {
+         std::lock_guard<std::mutex> lock(_m);
+         if (nullptr != find(single)) {
+            return;
+         }
+         _lanes.emplace_back(new lane<R, Params...>(single, batched));
+         std::unique_ptr<lane_list> registered(new lane_list());
+         for (auto& added : _lanes) {
+            registered->push_back(added.get());
+         }
+         _registered.store(registered.get(), std::memory_order_release);
+         _lane_lists.push_back(std::move(registered));
+      }
+
+      bool enabled() const { return nullptr != _registered.load(std::memory_order_relaxed); }
+
+      /// called after every other push: later calls must not join an earlier batch
+      void close() {
+         if (0 != _open.load(std::memory_order_relaxed)) {
+            _open.store(0, std::memory_order_release);
+         }
+      }
+
+      /// not a registered method
+      template<typename AsyncCall, typename Enqueue, typename... Args>
+      bool submit(T*, AsyncCall, Enqueue&, Args&& ...) { return false; }
+
+      /**
+       * Append the call to the open batch of this thread, or queue a new batch with enqueue(thunk).
+       * @return false if single is not registered, the caller then queues it as usual
+       */
+      template<typename R, typename... Params, typename Enqueue, typename... Args>
+      bool submit(T* worker, R (T::*single)(Params...), Enqueue& enqueue, Args&& ... args) {
+         typedef lane<R, Params...> lane_type;
+         typedef batch<typename lane_type::arguments> batch_type;
+         const lane_type* found = find(single);
+         if (nullptr == found) {
+            return false; // without touching the lock
+         }
+         auto started = std::make_shared<batch_type>();
+         {
+            std::lock_guard<std::mutex> lock(_m);
+            if (_current && _current->owner == found && _current->producer == std::this_thread::get_id()
+                && _current->id == _open.load(std::memory_order_acquire)) {
+               static_cast<batch_type*>(_current.get())->calls.emplace_back(std::forward<Args>(args)...);
+               ++_fused;
+               return true;
+            }
+            started->id = _next_id++;
+            started->producer = std::this_thread::get_id();
+            started->owner = found;
+            started->calls.emplace_back(std::forward<Args>(args)...);
+            _current = started;
+            _open.store(started->id, std::memory_order_release); // before the push, see close()
+         }
+         // not under _m: a push to a full queue waits for the worker, which may need _m for an earlier batch.
+         // If another producer closes the batch before it is queued, the id check above starts a new one
+         auto batched = found->batched;
+         enqueue([this, worker, batched, started] {
+            std::vector<typename lane_type::arguments> calls;
+            {
+               std::lock_guard<std::mutex> taking(_m);
+               take_locked(*started);
+               calls.swap(started->calls);
+            }
+            (worker->*batched)(calls);
+         });
+         return true;
+      }
+
+      /// @return number of calls that joined a queued batch instead of being queued
+      size_t fused() const {
+         std::lock_guard<std::mutex> lock(_m);
+         return _fused;
+      }
+   };
+} // namespace concurrent_helper
@@ -0,0 +1,212 @@
+/** ==========================================================================
+ * 2014 by KjellKod.cc. This is PUBLIC DOMAIN to use at your own risk and comes
+ * with no warranties. This code is yours to share, use and modify with no
+ * strings attached and no restrictions or obligations.
+ * ============================================================================
+ *
+ * Pool of fixed size buffers for handing large payloads to a concurrent<T> worker
+ * without a copy or an allocation per message.
+ *
+ * A pooled_buffer is a reference counted handle. Copying it, as std::bind does for the
+ * arguments of call() and fire(), copies the handle and not the payload. When the last
+ * handle is gone, i.e. when the worker is done with the call, the buffer goes back to
+ * a lock-free free list.
+ *
+ *    buffer_pool frames(256, 64 * 1024);          // must outlive its buffers
+ *    pooled_buffer frame = frames.lease();
+ *    frame.resize(socket.read(frame.data(), frame.capacity()));
+ *    decoder.fire(&Decoder::decode, std::move(frame));
+ *
+ * The free list is a Treiber stack of buffer indices. The head carries a tag that
+ * changes on every update, so a stale head can not be swapped in (ABA).
+ * ============================================================================*/
+
+#pragma once
+
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <utility>
+
+struct buffer_pool_stats {
+   size_t buffers;        // pool size
+   size_t buffer_bytes;   // capacity of each buffer
+   size_t in_use;         // leased buffers that are not released yet
+   size_t peak_in_use;
+   size_t leases;         // successful leases, total
+   size_t exhausted;      // leases that found no free buffer, total
+};
+
+class buffer_pool;
+
+
+class pooled_buffer {
+   friend class buffer_pool;
+
+   buffer_pool* _pool;
+   uint32_t _index;
+
+   pooled_buffer(buffer_pool* pool, uint32_t index) : _pool(pool), _index(index) {}
+   void release();
+
+ public:
+   pooled_buffer() : _pool(nullptr), _index(0) {}
+   pooled_buffer(const pooled_buffer& other);
+   pooled_buffer(pooled_buffer&& other) noexcept : _pool(other._pool), _index(other._index) { other._pool = nullptr; }
+   pooled_buffer& operator=(pooled_buffer other) noexcept {
+      std::swap(_pool, other._pool);
+      std::swap(_index, other._index);
+      return *this;
+   }
+   ~pooled_buffer() { release(); }
+
+   /// @return false for a default constructed or moved from handle, or a failed try_lease
+   explicit operator bool() const { return nullptr != _pool; }
+
+   char* data() const;
+   size_t capacity() const;
+   /// bytes in use, shared by all handles of the buffer
+   size_t size() const;
+   /// WARNING: size must not be larger than capacity()
+   void resize(size_t size);
+   /// @return number of handles of the buffer
+   size_t use_count() const;
+};
+
+
+class buffer_pool {
+   friend class pooled_buffer;
+
+   static const uint32_t kEnd = 0xffffffff;
+
+   struct Slot {
+      std::atomic<uint32_t> references{0};
+      std::atomic<uint32_t> next{kEnd};
+      size_t size = 0;
+   };
+
+   const size_t _buffers;
+   const size_t _buffer_bytes;
+   std::unique_ptr<char[]> _memory;
+   std::unique_ptr<Slot[]> _slots;
+   std::atomic<uint64_t> _free; // tag << 32 | index of the first free buffer
+   std::atomic<size_t> _in_use{0};
+   std::atomic<size_t> _peak_in_use{0};
+   std::atomic<size_t> _leases{0};
+   std::atomic<size_t> _exhausted{0};
+
+   buffer_pool(const buffer_pool&) = delete;
+   buffer_pool& operator=(const buffer_pool&) = delete;
+
+   static uint64_t head(uint64_t tag, uint32_t index) { return (tag << 32) | index; }
+   static uint32_t index_of(uint64_t head) { return static_cast<uint32_t>(head); }
+   static uint64_t tag_of(uint64_t head) { return head >> 32; }
+
+   uint32_t pop_free() {
+      uint64_t current = _free.load(std::memory_order_acquire);
+      while (kEnd != index_of(current)) {
+         const uint32_t next = _slots[index_of(current)].next.load(std::memory_order_relaxed);
+         if (_free.compare_exchange_weak(current, head(tag_of(current) + 1, next),
+                                         std::memory_order_acquire, std::memory_order_acquire)) {
+            return index_of(current);
+         }
+      }
+      return kEnd;
+   }
+
+   void push_free(uint32_t index) {
+      _in_use.fetch_sub(1, std::memory_order_relaxed); // before it can be leased again
+      uint64_t current = _free.load(std::memory_order_relaxed);
+      do {
+         _slots[index].next.store(index_of(current), std::memory_order_relaxed);
+      } while (!_free.compare_exchange_weak(current, head(tag_of(current) + 1, index),
+                                            std::memory_order_release, std::memory_order_relaxed));
+   }
+
+   pooled_buffer leased(uint32_t index) {
+      Slot& slot = _slots[index];
+      slot.references.store(1, std::memory_order_relaxed);
+      slot.size = 0;
+      _leases.fetch_add(1, std::memory_order_relaxed);
+      const size_t in_use = _in_use.fetch_add(1, std::memory_order_relaxed) + 1;
+      size_t peak = _peak_in_use.load(std::memory_order_relaxed);
+      while (in_use > peak && !_peak_in_use.compare_exchange_weak(peak, in_use, std::memory_order_relaxed)) {}
+      return pooled_buffer(this, index);
+   }
+
+ public:
+   /// @param buffers pool size, all buffers are allocated up front
+   buffer_pool(size_t buffers, size_t buffer_bytes)
+      : _buffers(buffers)
+      , _buffer_bytes(buffer_bytes)
+      , _memory(new char[buffers * buffer_bytes])
+      , _slots(new Slot[buffers])
+      , _free(head(0, kEnd)) {
+      assert(buffers < kEnd);
+      for (size_t index = buffers; index > 0; --index) {
+         _slots[index - 1].next.store(index_of(_free.load()), std::memory_order_relaxed);
+         _free.store(head(0, static_cast<uint32_t>(index - 1)));
+      }
+   }
+
+   ~buffer_pool() {
+      assert(0 == _in_use.load() && "buffers must not outlive their pool");
+   }
+
+   /// @return a buffer, or an empty handle if all are in use
+   pooled_buffer try_lease() {
+      const uint32_t index = pop_free();
+      if (kEnd == index) {
+         _exhausted.fetch_add(1, std::memory_order_relaxed);
+         return pooled_buffer();
+      }
+      return leased(index);
+   }
+
+   /// @return a buffer, waits for one to be released if all are in use
+   pooled_buffer lease() {
+      uint32_t index = pop_free();
+      if (kEnd == index) {
+         _exhausted.fetch_add(1, std::memory_order_relaxed);
+         while (kEnd == (index = pop_free())) {
+            std::this_thread::yield();
+         }
+      }
+      return leased(index);
+   }
+
+   size_t buffer_bytes() const { return _buffer_bytes; }
+
+   buffer_pool_stats stats() const {
+      return buffer_pool_stats{_buffers, _buffer_bytes, _in_use.load(), _peak_in_use.load(),
+                               _leases.load(), _exhausted.load()};
+   }
+};
+
+
+inline pooled_buffer::pooled_buffer(const pooled_buffer& other) : _pool(other._pool), _index(other._index) {
+   if (_pool) {
+      _pool->_slots[_index].references.fetch_add(1, std::memory_order_relaxed);
+   }
+}
+
+inline void pooled_buffer::release() {
+   if (_pool && 1 == _pool->_slots[_index].references.fetch_sub(1, std::memory_order_acq_rel)) {
+      _pool->push_free(_index);
+   }
+   _pool = nullptr;
+}
+
+inline char* pooled_buffer::data() const { return _pool->_memory.get() + _index * _pool->_buffer_bytes; }
+inline size_t pooled_buffer::capacity() const { return _pool->_buffer_bytes; }
+inline size_t pooled_buffer::size() const { return _pool->_slots[_index].size; }
+inline void pooled_buffer::resize(size_t size) {
+   assert(size <= capacity());
+   _pool->_slots[_index].size = size;
+}
+inline size_t pooled_buffer::use_count() const {
+   return _pool ? _pool->_slots[_index].references.load(std::memory_order_relaxed) : 0;
+}
@@ -0,0 +1,120 @@
+/** ==========================================================================
+ * 2014 by KjellKod.cc. This is PUBLIC DOMAIN to use at your own risk and comes
+ * with no warranties. This code is yours to share, use and modify with no
+ * strings attached and no restrictions or obligations.
+ * ============================================================================
+ *
+ * Latest-wins table of queued calls, behind concurrent<T>::fire_coalesced.
+ *
+ * The first call for a key queues a thunk and keeps the call in a slot for the key.
+ * Later calls for the same key only replace the call in the slot, while the thunk keeps
+ * its place in the queue. When the worker reaches the thunk it frees the slot and runs
+ * the latest call. A burst of updates then costs one call per distinct key.
+ *
+ * Keys are compared by value with std::hash and ==. Text keys are stored as std::string.
+ * ============================================================================*/
+
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <type_traits>
+#include <typeindex>
+#include <unordered_map>
+#include <utility>
+
+namespace concurrent_helper {
+   /// the stored key type, C strings are compared by content
+   template<typename Key>
+   struct coalescing_key {
+      typedef Key type;
+   };
+   template<>
+   struct coalescing_key<const char*> {
+      typedef std::string type;
+   };
+   template<>
+   struct coalescing_key<char*> {
+      typedef std::string type;
+   };
+
+
+   class coalescing_table {
+      typedef std::function<void()> Call;
+
+      struct slots_base {
+         virtual ~slots_base() = default;
+      };
+
+      template<typename Key>
+      struct slots : slots_base {
+         std::unordered_map<Key, std::shared_ptr<Call>> queued;
+      };
+
+      mutable std::mutex _m;
+      std::unordered_map<std::type_index, std::unique_ptr<slots_base>> _tables; // one per key type
+      size_t _queued;
+      size_t _coalesced;
+
+      coalescing_table(const coalescing_table&) = delete;
+      coalescing_table& operator=(const coalescing_table&) = delete;
+
+      template<typename Key>
+      std::unordered_map<Key, std::shared_ptr<Call>>& queued_locked() {
+         auto& table = _tables[std::type_index(typeid(Key))];
+         if (!table) {
+            table.reset(new slots<Key>());
+         }
+         return static_cast<slots<Key>*>(table.get())->queued;
+      }
+
+    public:
+      coalescing_table() : _queued(0), _coalesced(0) {}
+
+      /**
+       * @return the thunk to queue for a new key, or an empty function if the call
+       * replaced one that is still queued
+       */
+      template<typename Key>
+      Call submit(const Key& key, Call call) {
+         typedef typename coalescing_key<typename std::decay<Key>::type>::type key_type;
+         std::lock_guard<std::mutex> lock(_m);
+         auto& queued = queued_locked<key_type>();
+         auto it = queued.find(key_type(key));
+         if (it != queued.end()) {
+            *(it->second) = std::move(call);
+            ++_coalesced;
+            return nullptr;
+         }
+         auto slot = std::make_shared<Call>(std::move(call));
+         queued.emplace(key_type(key), slot);
+         ++_queued;
+         key_type stored(key);
+         return [this, stored, slot] {
+            Call latest;
+            {
+               std::lock_guard<std::mutex> lock(_m);
+               queued_locked<key_type>().erase(stored); // calls made from now on are queued again
+               latest = std::move(*slot);
+               --_queued;
+            }
+            latest();
+         };
+      }
+
+      /// @return number of calls that were replaced by a later call with the same key
+      size_t coalesced() const {
+         std::lock_guard<std::mutex> lock(_m);
+         return _coalesced;
+      }
+
+      /// @return number of keys with a queued call
+      size_t queued() const {
+         std::lock_guard<std::mutex> lock(_m);
+         return _queued;
+      }
+   };
+} // namespace concurrent_helper
@@ -0,0 +1,134 @@
+/** ==========================================================================
+ * 2014 by KjellKod.cc. This is PUBLIC DOMAIN to use at your own risk and comes
+ * with no warranties. This code is yours to share, use and modify with no
+ * strings attached and no restrictions or obligations.
+ * ============================================================================
+ *
+ * Controlled delay (CoDel) active queue management for the droppable calls of a
+ * concurrent<T>, see call_droppable and lambda_droppable.
+ *
+ * The worker measures the sojourn time of each droppable call, from enqueue to dequeue.
+ * When it has stayed above 'target' for a whole 'interval', there is a standing queue and
+ * the worker starts to shed droppable calls, interval/sqrt(n) apart for the n:th drop, until
+ * a call gets through below target. Like CoDel for packets (RFC 8289), with calls instead.
+ *
+ * No tuning per workload beyond target and interval. Only the worker thread touches
+ * the state, the counters can be read from any thread.
+ * ============================================================================*/
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <stdexcept>
+#include <string>
+
+/// the exception in the future of a shed call
+class overload_error : public std::runtime_error {
+ public:
+   explicit overload_error(const std::string& what) : std::runtime_error(what) {}
+};
+
+struct codel_config {
+   std::chrono::microseconds target{5000};      // acceptable standing queue delay
+   std::chrono::microseconds interval{100000};  // how long above target before shedding, ~ a worst case round trip
+};
+
+struct codel_stats {
+   size_t executed;    // droppable calls that were run
+   size_t dropped;     // droppable calls that were shed
+   bool dropping;      // currently shedding
+};
+
+
+class codel_policy {
+ public:
+   typedef std::chrono::steady_clock clock;
+
+ private:
+   bool _enabled;
+   codel_config _config;
+   clock::time_point _first_above;   // when the sojourn time went above target, plus interval
+   clock::time_point _drop_next;
+   size_t _count;                    // drops since shedding started
+   size_t _last_count;
+   bool _dropping;
+   std::atomic<size_t> _executed{0};
+   std::atomic<size_t> _dropped{0};
+   std::atomic<bool> _dropping_flag{false};
+
+   codel_policy(const codel_policy&) = delete;
+   codel_policy& operator=(const codel_policy&) = delete;
+
+   clock::time_point control_law(clock::time_point from) const {
+      const auto spacing = std::chrono::duration<double, std::micro>(_config.interval.count() / std::sqrt(static_cast<double>(_count)));
+      return from + std::chrono::duration_cast<clock::duration>(spacing);
+   }
+
+   /// @return true if the sojourn time has been above target for an interval
+   bool ok_to_drop(clock::duration sojourn, clock::time_point now) {
+      if (sojourn < _config.target) {
+         _first_above = clock::time_point();
+         return false;
+      }
+      if (clock::time_point() == _first_above) {
+         _first_above = now + _config.interval;
+         return false;
+      }
+      return now >= _first_above;
+   }
+
+   bool decide(clock::time_point enqueued, clock::time_point now) {
+      const bool ok = ok_to_drop(now - enqueued, now);
+      if (_dropping) {
+         if (!ok) {
+            _dropping = false;
+            return false;
+         }
+         if (now >= _drop_next) {
+            ++_count;
+            _drop_next = control_law(_drop_next);
+            return true;
+         }
+         return false;
+      }
+      if (ok) {
+         _dropping = true;
+         // shedding again soon after it stopped: continue close to the last drop rate
+         const size_t delta = _count - _last_count;
+         _count = (delta > 1 && now - _drop_next < 16 * _config.interval) ? delta : 1;
+         _last_count = _count;
+         _drop_next = control_law(now);
+         return true;
+      }
+      return false;
+   }
+
+ public:
+   codel_policy() : _enabled(false), _count(0), _last_count(0), _dropping(false) {}
+
+   /// worker side. Resets the state
+   void configure(bool enabled, codel_config config) {
+      _enabled = enabled;
+      _config = config;
+      _first_above = clock::time_point();
+      _count = _last_count = 0;
+      _dropping = false;
+      _dropping_flag.store(false, std::memory_order_relaxed);
+   }
+
+   /// worker side. @return true if the call that was enqueued at 'enqueued' must be shed
+   bool drop(clock::time_point enqueued, clock::time_point now = clock::now()) {
+      const bool shed = _enabled && decide(enqueued, now);
+      (shed ? _dropped : _executed).fetch_add(1, std::memory_order_relaxed);
+      _dropping_flag.store(_dropping, std::memory_order_relaxed);
+      return shed;
+   }
+
+   codel_stats stats() const {
+      return codel_stats{_executed.load(std::memory_order_relaxed), _dropped.load(std::memory_order_relaxed),
+                         _dropping_flag.load(std::memory_order_relaxed)};
+   }
+};
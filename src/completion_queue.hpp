@@ -0,0 +1,285 @@
+/** ==========================================================================
+ * 2014 by KjellKod.cc. This is PUBLIC DOMAIN to use at your own risk and comes
+ * with no warranties. This code is yours to share, use and modify with no
+ * strings attached and no restrictions or obligations.
+ * ============================================================================
+ *
+ * Completion queue for results of concurrent<T> calls, instead of one std::future per call.
+ *
+ * A submission carries a user tag. When the call is done its result, or its exception,
+ * lands together with the tag in a caller owned, lock-free ring. The caller drains the
+ * ring in bulk and can block on it with a timeout. One completion queue can collect the
+ * results from many concurrent<T> instances.
+ *
+ * example usage:
+ *   completion_queue<std::string> done{4096};
+ *   concurrent<Greeting> a, b;
+ *   a.call_to(done, 1, &Greeting::ping, 123);
+ *   b.lambda_to(done, 2, [](Greeting& g) { return g.sayHello(); });
+ *
+ *   std::vector<completion<std::string>> results;
+ *   done.wait_and_drain(results, std::chrono::milliseconds(10));
+ *   for (auto& result : results) { use(result.tag, result.get()); } // get() rethrows
+ *
+ * The ring is bounded, a worker that finds it full sleeps until the caller drains it, and
+ * every call queued to that object waits meanwhile. Size it for the number of outstanding
+ * submissions. R must be default constructible.
+ * ============================================================================*/
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+/** A finished call: the user tag plus the value or the exception */
+template<typename R>
+struct completion {
+   uint64_t tag = 0;
+   R value{};
+   std::exception_ptr error;
+
+   bool failed() const { return nullptr != error; }
+
+   /// @return the value, or rethrow the exception of the call
+   R& get() {
+      if (error) {
+         std::rethrow_exception(error);
+      }
+      return value;
+   }
+};
+
+template<>
+struct completion<void> {
+   uint64_t tag = 0;
+   std::exception_ptr error;
+
+   bool failed() const { return nullptr != error; }
+
+   void get() const {
+      if (error) {
+         std::rethrow_exception(error);
+      }
+   }
+};
+
+
+/**
+ * Bounded multiple producer, multiple consumer ring of completions. Sequence numbered
+ * cells as in Dmitry Vyukov's bounded MPMC queue, so neither side takes a lock.
+ * Only a consumer that blocks in wait_for, or a producer that finds the ring full, uses
+ * the mutex and the condition variables.
+ */
+template<typename R>
+class completion_queue {
+   typedef completion<R> item_type;
+   typedef typename std::aligned_storage<sizeof(item_type), alignof(item_type)>::type Storage;
+
+   struct Cell {
+      std::atomic<size_t> sequence;
+      Storage storage;
+   };
+
+   const size_t capacity_;
+   const size_t mask_;
+   std::unique_ptr<Cell[]> cells_;
+   alignas(64) std::atomic<size_t> enqueue_pos_;
+   alignas(64) std::atomic<size_t> dequeue_pos_;
+   alignas(64) std::atomic<int> waiters_;
+   std::atomic<int> full_waiters_;    // producers asleep on a full ring
+   std::mutex m_;
+   std::condition_variable data_cond_;
+   std::condition_variable space_cond_;
+
+   completion_queue& operator=(const completion_queue&) = delete;
+   completion_queue(const completion_queue& other) = delete;
+
+   static size_t round_up_power_of_two(size_t value) {
+      size_t power = 2;
+      while (power < value) {
+         power <<= 1;
+      }
+      return power;
+   }
+
+   bool try_push(item_type& item) {
+      size_t position = enqueue_pos_.load(std::memory_order_relaxed);
+      while (true) {
+         Cell& cell = cells_[position & mask_];
+         const size_t sequence = cell.sequence.load(std::memory_order_acquire);
+         const intptr_t difference = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(position);
+         if (0 == difference) {
+            if (enqueue_pos_.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+               ::new (&cell.storage) item_type(std::move(item));
+               cell.sequence.store(position + 1, std::memory_order_release);
+               return true;
+            }
+         } else if (difference < 0) {
+            return false; // full
+         } else {
+            position = enqueue_pos_.load(std::memory_order_relaxed);
+         }
+      }
+   }
+
+   void push(item_type item) {
+      if (!try_push(item)) {
+         std::unique_lock<std::mutex> lock(m_);
+         full_waiters_.fetch_add(1, std::memory_order_relaxed);
+         // pairs with the fence in try_pop: either we see the freed cell or the consumer sees us
+         std::atomic_thread_fence(std::memory_order_seq_cst);
+         while (!try_push(item)) {
+            space_cond_.wait(lock);
+         }
+         full_waiters_.fetch_sub(1, std::memory_order_relaxed);
+      }
+      // pairs with the fence in wait_for: either the waiter sees the item or we see the waiter
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+      if (waiters_.load(std::memory_order_relaxed) > 0) {
+         std::lock_guard<std::mutex> lock(m_);
+         data_cond_.notify_all();
+      }
+   }
+
+   template<typename F>
+   void run_and_complete(uint64_t tag, F& func, std::false_type /*void result*/) {
+      item_type item;
+      item.tag = tag;
+      try {
+         item.value = func();
+      } catch (...) {
+         item.error = std::current_exception();
+      }
+      push(std::move(item));
+   }
+
+   template<typename F>
+   void run_and_complete(uint64_t tag, F& func, std::true_type /*void result*/) {
+      item_type item;
+      item.tag = tag;
+      try {
+         func();
+      } catch (...) {
+         item.error = std::current_exception();
+      }
+      push(std::move(item));
+   }
+
+public:
+   typedef R result_type;
+
+   /// @param capacity rounded up to a power of two
+   explicit completion_queue(size_t capacity = 1024)
+      : capacity_(round_up_power_of_two(capacity))
+      , mask_(capacity_ - 1)
+      , cells_(new Cell[capacity_])
+      , enqueue_pos_(0)
+      , dequeue_pos_(0)
+      , waiters_(0)
+      , full_waiters_(0) {
+      for (size_t index = 0; index < capacity_; ++index) {
+         cells_[index].sequence.store(index, std::memory_order_relaxed);
+      }
+   }
+
+   ~completion_queue() {
+      item_type item;
+      while (try_pop(item)) {
+      }
+   }
+
+   /// Execute func and put its result or exception in the ring. Used by the workers
+   template<typename F>
+   void run_and_complete(uint64_t tag, F& func) {
+      run_and_complete(tag, func, std::is_void<R>());
+   }
+
+   /// \return immediately, with true if a completion was retrieved
+   bool try_pop(item_type& popped_item) {
+      size_t position = dequeue_pos_.load(std::memory_order_relaxed);
+      while (true) {
+         Cell& cell = cells_[position & mask_];
+         const size_t sequence = cell.sequence.load(std::memory_order_acquire);
+         const intptr_t difference = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(position + 1);
+         if (0 == difference) {
+            if (dequeue_pos_.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+               item_type* item = reinterpret_cast<item_type*>(&cell.storage);
+               popped_item = std::move(*item);
+               item->~item_type();
+               cell.sequence.store(position + mask_ + 1, std::memory_order_release);
+               std::atomic_thread_fence(std::memory_order_seq_cst);
+               if (full_waiters_.load(std::memory_order_relaxed) > 0) {
+                  std::lock_guard<std::mutex> lock(m_);
+                  space_cond_.notify_all();
+               }
+               return true;
+            }
+         } else if (difference < 0) {
+            return false; // empty
+         } else {
+            position = dequeue_pos_.load(std::memory_order_relaxed);
+         }
+      }
+   }
+
+   /// Append up to 'max' completions to 'out'. \return how many were appended
+   size_t drain(std::vector<item_type>& out, size_t max = SIZE_MAX) {
+      size_t count = 0;
+      item_type item;
+      while (count < max && try_pop(item)) {
+         out.push_back(std::move(item));
+         ++count;
+      }
+      return count;
+   }
+
+   /// Block until a completion is available or the timeout expires. \return true if one is available
+   template<typename Rep, typename Period>
+   bool wait_for(const std::chrono::duration<Rep, Period>& timeout) {
+      if (!empty()) {
+         return true;
+      }
+      std::unique_lock<std::mutex> lock(m_);
+      waiters_.fetch_add(1, std::memory_order_relaxed);
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+      const bool ready = data_cond_.wait_for(lock, timeout, [this] { return !empty(); });
+      waiters_.fetch_sub(1, std::memory_order_relaxed);
+      return ready;
+   }
+
+   /// wait_for and then drain. \return how many completions were appended
+   template<typename Rep, typename Period>
+   size_t wait_and_drain(std::vector<item_type>& out, const std::chrono::duration<Rep, Period>& timeout, size_t max = SIZE_MAX) {
+      if (!wait_for(timeout)) {
+         return 0;
+      }
+      return drain(out, max);
+   }
+
+   bool empty() const {
+      const size_t position = dequeue_pos_.load();
+      return cells_[position & mask_].sequence.load(std::memory_order_acquire) != position + 1;
+   }
+
+   /// \return snapshot of the number of completions in the ring
+   size_t size() const {
+      const size_t dequeued = dequeue_pos_.load();
+      const size_t enqueued = enqueue_pos_.load();
+      return enqueued > dequeued ? enqueued - dequeued : 0;
+   }
+
+   size_t capacity() const {
+      return capacity_;
+   }
+};
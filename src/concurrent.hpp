@@ -37,14 +37,30 @@
 //
 #pragma once
 
+#include <atomic>
+#include <cstdint>
 #include <thread>
 #include <future>
 #include <functional>
 #include <type_traits>
 #include <memory>
 #include <stdexcept>
+#include <tuple>
+#include <vector>
+#include "batch_table.hpp"
+#include "coalescing_table.hpp"
+#include "codel_policy.hpp"
+#include "concurrent_future.hpp"
+#include "concurrent_reaper.hpp"
 #include "moveoncopy.hpp"
+#include "shared_call_table.hpp"
 #include "shared_queue.hpp"
+#include "spsc_queue.hpp"
+#include "stall_watchdog.hpp"
+#include "wait_frame.hpp"
+#include "workload_recorder.hpp"
+
+template<typename R> class completion_queue; // completion_queue.hpp, for call_to and lambda_to
 
 namespace concurrent_helper {
    typedef std::function<void() > Callback;
@@ -62,12 +78,72 @@ namespace concurrent_helper {
       p.set_value();
    }
 
+   /** helper for non-void concurrent_promise */
+   template<typename Fut, typename F, typename T>
+   void set_value(concurrent_promise<Fut>& p, F& f, T& t) {
+      p.set_value(f(t));
+   }
+
+   /** helper for concurrent_promise of void */
+   template<typename F, typename T>
+   void set_value(concurrent_promise<void>& p, F& f, T& t) {
+      f(t);
+      p.set_value();
+   }
+
+   /** helper for non-void promises, 'done' runs after the call and before the value is set */
+   template<typename Fut, typename F, typename T, typename Done>
+   void set_value_after(std::promise<Fut>& p, F& f, T& t, Done done) {
+      Fut value = f(t);
+      done();
+      p.set_value(std::move(value));
+   }
+
+   /** helper for promise of void, see above */
+   template<typename F, typename T, typename Done>
+   void set_value_after(std::promise<void>& p, F& f, T& t, Done done) {
+      f(t);
+      done();
+      p.set_value();
+   }
+
+   /** @return a future that holds the exception for calling a nullptr instantiated worker */
+   template<typename R>
+   std::future<R> empty_worker_future() {
+      std::promise<R> p;
+      std::future<R> future_result = p.get_future();
+      p.set_exception(std::make_exception_ptr(std::runtime_error("nullptr instantiated worker")));
+      return future_result;
+   }
+
    template<typename R>
    bool is_ready(std::future<R> const& f) {
       return f.wait_for(std::chrono::microseconds(0)) == std::future_status::ready;
    }
 
 
+   /// The Queue parameter of concurrent<T, Queue> is either a queue type or a tag that selects one
+   template<typename Queue>
+   struct queue_type {
+      typedef Queue type;
+   };
+
+   /// single_producer: wait-free ring, a full ring makes the producer wait for the worker
+   template<>
+   struct queue_type<single_producer> {
+      typedef spsc_queue<Callback> type;
+   };
+
+
+   /// deleter for std::unique_ptr<concurrent<T>> that destroys with concurrent<T>::destroy_async
+   struct async_delete {
+      template<typename Concurrent>
+      void operator()(Concurrent* instance) const {
+         Concurrent::destroy_async(std::unique_ptr<Concurrent>(instance));
+      }
+   };
+
+
    // use case is to be able to check std::future from a continous processign thread
    // once the future is ready only then should the result be retrieved
    // (for possibly new chunk of work added to the concurrent worker
@@ -77,6 +153,38 @@ namespace concurrent_helper {
    }
 
 
+   /**
+    * call_site_tag and workload recording of a lambda_and_wait. It lives on the caller's
+    * stack next to the wait_frame, so the queued callback still holds just one pointer
+    */
+   template<typename Frame>
+   struct traced_wait {
+      Frame* frame;
+      task_monitor* monitor;
+      const char* tag;
+      workload_recorder* recorder;
+      uint32_t producer;
+      workload_recorder::clock::time_point submitted;
+
+      /// worker side. The caller may return as soon as frame->run() is done, copy what is used after it
+      void run() {
+         if (nullptr != tag) {
+            monitor->tag(tag);
+         }
+         if (nullptr == recorder) {
+            frame->run();
+            return;
+         }
+         workload_recorder* const recording = recorder;
+         const uint32_t from = producer;
+         const char* const call_site = tag;
+         const workload_recorder::clock::time_point queued = submitted;
+         const workload_recorder::clock::time_point start = workload_recorder::clock::now();
+         frame->run();
+         recording->record(queued, workload_recorder::clock::now() - start, from, call_site);
+      }
+   };
+
 
 } // namespace concurrent_helper
 
@@ -84,16 +192,84 @@ namespace concurrent_helper {
  * Basically a light weight active object. www.kjellkod.cc/active-object-with-cpp0x#TOC-Active-Object-the-C-11-way
  * all input happens in the background. At shutdown it exits only after all
  * queued requests are handled.
+ *
+ * The Queue of callbacks can be replaced, e.g. with fair_queue<concurrent_helper::Callback>.
+ * It must provide push, wait_and_pop, try_and_pop and size like shared_queue.
+ * The single_producer tag selects the spsc_queue for objects fed by one thread at a time.
+ * Queue specific members, like flush() for staging_queue, only compile with queues that have them.
+ * A stall_watchdog can watch the worker for calls that run too long.
  */
-template <class T> class concurrent {
+template <class T, class Queue = shared_queue<concurrent_helper::Callback>> class concurrent {
    mutable std::unique_ptr<T> _worker;
-   mutable shared_queue<concurrent_helper::Callback> _q;
+   mutable typename concurrent_helper::queue_type<Queue>::type _q;
    bool _done; // not atomic since only the thread is touching it
+   mutable concurrent_helper::coalescing_table _coalescing;
+   mutable concurrent_helper::batch_table<T> _batches;
+   mutable concurrent_helper::shared_call_table _shared_calls;
+   mutable codel_policy _codel; // only touched by the worker thread
+   mutable std::atomic<workload_recorder*> _recorder;
+   std::shared_ptr<concurrent_helper::task_monitor> _monitor;
    std::thread _thd;
 
    concurrent(const concurrent&) = delete;
    concurrent& operator=(const concurrent&) = delete;
 
+   /// all calls are queued here. A call queued after a batch stops it from growing
+   template<typename Call>
+   void _push(Call&& call) const {
+      _enqueue(std::forward<Call>(call));
+      _batches.close();
+   }
+
+   /// tagged with the caller's call_site_tag if it has one, and timed if a workload_recorder is attached
+   template<typename Call>
+   void _enqueue(Call&& call) const {
+      const char* tag = concurrent_helper::call_site_tag::current();
+      workload_recorder* recorder = _recorder.load(std::memory_order_acquire);
+      if (nullptr != recorder) {
+         _push_recorded(std::forward<Call>(call), tag, recorder);
+         return;
+      }
+      if (nullptr == tag) {
+         _q.push(std::forward<Call>(call));
+         return;
+      }
+      concurrent_helper::task_monitor* monitor = _monitor.get();
+      typename std::decay<Call>::type task(std::forward<Call>(call));
+      _q.push([monitor, tag, task = std::move(task)]() mutable {
+         monitor->tag(tag);
+         task();
+      });
+   }
+
+   template<typename Call>
+   void _push_recorded(Call&& call, const char* tag, workload_recorder* recorder) const {
+      typedef workload_recorder::clock clock;
+      concurrent_helper::task_monitor* monitor = _monitor.get();
+      const uint32_t producer = workload_recorder::producer_id();
+      const clock::time_point submitted = clock::now();
+      typename std::decay<Call>::type task(std::forward<Call>(call));
+      _q.push([monitor, tag, recorder, producer, submitted, task = std::move(task)]() mutable {
+         if (nullptr != tag) {
+            monitor->tag(tag);
+         }
+         const clock::time_point start = clock::now();
+         task();
+         recorder->record(submitted, clock::now() - start, producer, tag);
+      });
+   }
+
+   /// the watched worker keeps the start time of the call for the watchdog, no locks
+   void _run(concurrent_helper::Callback& call) {
+      if (_monitor->watched()) {
+         _monitor->begin();
+         call();
+         _monitor->end();
+      } else {
+         call();
+      }
+   }
+
  public:
 
    /**  Constructs an unique_ptr<T>  that is the background object
@@ -111,24 +287,53 @@ template <class T> class concurrent {
    concurrent(std::unique_ptr<T> worker)
       : _worker(std::move(worker))
       , _done(false)
+      , _recorder(nullptr)
+      , _monitor(std::make_shared<concurrent_helper::task_monitor>())
       , _thd([ = ] {
       concurrent_helper::Callback call;
       while (_worker && !_done) {
 
          _q.wait_and_pop(call);
-         call();
+         _run(call);
+      }
+      // a queue that is FIFO only per producer can still hold calls made before the shutdown
+      while (_worker && _q.try_and_pop(call)) {
+         _run(call);
       }
    }) {
+      _monitor->attach([this] { return _q.size(); });
    }
 
    /**
     * Clean shutdown. All pending messages are executed before the shutdown message is received
     */
    virtual ~concurrent() {
-      _q.push([ = ] {_done = true;});
+      _push([ = ] {_done = true;});
       if (_thd.joinable()) {
          _thd.join();
       }
+      _monitor->detach();
+   }
+
+   /**
+    * Destroy the instance on the background reaper thread. The queued calls are still
+    * executed, but the caller does not wait for them or for the thread to join.
+    * concurrent_reaper::wait_all() waits for all instances handed over this way.
+    * The deleter concurrent_helper::async_delete does the same for a std::unique_ptr.
+    *
+    * Example:   auto gone = concurrent<Connection>::destroy_async(std::move(connection));
+    *
+    * @return future that is ready when the instance is destroyed
+    */
+   static std::future<void> destroy_async(std::unique_ptr<concurrent> instance) {
+      auto destroyed = std::make_shared<std::promise<void>>();
+      std::future<void> future_result = destroyed->get_future();
+      std::shared_ptr<concurrent> owned(std::move(instance));
+      concurrent_reaper::instance().reap([owned = std::move(owned), destroyed]() mutable { // the only owner
+         owned.reset();
+         destroyed->set_value();
+      });
+      return future_result;
    }
 
    /**
@@ -159,7 +364,7 @@ template <class T> class concurrent {
       if (empty()) {
          p->set_exception(std::make_exception_ptr(std::runtime_error("nullptr instantiated worker")));
       } else {
-         _q.push([ = ]{
+         _push([ = ]{
             try {
                concurrent_helper::set_value(*p, func, *_worker);
             } catch (...) {
@@ -201,7 +406,7 @@ template <class T> class concurrent {
       auto bgCall = std::bind(func, _worker.get(), std::forward<Args>(args)...);
       task_type task(std::move(bgCall));
       std::future<result_type> result = task.get_future();
-      _q.push(MoveOnCopy<task_type>(std::move(task)));
+      _push(MoveOnCopy<task_type>(std::move(task)));
       return std::move(result);
    }
 
@@ -230,10 +435,374 @@ template <class T> class concurrent {
       // weak compiler support for expanding parameter pack in a lambda. std::function is the
       // work-around, With better compiler support it can be changed to:
       //       auto bgCall = [&, args...]{ return (_worker.*func)(args...); };
+      if (_batches.enabled()) {
+         auto enqueue = [this](concurrent_helper::Callback thunk) { _enqueue(std::move(thunk)); };
+         // submit only uses the args when it takes the call
+         if (_batches.submit(_worker.get(), func, enqueue, std::forward<Args>(args)...)) {
+            return;
+         }
+      }
+      auto bgCall = std::bind(func, _worker.get(), std::forward<Args>(args)...);
+      _push(bgCall);
+   }
+
+   /**
+    * Fuse fire(single, ...) calls that follow each other in the queue into one call of
+    * batched with all their arguments. The calls must come from the same thread, and any
+    * other call to the object ends the run, so the order of the calls is kept.
+    * Only fire() is fused, call() and lambda() are not.
+    *
+    * Example:   struct Index {
+    *               void insert(int key, std::string value);
+    *               void insert_batch(std::vector<std::tuple<int, std::string>>& calls);
+    *            };
+    *            index.batch_calls(&Index::insert, &Index::insert_batch);
+    *            index.fire(&Index::insert, 1, "one"); // queued
+    *            index.fire(&Index::insert, 2, "two"); // joins the queued batch
+    */
+   template<typename R, typename... Params>
+   void batch_calls(R (T::*single)(Params...),
+                    void (T::*batched)(std::vector<std::tuple<typename std::decay<Params>::type...>>&)) const {
+      _batches.add(single, batched);
+   }
+
+   /// @return number of fire() calls that joined a queued batch, see @ref batch_calls
+   size_t fused() const { return _batches.fused(); }
+
+   /**
+    * Like @ref fire but latest wins: if a call with the same key is still queued it is
+    * replaced by this one, and runs at the queue position of the replaced call. Bursts of
+    * updates where only the newest value per key matters cost one call per distinct key.
+    *
+    * WARNING: MAY THROW if instantiated with a null object, like @ref fire
+    *
+    * Example:   gauges.fire_coalesced(name, &Gauges::set, name, value);
+    *
+    * @param key compared by value with std::hash and ==, C strings as std::string
+    */
+   template<typename Key, typename AsyncCall, typename... Args>
+   void fire_coalesced(const Key& key, AsyncCall func, Args&& ... args) const noexcept(false) {
+      if (empty()) {
+         throw std::runtime_error("nullptr instantiated worker");
+      }
+      auto bgCall = std::bind(func, _worker.get(), std::forward<Args>(args)...);
+      auto queued = _coalescing.submit(key, bgCall);
+      if (queued) {
+         _push(std::move(queued));
+      }
+   }
+
+   /// @return number of @ref fire_coalesced calls that were replaced by a later call with the same key
+   size_t coalesced() const { return _coalescing.coalesced(); }
+
+   /**
+    * Like @ref call for idempotent calls. While a call for the key is queued or running,
+    * later calls for the key get the same std::shared_future instead of running it again.
+    * With @ref cache_shared_calls a successful result is also reused for a while.
+    *
+    * WARNING: a collapsed call may have been queued before this thread's own earlier calls.
+    * After a fire() that changes the data, call @ref invalidate for the key from the same
+    * thread before the next call_shared, so it does not get a result read before the change.
+    *
+    * Example:   auto price = catalog.call_shared(sku, &Catalog::lookup, sku);
+    *
+    * @param key identifies the request, different functions need different keys.
+    *            Compared by value with std::hash and ==, C strings as std::string
+    */
+   template<typename Key, typename AsyncCall, typename... Args>
+   auto call_shared(const Key& key, AsyncCall func, Args&& ... args) const -> std::shared_future<typename std::result_of< decltype(func)(T*, Args...)>::type> {
+      typedef typename std::result_of<decltype(func)(T*, Args...)>::type result_type;
+      if (empty()) {
+         return concurrent_helper::empty_worker_future<result_type>().share();
+      }
+      auto p = std::make_shared<std::promise<result_type>>();
+      auto shared = _shared_calls.share(key, p->get_future().share());
+      if (!shared.first) {
+         return shared.result;
+      }
+      const uint64_t id = shared.id;
+      auto bgCall = std::bind(func, _worker.get(), std::forward<Args>(args)...);
+      auto call = [bgCall](T&) mutable { return bgCall(); };
+      typename concurrent_helper::shared_call_table::key_type<Key> stored(key);
+      concurrent_helper::shared_call_table* table = &_shared_calls;
+      _push([ = ]() mutable {
+         try { // the table is updated before the callers see the result
+            concurrent_helper::set_value_after(*p, call, *_worker, [&] { table->complete<result_type>(stored, id, true); });
+         } catch (...) {
+            table->complete<result_type>(stored, id, false);
+            p->set_exception(std::current_exception());
+         }
+      });
+      return shared.result;
+   }
+
+   /**
+    * Cache successful @ref call_shared results, up to 'items' keys per key and result type.
+    * 0 items disables the cache, a ttl of 0 keeps results until evicted or invalidated.
+    */
+   void cache_shared_calls(size_t items, std::chrono::milliseconds ttl = std::chrono::milliseconds(0)) const {
+      _shared_calls.configure_cache(items, ttl);
+   }
+
+   /**
+    * Drop the cached @ref call_shared results for the key, and detach its pending call: later
+    * call_shared for the key queue a new call, and the detached one is not cached. Call it
+    * from inside the worker, e.g. in the lambda that changes the data, so no result computed
+    * before the change is cached after it. For read-your-writes call it also from the thread
+    * that queued the change, right after queueing it.
+    * Example:   catalog.lambda([&catalog, sku, price](Catalog& c) { c.update(sku, price); catalog.invalidate(sku); });
+    *            catalog.invalidate(sku);
+    */
+   template<typename Key>
+   void invalidate(const Key& key) const { _shared_calls.invalidate(key); }
+
+   /// Drop all cached @ref call_shared results, see @ref invalidate
+   void invalidate_all() const { _shared_calls.invalidate_all(); }
+
+   /// @return counters of @ref call_shared
+   shared_call_stats shared_calls() const { return _shared_calls.stats(); }
+
+   /**
+    * Like @ref lambda but returns a concurrent_future that supports completion callbacks,
+    * when_all and when_any.
+    *
+    * Example:   auto both = when_all(a.future_lambda([](Shard& s){ return s.count(); }),
+    *                                 b.future_lambda([](Shard& s){ return s.count(); }));
+    */
+   template<typename F>
+   auto future_lambda(F func) const -> concurrent_future<decltype(func(*_worker))> {
+      typedef decltype(func(*_worker)) result_type;
+      auto p = std::make_shared<concurrent_promise<result_type>>();
+      auto future_result = p->get_future();
+
+      if (empty()) {
+         p->set_exception(std::make_exception_ptr(std::runtime_error("nullptr instantiated worker")));
+      } else {
+         _push([ = ]() mutable {
+            try {
+               concurrent_helper::set_value(*p, func, *_worker);
+            } catch (...) {
+               p->set_exception(std::current_exception());
+            }
+         });
+      }
+      return future_result;
+   }
+
+   /**
+    * Like @ref call but returns a concurrent_future, see @ref future_lambda
+    * Example:   std::vector<concurrent_future<Row>> rows;
+    *            for (auto& shard : shards) { rows.push_back(shard->future_call(&Shard::lookup, key)); }
+    *            auto first = when_any(rows.begin(), rows.end());
+    */
+   template<typename AsyncCall, typename... Args>
+   auto future_call(AsyncCall func, Args&& ... args) const -> concurrent_future<typename std::result_of< decltype(func)(T*, Args...)>::type> {
+      auto bgCall = std::bind(func, std::placeholders::_1, std::forward<Args>(args)...);
+      return future_lambda([bgCall](T& worker) mutable { return bgCall(&worker); });
+   }
+
+   /**
+    * Like lambda(func).get() without its allocations: the call and its result slot stay
+    * on the caller's stack, and the caller spins briefly and then sleeps until the worker
+    * is done. Must not be called from the worker thread. An active call_site_tag or
+    * workload_recorder is kept on the stack too, it adds no allocation. The queue itself
+    * may allocate, e.g. the std::deque of shared_queue takes a new block every few calls.
+    *
+    * WARNING: rethrows the exception of func, and throws if instantiated with a null object
+    *
+    * Example:   size_t count = cache.lambda_and_wait([](Cache& c) { return c.size(); });
+    */
+   template<typename F>
+   auto lambda_and_wait(F func) const -> decltype(func(*_worker)) {
+      typedef decltype(func(*_worker)) result_type;
+      if (empty()) {
+         throw std::runtime_error("nullptr instantiated worker");
+      }
+      typedef concurrent_helper::wait_frame<result_type, F, T> frame_type;
+      frame_type frame(func, *_worker);
+      concurrent_helper::traced_wait<frame_type> traced{&frame, _monitor.get(), concurrent_helper::call_site_tag::current(),
+                                                        _recorder.load(std::memory_order_acquire), 0, {}};
+      if (nullptr != traced.recorder) {
+         traced.producer = workload_recorder::producer_id();
+         traced.submitted = workload_recorder::clock::now();
+      }
+      // one pointer, stored inside the std::function. Not through _enqueue, that would wrap it
+      if (nullptr == traced.tag && nullptr == traced.recorder) {
+         auto* waiting = &frame;
+         _q.push([waiting] { waiting->run(); });
+      } else {
+         auto* waiting = &traced;
+         _q.push([waiting] { waiting->run(); });
+      }
+      _batches.close();
+      return frame.get();
+   }
+
+   /**
+    * Like call(func, args...).get() without its allocations, see @ref lambda_and_wait.
+    * The arguments are passed by reference to the worker, the caller waits meanwhile.
+    *
+    * Example:   std::string greeting = h.call_and_wait(&Hello::greet, name);
+    */
+   template<typename AsyncCall, typename... Args>
+   auto call_and_wait(AsyncCall func, Args&& ... args) const -> typename std::result_of< decltype(func)(T*, Args...)>::type {
+      return lambda_and_wait([&](T& worker) -> typename std::result_of< decltype(func)(T*, Args...)>::type {
+         return (worker.*func)(std::forward<Args>(args)...);
+      });
+   }
+
+   /**
+    * Like @ref lambda, but the call may be shed under overload when the controlled delay
+    * policy is enabled, see @ref enable_codel. A shed call is not run and its future holds
+    * an overload_error.
+    */
+   template<typename F>
+   auto lambda_droppable(F func) const -> std::future<decltype(func(*_worker))> {
+      auto p = std::make_shared<std::promise<decltype(func(*_worker))>>();
+      auto future_result = p->get_future();
+
+      if (empty()) {
+         p->set_exception(std::make_exception_ptr(std::runtime_error("nullptr instantiated worker")));
+      } else {
+         const auto enqueued = codel_policy::clock::now();
+         _push([ = ]() mutable {
+            if (_codel.drop(enqueued)) {
+               p->set_exception(std::make_exception_ptr(overload_error("call shed by the controlled delay policy")));
+               return;
+            }
+            try {
+               concurrent_helper::set_value(*p, func, *_worker);
+            } catch (...) {
+               p->set_exception(std::current_exception());
+            }
+         });
+      }
+      return future_result;
+   }
+
+   /**
+    * Like @ref call, but the call may be shed under overload, see @ref lambda_droppable
+    * Example:   auto page = renderer.call_droppable(&Renderer::preview, id);
+    *            try { show(page.get()); } catch (const overload_error&) { show_placeholder(); }
+    */
+   template<typename AsyncCall, typename... Args>
+   auto call_droppable(AsyncCall func, Args&& ... args) const -> std::future<typename std::result_of< decltype(func)(T*, Args...)>::type> {
+      auto bgCall = std::bind(func, std::placeholders::_1, std::forward<Args>(args)...);
+      return lambda_droppable([bgCall](T& worker) mutable { return bgCall(&worker); });
+   }
+
+   /**
+    * Enable controlled delay (CoDel) shedding of droppable calls: when their time in the queue
+    * stays above config.target for config.interval, they are shed at an increasing rate until
+    * the queue delay is below target again. Takes effect in FIFO order with the queued calls.
+    */
+   void enable_codel(codel_config config = codel_config()) const {
+      _push([this, config] { _codel.configure(true, config); });
+   }
+
+   /// Run all droppable calls again, see @ref enable_codel
+   void disable_codel() const {
+      _push([this] { _codel.configure(false, codel_config()); });
+   }
+
+   /// @return counters of the droppable calls
+   codel_stats codel() const { return _codel.stats(); }
+
+   /**
+    * Record submit time, producer thread, call_site_tag and run time of every call
+    * made from now on, see workload_recorder.hpp. Replaces any earlier recorder.
+    * @param recorder must stay alive until @ref stop_recording has returned
+    */
+   void start_recording(workload_recorder& recorder) const {
+      _recorder.store(&recorder, std::memory_order_release);
+   }
+
+   /**
+    * Stop recording, and wait until the already queued recorded calls are done.
+    * Must not be called from the worker thread.
+    */
+   void stop_recording() const {
+      _recorder.store(nullptr, std::memory_order_release);
+      if (_worker) {
+         lambda_and_wait([](T&) {});
+      }
+   }
+
+   /**
+    * Like @ref call but instead of a std::future the result, or the exception, is put
+    * together with the tag in a completion queue. Many concurrent objects can share one
+    * completion queue, include "completion_queue.hpp" to use it.
+    *
+    * Example:   completion_queue<std::string> done;
+    *            h.call_to(done, 42, &Hello::foo);
+    *            std::vector<completion<std::string>> results;
+    *            done.wait_and_drain(results, std::chrono::milliseconds(10));
+    *
+    * @param cq completion queue that must outlive the call
+    * @param tag user tag that identifies the call in the completion queue
+    *
+    * WARNING: if cq is full when the call is done, the worker sleeps until cq is drained.
+    * Every call queued to this object waits meanwhile, so keep draining it.
+    */
+   template<typename R, typename AsyncCall, typename... Args>
+   void call_to(completion_queue<R>& cq, uint64_t tag, AsyncCall func, Args&& ... args) const {
+      if (empty()) {
+         auto failed = []() -> R { throw std::runtime_error("nullptr instantiated worker"); };
+         cq.run_and_complete(tag, failed);
+         return;
+      }
       auto bgCall = std::bind(func, _worker.get(), std::forward<Args>(args)...);
-      _q.push(bgCall);
+      completion_queue<R>* completions = &cq;
+      _push([ = ]() mutable { completions->run_and_complete(tag, bgCall); });
    }
 
+   /**
+    * Like @ref lambda but the result, or the exception, goes to a completion queue. See @ref call_to,
+    * also for the worker blocking on a full completion queue
+    * Example:   h.lambda_to(done, 42, [](Hello& object){ return object.foo(); });
+    */
+   template<typename R, typename F>
+   void lambda_to(completion_queue<R>& cq, uint64_t tag, F func) const {
+      if (empty()) {
+         auto failed = []() -> R { throw std::runtime_error("nullptr instantiated worker"); };
+         cq.run_and_complete(tag, failed);
+         return;
+      }
+      completion_queue<R>* completions = &cq;
+      _push([ = ]() mutable {
+         auto bgCall = [&] { return func(*_worker); };
+         completions->run_and_complete(tag, bgCall);
+      });
+   }
+
+   /// Publish the calling thread's queued calls now. Only for queues with flush(), e.g. staging_queue
+   void flush() const { _q.flush(); }
+
+   /// Call T::on_readable(fd) on the worker thread while fd is readable. Only for reactor_queue
+   void watch(int fd) const {
+      T* worker = _worker.get();
+      _q.watch(fd, [worker, fd] { worker->on_readable(fd); });
+   }
+
+   /// Stop watching fd, or cancel a timer. Only for reactor_queue
+   void unwatch(int fd) const { _q.unwatch(fd); }
+
+   /**
+    * Call func(T&) on the worker thread every period. Only for reactor_queue
+    * @return timer id for @ref unwatch
+    */
+   template<typename F>
+   int add_timer(std::chrono::milliseconds period, F func) const {
+      T* worker = _worker.get();
+      return _q.add_timer(period, [worker, func]() mutable { func(*worker); });
+   }
+
+   /// @return id of this object in stall_report
+   uint64_t instance_id() const { return _monitor->id(); }
+
+   /// @return what the worker shares with a stall_watchdog, see stall_watchdog::watch
+   std::shared_ptr<concurrent_helper::task_monitor> monitor() const { return _monitor; }
+
    /// return snapshot of size
    virtual size_t size() { return _q.size(); }
 };
@@ -0,0 +1,207 @@
+// PUBLIC DOMAIN LICENSE: https://github.com/KjellKod/Concurrent/blob/master/LICENSE
+//
+// Repository: https://github.com/KjellKod/Concurrent
+//
+// Flat Combining Concurrent Wrapper
+// ===============================
+// Same usage and guarantees as concurrent<T>: calls are executed one at a time, in FIFO order.
+// There is no background thread. A call is published to the publication list and then the
+// calling thread tries to become the combiner. The combiner executes all published calls,
+// including the ones from other threads, and completes their futures. Threads that lose
+// the race return immediately, the current combiner picks up their calls.
+//
+// This removes the hand-off to a sleeping worker thread and is suited for objects with low
+// call rates but latency critical calls. Under a continuous high call rate one producer can
+// end up executing calls for the others for a long time, use concurrent<T> for those objects.
+//
+// example usage:
+//  concurrent_fc<Hello> h;
+//  std::future<std::string> result = h.call(&Hello::world);
+//
+#pragma once
+
+#include <atomic>
+#include <future>
+#include <functional>
+#include <type_traits>
+#include <memory>
+#include <stdexcept>
+#include <thread>
+#include "concurrent.hpp"
+#include "moveoncopy.hpp"
+
+/**
+ * Light weight active object without a thread of its own. See concurrent<T>.
+ */
+template <class T> class concurrent_fc {
+   /// intrusive multiple producer, single consumer list. The consumer is the combiner
+   struct Node {
+      std::atomic<Node*> next;
+      concurrent_helper::Callback call;
+      Node() : next(nullptr) {}
+   };
+
+   mutable std::unique_ptr<T> _worker;
+   mutable std::atomic<Node*> _tail;  // producers publish here
+   mutable std::atomic<Node*> _head;  // only moved by the combiner. Always a consumed node
+   mutable std::atomic<bool> _combining;
+   mutable std::atomic<size_t> _size;
+   mutable std::atomic<int> _submitting; // threads inside submit. Their last access to the object is the decrement
+
+   concurrent_fc(const concurrent_fc&) = delete;
+   concurrent_fc& operator=(const concurrent_fc&) = delete;
+
+   void publish(concurrent_helper::Callback call) const {
+      Node* node = new Node;
+      node->call = std::move(call);
+      ++_size;
+      Node* previous = _tail.exchange(node);
+      previous->next.store(node);
+   }
+
+   bool has_pending() const {
+      return _tail.load() != _head;
+   }
+
+   /// an exception escaping a call terminates just like it does on the concurrent<T> thread
+   void execute_pending() const noexcept {
+      while (has_pending()) {
+         Node* head = _head.load();
+         Node* next = head->next.load();
+         if (nullptr == next) {
+            std::this_thread::yield(); // a producer is between publish steps
+            continue;
+         }
+         _head.store(next);
+         delete head;
+         concurrent_helper::Callback call = std::move(next->call);
+         --_size;
+         call();
+      }
+   }
+
+   /**
+    * Become the combiner if nobody else is. After releasing the combiner role the list is
+    * checked again: a producer that failed to take over while we were combining relies on us
+    */
+   void combine() const {
+      while (has_pending()) {
+         if (_combining.exchange(true)) {
+            return;
+         }
+         execute_pending();
+         _combining.store(false);
+      }
+   }
+
+   /// the call may complete, and its caller destroy the object, before combine() returns
+   void submit(concurrent_helper::Callback call) const {
+      _submitting.fetch_add(1, std::memory_order_relaxed);
+      publish(std::move(call));
+      combine();
+      _submitting.fetch_sub(1, std::memory_order_release);
+   }
+
+ public:
+
+   /**  Constructs an unique_ptr<T>  that is the wrapped object
+    * @param args to construct the unique_ptr<T> in-place
+    */
+   template<typename ... Args>
+   concurrent_fc(Args&& ... args)
+      : concurrent_fc(std::make_unique<T>(std::forward<Args>(args)...)) {
+   }
+
+   /**
+    * Moves in a unique_ptr<T> to be the wrapped object
+    * @param worker to be the wrapped object
+    */
+   concurrent_fc(std::unique_ptr<T> worker)
+      : _worker(std::move(worker))
+      , _tail(new Node)
+      , _head(_tail.load())
+      , _combining(false)
+      , _size(0)
+      , _submitting(0) {
+   }
+
+   /**
+    * Clean shutdown. Waits for a combiner on another thread that may still be executing calls,
+    * and for producers that still check the list after their call was completed
+    */
+   virtual ~concurrent_fc() {
+      combine();
+      while (_combining.load() || has_pending() || 0 != _submitting.load(std::memory_order_acquire)) {
+         std::this_thread::yield();
+         combine();
+      }
+      delete _head.load();
+   }
+
+   /// @return whether the wrapped object is missing
+   bool empty() const {
+      return !_worker;
+   }
+
+   /**
+    * Herb Sutter's lambda approach, see concurrent<T>::lambda
+    *
+    * Example:   h.lambda( [](Hello& object){ object.foo(); };
+    */
+   template<typename F>
+   auto lambda(F func) const -> std::future<decltype(func(*_worker))> {
+      typedef decltype(func(*_worker)) result_type;
+      if (empty()) {
+         return concurrent_helper::empty_worker_future<result_type>();
+      }
+
+      auto p = std::make_shared<std::promise<result_type>>();
+      auto future_result = p->get_future();
+      T* object = _worker.get();
+      submit([ = ] {
+         try {
+            concurrent_helper::set_value(*p, func, *object);
+         } catch (...) {
+            p->set_exception(std::current_exception());
+         }
+      });
+      return future_result;
+   }
+
+   /**
+    * Pointer-to-member call, see concurrent<T>::call
+    *
+    * Example:   std::future<X> result = h.call(&Hello::foo);
+    */
+   template<typename AsyncCall, typename... Args>
+   auto call(AsyncCall func, Args&& ... args) const -> std::future<typename std::result_of< decltype(func)(T*, Args...)>::type> {
+      typedef typename std::result_of<decltype(func)(T*, Args...)>::type result_type;
+      typedef std::packaged_task<result_type()> task_type;
+
+      if (empty()) {
+         return concurrent_helper::empty_worker_future<result_type>();
+      }
+
+      auto bgCall = std::bind(func, _worker.get(), std::forward<Args>(args)...);
+      task_type task(std::move(bgCall));
+      std::future<result_type> result = task.get_future();
+      submit(MoveOnCopy<task_type>(std::move(task)));
+      return result;
+   }
+
+   /**
+    * Fire and forget, see concurrent<T>::fire
+    *
+    * WARNING: This function call MAY THROW if instantiated with a null object.
+    */
+   template<typename AsyncCall, typename... Args>
+   void fire(AsyncCall func, Args&& ... args) const noexcept(false) {
+      if (empty()) {
+         throw std::runtime_error("nullptr instantiated worker");
+      }
+      submit(std::bind(func, _worker.get(), std::forward<Args>(args)...));
+   }
+
+   /// return snapshot of the number of published but not yet executed calls
+   virtual size_t size() { return _size.load(); }
+};
@@ -0,0 +1,328 @@
+/** ==========================================================================
+ * 2014 by KjellKod.cc. This is PUBLIC DOMAIN to use at your own risk and comes
+ * with no warranties. This code is yours to share, use and modify with no
+ * strings attached and no restrictions or obligations.
+ * ============================================================================
+ *
+ * Future type of the concurrent wrapper with completion callbacks, and the when_all /
+ * when_any combinators built on them. Nothing is polled: the thread that sets the
+ * value runs the callbacks, the last (or first) one of them completes the combined future.
+ *
+ * concurrent_future<R> is copyable and can be read many times, like std::shared_future.
+ *
+ * example usage:
+ *   concurrent<Shard> a, b;
+ *   auto both = when_all(a.future_call(&Shard::lookup, key), b.future_call(&Shard::lookup, key));
+ *   auto results = both.get();   // std::tuple<concurrent_future<Row>, concurrent_future<Row>>
+ *
+ *   std::vector<concurrent_future<Row>> replies = ...;
+ *   auto first = when_any(replies.begin(), replies.end()).get();
+ *   Row row = first.futures[first.index].get();
+ * ============================================================================*/
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <future>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace concurrent_future_detail {
+   template<typename R>
+   struct value_holder {
+      std::unique_ptr<R> value;
+      void set(R v) { value.reset(new R(std::move(v))); }
+      const R& get() const { return *value; }
+   };
+
+   template<>
+   struct value_holder<void> {
+      void set() {}
+      void get() const {}
+   };
+
+   template<typename R>
+   struct reference_type {
+      typedef const R& type;
+   };
+
+   template<>
+   struct reference_type<void> {
+      typedef void type;
+   };
+
+   /** State shared by a promise and all copies of its future */
+   template<typename R>
+   struct shared_state {
+      std::mutex m;
+      std::condition_variable ready_cond;
+      bool ready = false;
+      value_holder<R> holder;
+      std::exception_ptr error;
+      std::vector<std::function<void()>> callbacks;
+
+      /// set_value or set_exception under the lock, then run the callbacks outside of it
+      template<typename Setter>
+      void complete(Setter setter) {
+         std::vector<std::function<void()>> to_run;
+         {
+            std::lock_guard<std::mutex> lock(m);
+            if (ready) {
+               throw std::future_error(std::future_errc::promise_already_satisfied);
+            }
+            setter();
+            ready = true;
+            to_run.swap(callbacks);
+         }
+         ready_cond.notify_all();
+         for (auto& callback : to_run) {
+            callback();
+         }
+      }
+
+      void on_ready(std::function<void()> callback) {
+         {
+            std::lock_guard<std::mutex> lock(m);
+            if (!ready) {
+               callbacks.push_back(std::move(callback));
+               return;
+            }
+         }
+         callback();
+      }
+
+      void wait() {
+         std::unique_lock<std::mutex> lock(m);
+         ready_cond.wait(lock, [this] { return ready; });
+      }
+   };
+} // namespace concurrent_future_detail
+
+
+template<typename R>
+class concurrent_future {
+   typedef concurrent_future_detail::shared_state<R> state_type;
+   std::shared_ptr<state_type> state_;
+
+   template<typename> friend class concurrent_promise;
+   explicit concurrent_future(std::shared_ptr<state_type> state) : state_(std::move(state)) {}
+
+public:
+   typedef R value_type;
+   typedef typename concurrent_future_detail::reference_type<R>::type reference;
+
+   concurrent_future() = default;
+
+   bool valid() const { return nullptr != state_; }
+
+   bool is_ready() const {
+      std::lock_guard<std::mutex> lock(state_->m);
+      return state_->ready;
+   }
+
+   void wait() const { state_->wait(); }
+
+   template<typename Rep, typename Period>
+   std::future_status wait_for(const std::chrono::duration<Rep, Period>& timeout) const {
+      std::unique_lock<std::mutex> lock(state_->m);
+      const bool ready = state_->ready_cond.wait_for(lock, timeout, [this] { return state_->ready; });
+      return ready ? std::future_status::ready : std::future_status::timeout;
+   }
+
+   /// wait for the value, or rethrow the exception. Can be called many times
+   reference get() const {
+      state_->wait();
+      if (state_->error) {
+         std::rethrow_exception(state_->error);
+      }
+      return state_->holder.get();
+   }
+
+   /**
+    * Run 'callback' when the future is ready: on the thread that sets the value, or right
+    * away on this thread if it is ready already. The callback must not throw
+    */
+   void on_ready(std::function<void()> callback) const {
+      state_->on_ready(std::move(callback));
+   }
+};
+
+
+template<typename R>
+class concurrent_promise {
+   typedef concurrent_future_detail::shared_state<R> state_type;
+   std::shared_ptr<state_type> state_;
+
+   concurrent_promise(const concurrent_promise&) = delete;
+   concurrent_promise& operator=(const concurrent_promise&) = delete;
+
+public:
+   concurrent_promise() : state_(std::make_shared<state_type>()) {}
+   concurrent_promise(concurrent_promise&&) = default;
+   concurrent_promise& operator=(concurrent_promise&&) = default;
+
+   /// A promise that goes away without a value leaves a broken_promise in the future
+   ~concurrent_promise() {
+      if (!state_) {
+         return;
+      }
+      bool ready;
+      {
+         std::lock_guard<std::mutex> lock(state_->m);
+         ready = state_->ready;
+      }
+      if (!ready) {
+         set_exception(std::make_exception_ptr(std::future_error(std::future_errc::broken_promise)));
+      }
+   }
+
+   concurrent_future<R> get_future() const {
+      return concurrent_future<R>(state_);
+   }
+
+   /// set_value(value) or, for concurrent_promise<void>, set_value()
+   template<typename... V>
+   void set_value(V&& ... value) {
+      state_type& state = *state_;
+      auto args = std::forward_as_tuple(std::forward<V>(value)...);
+      state.complete([&] { set_holder(state.holder, args, std::integral_constant<bool, 0 == sizeof...(V)>()); });
+   }
+
+   void set_exception(std::exception_ptr error) {
+      state_type& state = *state_;
+      state.complete([&] { state.error = error; });
+   }
+
+private:
+   template<typename Holder, typename Tuple>
+   static void set_holder(Holder& holder, Tuple&, std::true_type /*no value*/) {
+      holder.set();
+   }
+
+   template<typename Holder, typename Tuple>
+   static void set_holder(Holder& holder, Tuple& args, std::false_type /*no value*/) {
+      holder.set(std::forward<typename std::tuple_element<0, Tuple>::type>(std::get<0>(args)));
+   }
+};
+
+
+/** Result of when_any: the futures and the index of the first one that was ready */
+template<typename Sequence>
+struct when_any_result {
+   size_t index;
+   Sequence futures;
+};
+
+
+namespace concurrent_future_detail {
+   template<typename Tuple, typename F, size_t... Index>
+   void for_each(Tuple& tuple, F func, std::index_sequence<Index...>) {
+      (void)std::initializer_list<int>{(func(std::get<Index>(tuple)), 0)...};
+   }
+
+   template<typename Future>
+   struct is_concurrent_future : std::false_type {};
+
+   template<typename R>
+   struct is_concurrent_future<concurrent_future<R>> : std::true_type {};
+
+   template<typename Iterator>
+   using iterated_future = typename std::enable_if<
+      is_concurrent_future<typename std::iterator_traits<Iterator>::value_type>::value,
+      typename std::iterator_traits<Iterator>::value_type>::type;
+} // namespace concurrent_future_detail
+
+
+/**
+ * @return a future that is ready when all of the futures are ready. It holds the futures,
+ *         exceptions stay in them and are not rethrown by the combined future
+ */
+template<typename... R>
+concurrent_future<std::tuple<concurrent_future<R>...>> when_all(concurrent_future<R>... futures) {
+   typedef std::tuple<concurrent_future<R>...> Sequence;
+   struct Context {
+      Sequence futures;
+      std::atomic<size_t> remaining;
+      concurrent_promise<Sequence> promise;
+      Context(Sequence f) : futures(std::move(f)), remaining(sizeof...(R)) {}
+   };
+   auto context = std::make_shared<Context>(Sequence(std::move(futures)...));
+   auto result = context->promise.get_future();
+   if (0 == sizeof...(R)) {
+      context->promise.set_value(Sequence{});
+      return result;
+   }
+   concurrent_future_detail::for_each(context->futures, [&context](auto& future) {
+      future.on_ready([context] {
+         if (1 == context->remaining.fetch_sub(1)) {
+            context->promise.set_value(context->futures);
+         }
+      });
+   }, std::index_sequence_for<R...>());
+   return result;
+}
+
+/// when_all over a range of concurrent_future<R>
+template<typename Iterator, typename Future = concurrent_future_detail::iterated_future<Iterator>>
+concurrent_future<std::vector<Future>> when_all(Iterator first, Iterator last) {
+   typedef std::vector<Future> Sequence;
+   struct Context {
+      Sequence futures;
+      std::atomic<size_t> remaining;
+      concurrent_promise<Sequence> promise;
+      Context(Sequence f) : futures(std::move(f)), remaining(futures.size()) {}
+   };
+   auto context = std::make_shared<Context>(Sequence(first, last));
+   auto result = context->promise.get_future();
+   if (context->futures.empty()) {
+      context->promise.set_value(Sequence{});
+      return result;
+   }
+   for (auto& future : context->futures) {
+      future.on_ready([context] {
+         if (1 == context->remaining.fetch_sub(1)) {
+            context->promise.set_value(context->futures);
+         }
+      });
+   }
+   return result;
+}
+
+/**
+ * @return a future that is ready as soon as one of the futures is ready. It holds the futures
+ *         and the index of the first ready one. An empty range gives index size_t(-1)
+ */
+template<typename Iterator, typename Future = concurrent_future_detail::iterated_future<Iterator>>
+concurrent_future<when_any_result<std::vector<Future>>> when_any(Iterator first, Iterator last) {
+   typedef std::vector<Future> Sequence;
+   struct Context {
+      Sequence futures;
+      std::atomic<bool> done;
+      concurrent_promise<when_any_result<Sequence>> promise;
+      Context(Sequence f) : futures(std::move(f)), done(false) {}
+   };
+   auto context = std::make_shared<Context>(Sequence(first, last));
+   auto result = context->promise.get_future();
+   if (context->futures.empty()) {
+      context->promise.set_value(when_any_result<Sequence> {static_cast<size_t>(-1), Sequence{}});
+      return result;
+   }
+   for (size_t index = 0; index < context->futures.size(); ++index) {
+      context->futures[index].on_ready([context, index] {
+         if (!context->done.exchange(true)) {
+            context->promise.set_value(when_any_result<Sequence> {index, context->futures});
+         }
+      });
+   }
+   return result;
+}
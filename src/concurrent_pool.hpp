@@ -0,0 +1,286 @@
+// PUBLIC DOMAIN LICENSE: https://github.com/KjellKod/Concurrent/blob/master/LICENSE
+//
+// Repository: https://github.com/KjellKod/Concurrent
+//
+// Elastic Replica Pool
+// ===============================
+// For stateless or cheaply clonable objects, e.g. a compressor or a parser.
+// Between min and max replicas of T are each running on their own thread and all of them
+// consume one queue. There is NO ordering between calls executed on different replicas.
+//
+// A replica is added when the queue depth passes a threshold, or when a call waited in the
+// queue longer than a threshold, and no replica is idle. A replica that has been idle for
+// the cool-down period is retired, never going below the minimum.
+//
+// example usage:
+//  pool_config config;
+//  config.max_replicas = 8;
+//  concurrent_pool<Compressor> compressors{config, level};   // each replica is Compressor(level)
+//  std::future<Bytes> zipped = compressors.call(&Compressor::zip, payload);
+//
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include "concurrent.hpp"
+#include "moveoncopy.hpp"
+
+/** A scaling decision of a concurrent_pool */
+struct scaling_event {
+   enum class Kind { Added, Retired };
+   Kind kind;
+   size_t replicas;     // replicas after the event
+   size_t queue_depth;  // queue depth when the event happened
+};
+
+/** Scaling limits and thresholds of a concurrent_pool */
+struct pool_config {
+   size_t min_replicas = 1;
+   size_t max_replicas = std::max<size_t>(1, std::thread::hardware_concurrency());
+   size_t depth_threshold = 16;                            // queued calls before adding a replica
+   std::chrono::microseconds wait_threshold{10000};        // queue wait before adding a replica
+   std::chrono::milliseconds cool_down{1000};              // idle time before retiring a replica
+   std::function<void(const scaling_event&)> on_scaling;   // optional, called outside the pool lock
+};
+
+
+template <class T> class concurrent_pool {
+   typedef std::chrono::steady_clock clock;
+
+   struct Job {
+      std::function<void(T&)> run;
+      clock::time_point enqueued;
+   };
+
+   struct Replica {
+      std::thread thread;
+      std::atomic<bool> finished{false};
+   };
+
+   const pool_config _config;
+   std::function<std::unique_ptr<T>()> _factory;
+
+   mutable std::mutex _m;
+   mutable std::condition_variable _data_cond;
+   mutable std::deque<Job> _jobs;
+   mutable std::list<Replica> _replicas;  // running and finished but not yet joined
+   mutable size_t _running;
+   mutable size_t _idle;
+   mutable bool _stopping;
+   mutable std::atomic<size_t> _scale_ups;
+   mutable std::atomic<size_t> _scale_downs;
+
+   concurrent_pool(const concurrent_pool&) = delete;
+   concurrent_pool& operator=(const concurrent_pool&) = delete;
+
+   void notify(scaling_event::Kind kind, size_t replicas, size_t depth) const {
+      if (_config.on_scaling) {
+         _config.on_scaling(scaling_event{kind, replicas, depth});
+      }
+   }
+
+   /// join replicas that retired, called with the lock held. They no longer need the lock
+   void reap_locked() const {
+      for (auto it = _replicas.begin(); it != _replicas.end();) {
+         if (it->finished.load()) {
+            it->thread.join();
+            it = _replicas.erase(it);
+         } else {
+            ++it;
+         }
+      }
+   }
+
+   void add_replica_locked() const {
+      reap_locked();
+      _replicas.emplace_back();
+      Replica& replica = _replicas.back();
+      ++_running;
+      replica.thread = std::thread([this, &replica] { run(replica); });
+   }
+
+   /// @return true if a replica was added
+   bool scale_up_locked(clock::duration waited) const {
+      const bool busy = _jobs.size() > _config.depth_threshold || waited > _config.wait_threshold;
+      if (!busy || _idle > 0 || _running >= _config.max_replicas || _stopping) {
+         return false;
+      }
+      add_replica_locked();
+      ++_scale_ups;
+      return true;
+   }
+
+   void run(Replica& replica) const {
+      std::unique_ptr<T> object = _factory();
+      std::unique_lock<std::mutex> lock(_m);
+      while (true) {
+         ++_idle;
+         const bool woken = _data_cond.wait_for(lock, _config.cool_down, [this] {
+            return !_jobs.empty() || _stopping;
+         });
+         --_idle;
+
+         if (_jobs.empty()) {
+            if (_stopping) {
+               break;
+            }
+            if (!woken && _running > _config.min_replicas) {
+               ++_scale_downs;
+               --_running;
+               const size_t replicas = _running;
+               lock.unlock();
+               notify(scaling_event::Kind::Retired, replicas, 0);
+               object.reset();
+               replica.finished.store(true);
+               return;
+            }
+            continue;
+         }
+
+         Job job = std::move(_jobs.front());
+         _jobs.pop_front();
+         const bool added = scale_up_locked(clock::now() - job.enqueued);
+         const size_t replicas = _running;
+         const size_t depth = _jobs.size();
+         lock.unlock();
+         if (added) {
+            notify(scaling_event::Kind::Added, replicas, depth);
+         }
+         job.run(*object);
+         lock.lock();
+      }
+      --_running;
+      lock.unlock();
+      object.reset();
+      replica.finished.store(true);
+   }
+
+   void push(std::function<void(T&)> run) const {
+      std::unique_lock<std::mutex> lock(_m);
+      _jobs.push_back(Job{std::move(run), clock::now()});
+      const bool added = scale_up_locked(clock::duration::zero());
+      const size_t replicas = _running;
+      const size_t depth = _jobs.size();
+      lock.unlock();
+      _data_cond.notify_one();
+      if (added) {
+         notify(scaling_event::Kind::Added, replicas, depth);
+      }
+   }
+
+ public:
+   /**
+    * Every replica is constructed as T(args...)
+    * @param config replica limits and scaling thresholds
+    */
+   template<typename ... Args, typename = typename std::enable_if<std::is_constructible<T, Args...>::value>::type>
+   explicit concurrent_pool(pool_config config, Args&& ... args)
+      : concurrent_pool(std::move(config), std::function<std::unique_ptr<T>()>([args...] {
+         return std::make_unique<T>(args...);
+      })) {
+   }
+
+   /**
+    * @param config replica limits and scaling thresholds
+    * @param factory creates one replica, e.g. a clone of a prototype
+    */
+   concurrent_pool(pool_config config, std::function<std::unique_ptr<T>()> factory)
+      : _config(std::move(config))
+      , _factory(std::move(factory))
+      , _running(0)
+      , _idle(0)
+      , _stopping(false)
+      , _scale_ups(0)
+      , _scale_downs(0) {
+      std::lock_guard<std::mutex> lock(_m);
+      for (size_t index = 0; index < std::max<size_t>(1, _config.min_replicas); ++index) {
+         add_replica_locked();
+      }
+   }
+
+   /**
+    * Clean shutdown. All queued calls are executed before the replicas exit
+    */
+   virtual ~concurrent_pool() {
+      {
+         std::lock_guard<std::mutex> lock(_m);
+         _stopping = true;
+      }
+      _data_cond.notify_all();
+      for (auto& replica : _replicas) {
+         replica.thread.join();
+      }
+   }
+
+   /**
+    * Executed on any of the replicas
+    * Example:   pool.lambda( [](Parser& parser){ return parser.parse(text); };
+    */
+   template<typename F>
+   auto lambda(F func) const -> std::future<decltype(func(std::declval<T&>()))> {
+      typedef decltype(func(std::declval<T&>())) result_type;
+      auto p = std::make_shared<std::promise<result_type>>();
+      auto future_result = p->get_future();
+      push([p, func](T& object) mutable {
+         try {
+            concurrent_helper::set_value(*p, func, object);
+         } catch (...) {
+            p->set_exception(std::current_exception());
+         }
+      });
+      return future_result;
+   }
+
+   /**
+    * Executed on any of the replicas
+    * Example:   std::future<Tree> result = pool.call(&Parser::parse, text);
+    */
+   template<typename AsyncCall, typename... Args>
+   auto call(AsyncCall func, Args&& ... args) const -> std::future<typename std::result_of< decltype(func)(T*, Args...)>::type> {
+      typedef typename std::result_of<decltype(func)(T*, Args...)>::type result_type;
+      typedef std::packaged_task<result_type(T*)> task_type;
+
+      task_type task(std::bind(func, std::placeholders::_1, std::forward<Args>(args)...));
+      std::future<result_type> result = task.get_future();
+      MoveOnCopy<task_type> moveable(std::move(task));
+      push([moveable](T& object) { moveable._move_only(&object); });
+      return result;
+   }
+
+   /// Fire and forget on any of the replicas
+   template<typename AsyncCall, typename... Args>
+   void fire(AsyncCall func, Args&& ... args) const {
+      auto bgCall = std::bind(func, std::placeholders::_1, std::forward<Args>(args)...);
+      push([bgCall](T& object) mutable { bgCall(&object); });
+   }
+
+   /// @return current number of replicas
+   size_t replicas() const {
+      std::lock_guard<std::mutex> lock(_m);
+      return _running;
+   }
+
+   /// @return number of replicas added because the queue was busy
+   size_t scale_ups() const { return _scale_ups.load(); }
+
+   /// @return number of replicas retired after being idle
+   size_t scale_downs() const { return _scale_downs.load(); }
+
+   /// return snapshot of the queue depth
+   virtual size_t size() {
+      std::lock_guard<std::mutex> lock(_m);
+      return _jobs.size();
+   }
+};
@@ -0,0 +1,96 @@
+/** ==========================================================================
+ * 2014 by KjellKod.cc. This is PUBLIC DOMAIN to use at your own risk and comes
+ * with no warranties. This code is yours to share, use and modify with no
+ * strings attached and no restrictions or obligations.
+ * ============================================================================
+ *
+ * Background thread that destroys concurrent<T> objects for concurrent<T>::destroy_async.
+ * The destructor of a concurrent<T> waits for its queued calls and joins its thread,
+ * the reaper does that off the caller's path.
+ *
+ *    auto done = concurrent<Connection>::destroy_async(std::move(connection));
+ *    ...
+ *    concurrent_reaper::wait_all(); // at process exit, all handed over objects are gone
+ * ============================================================================*/
+
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <utility>
+
+class concurrent_reaper {
+   std::mutex _m;
+   std::condition_variable _cond;
+   std::deque<std::function<void()>> _destroy;
+   size_t _pending;
+   bool _stop;
+   std::thread _thd;
+
+   concurrent_reaper(const concurrent_reaper&) = delete;
+   concurrent_reaper& operator=(const concurrent_reaper&) = delete;
+
+   concurrent_reaper() : _pending(0), _stop(false), _thd([this] { run(); }) {}
+
+   /// destroys what is handed over, and everything that is left before it stops
+   void run() {
+      std::unique_lock<std::mutex> lock(_m);
+      while (true) {
+         _cond.wait(lock, [this] { return _stop || !_destroy.empty(); });
+         if (_destroy.empty()) {
+            return;
+         }
+         auto destroy = std::move(_destroy.front());
+         _destroy.pop_front();
+         lock.unlock();
+         destroy();
+         destroy = nullptr;
+         lock.lock();
+         --_pending;
+         _cond.notify_all();
+      }
+   }
+
+ public:
+   ~concurrent_reaper() {
+      {
+         std::lock_guard<std::mutex> lock(_m);
+         _stop = true;
+      }
+      _cond.notify_all();
+      _thd.join();
+   }
+
+   static concurrent_reaper& instance() {
+      static concurrent_reaper reaper;
+      return reaper;
+   }
+
+   /// run 'destroy' on the reaper thread
+   void reap(std::function<void()> destroy) {
+      {
+         std::lock_guard<std::mutex> lock(_m);
+         _destroy.push_back(std::move(destroy));
+         ++_pending;
+      }
+      _cond.notify_all();
+   }
+
+   /// Wait until everything handed over so far, and anything handed over meanwhile, is destroyed
+   static void wait_all() {
+      concurrent_reaper& reaper = instance();
+      std::unique_lock<std::mutex> lock(reaper._m);
+      reaper._cond.wait(lock, [&reaper] { return 0 == reaper._pending; });
+   }
+
+   /// @return number of objects handed over and not yet destroyed
+   static size_t pending() {
+      concurrent_reaper& reaper = instance();
+      std::lock_guard<std::mutex> lock(reaper._m);
+      return reaper._pending;
+   }
+};
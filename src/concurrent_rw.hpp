@@ -0,0 +1,280 @@
+// PUBLIC DOMAIN LICENSE: https://github.com/KjellKod/Concurrent/blob/master/LICENSE
+//
+// Repository: https://github.com/KjellKod/Concurrent
+//
+// Reader/Writer Concurrent Wrapper
+// ===============================
+// Same usage as concurrent<T> but calls that cannot modify the wrapped object are
+// executed in parallel on a small pool of reader threads.
+//
+// 1) A lambda that takes the wrapped object by const reference is a read
+// 2) A call to a const member function is a read
+// 3) Everything else is a write, also a generic lambda: [](const auto& t) can not be
+//    classified without instantiating its body, name the type to make it a read. A write waits for all in-flight reads to finish and
+//    later reads are not started until the write is done.
+//
+// All calls are dispatched in FIFO order from one queue, so the result is the same as
+// if every call was executed one by one in submission order.
+//
+// example usage:
+//  struct Table { int lookup(int key) const; void insert(int key, int value); };
+//  concurrent_rw<Table> table;
+//  table.call(&Table::insert, 1, 2);              // write
+//  auto a = table.call(&Table::lookup, 1);         // read, parallel with other reads
+//  auto b = table.lambda([](const Table& t) { return t.lookup(1); }); // read
+//
+#pragma once
+
+#include <algorithm>
+#include <thread>
+#include <future>
+#include <functional>
+#include <type_traits>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <vector>
+#include <stdexcept>
+#include "concurrent.hpp"
+#include "moveoncopy.hpp"
+#include "shared_queue.hpp"
+#include "std2_type_traits.hpp"
+
+namespace concurrent_helper {
+   /** true for a generic lambda, or a function object with overloaded operator() */
+   template<typename F, typename = void>
+   struct has_template_call_operator : std::is_class<F> {};
+
+   template<typename F>
+   struct has_template_call_operator<F, std2::void_t<decltype(&F::operator())>> : std::false_type {};
+
+
+   template<typename F, typename T, typename = void>
+   struct is_callable_with_const : std::false_type {};
+
+   template<typename F, typename T>
+   struct is_callable_with_const<F, T, std2::void_t<decltype(std::declval<F&>()(std::declval<const T&>()))>>
+      : std::true_type {};
+
+   /**
+    * true if the lambda can be called with a const reference to T, i.e. it cannot modify T.
+    * A generic lambda is not probed: its body would be instantiated with const T&, and a
+    * body that modifies T is then a hard error instead of a write
+    */
+   template<typename F, typename T>
+   struct is_read_only_lambda
+      : std::conditional<has_template_call_operator<F>::value, std::false_type, is_callable_with_const<F, T>>::type {};
+
+
+   /** true if the pointer-to-member function is const qualified */
+   template<typename F>
+   struct is_const_member_function : std::false_type {};
+
+   template<typename R, typename C, typename... Args>
+   struct is_const_member_function<R (C::*)(Args...) const> : std::true_type {};
+
+#if defined(__cplusplus) && (__cplusplus >= 201703L)  // noexcept is part of the type from C++17
+   template<typename R, typename C, typename... Args>
+   struct is_const_member_function<R (C::*)(Args...) const noexcept> : std::true_type {};
+#endif
+} // namespace concurrent_helper
+
+
+/**
+ * Active object where writes are executed in FIFO order on a dispatcher thread and reads
+ * in between two writes are executed in parallel on a reader pool.
+ */
+template <class T> class concurrent_rw {
+   struct Task {
+      concurrent_helper::Callback call;
+      bool read_only;
+   };
+
+   mutable std::unique_ptr<T> _worker;
+   mutable shared_queue<Task> _q;
+   shared_queue<concurrent_helper::Callback> _read_q;
+   std::mutex _m;
+   std::condition_variable _reads_done;
+   size_t _reads_in_flight;
+   bool _done; // not atomic since only the dispatcher thread is touching it
+   std::vector<std::thread> _readers;
+   std::thread _thd;
+
+   concurrent_rw(const concurrent_rw&) = delete;
+   concurrent_rw& operator=(const concurrent_rw&) = delete;
+
+   /// the dispatcher is the only thread that increments the count
+   void begin_read() {
+      std::lock_guard<std::mutex> lock(_m);
+      ++_reads_in_flight;
+   }
+
+   void end_read() {
+      {
+         std::lock_guard<std::mutex> lock(_m);
+         --_reads_in_flight;
+      }
+      _reads_done.notify_all();
+   }
+
+   void wait_for_reads() {
+      std::unique_lock<std::mutex> lock(_m);
+      _reads_done.wait(lock, [this] { return 0 == _reads_in_flight; });
+   }
+
+   void dispatch() {
+      Task task;
+      while (_worker && !_done) {
+         _q.wait_and_pop(task);
+         if (task.read_only) {
+            begin_read();
+            _read_q.push(std::move(task.call));
+         } else {
+            wait_for_reads();
+            task.call();
+         }
+      }
+   }
+
+   void read() {
+      concurrent_helper::Callback call;
+      while (true) {
+         _read_q.wait_and_pop(call);
+         if (!call) {
+            return; // empty callback is the shutdown message
+         }
+         call();
+         end_read();
+      }
+   }
+
+   /// the forwarding constructor must not hide the (unique_ptr<T>, readers) constructor
+   template<typename... Args>
+   struct is_unique_worker : std::false_type {};
+
+   template<typename First, typename... Rest>
+   struct is_unique_worker<First, Rest...>
+      : std::is_same<typename std::decay<First>::type, std::unique_ptr<T>> {};
+
+ public:
+   static constexpr size_t kDefaultReaders = 2;
+
+   /**  Constructs an unique_ptr<T>  that is the background object
+    * @param args to construct the unique_ptr<T> in-place
+    */
+   template<typename ... Args, typename = typename std::enable_if<!is_unique_worker<Args...>::value>::type>
+   concurrent_rw(Args&& ... args)
+      : concurrent_rw(std::make_unique<T>(std::forward<Args>(args)...), kDefaultReaders) {
+   }
+
+   /**
+    * Moves in a unique_ptr<T> to be the background object. Starts up the dispatcher
+    * and the reader threads
+    * @param worker to act as the background object
+    * @param readers number of threads that can execute reads in parallel
+    */
+   explicit concurrent_rw(std::unique_ptr<T> worker, size_t readers = kDefaultReaders)
+      : _worker(std::move(worker))
+      , _reads_in_flight(0)
+      , _done(false)
+      , _thd([this] { dispatch(); }) {
+      for (size_t index = 0; index < std::max<size_t>(readers, 1); ++index) {
+         _readers.emplace_back([this] { read(); });
+      }
+   }
+
+   /**
+    * Clean shutdown. All pending reads and writes are executed before the shutdown message
+    * is received
+    */
+   virtual ~concurrent_rw() {
+      _q.push(Task{[this] {_done = true;}, false});
+      if (_thd.joinable()) {
+         _thd.join();
+      }
+      for (size_t index = 0; index < _readers.size(); ++index) {
+         _read_q.push(concurrent_helper::Callback{});
+      }
+      for (auto& reader : _readers) {
+         reader.join();
+      }
+   }
+
+   /// @return whether the background object is missing
+   bool empty() const {
+      return !_worker;
+   }
+
+   /**
+    * Lambda call. It is executed as a read in parallel with other reads if it takes
+    * the wrapped object by const reference, otherwise it is a write. A generic lambda
+    * (auto parameter) is always a write.
+    *
+    * Example:   h.lambda( [](const Hello& object){ return object.get(); }; // read
+    *            h.lambda( [](Hello& object){ object.set(1); };             // write
+    */
+   template<typename F>
+   auto lambda(F func) const -> std::future<decltype(func(*_worker))> {
+      typedef decltype(func(*_worker)) result_type;
+      const bool read_only = concurrent_helper::is_read_only_lambda<F, T>::value;
+      typedef typename std::conditional<read_only, const T, T>::type object_type;
+
+      if (empty()) {
+         return concurrent_helper::empty_worker_future<result_type>();
+      }
+
+      auto p = std::make_shared<std::promise<result_type>>();
+      auto future_result = p->get_future();
+      object_type* object = _worker.get();
+      _q.push(Task{[ = ] {
+         try {
+            concurrent_helper::set_value(*p, func, *object);
+         } catch (...) {
+            p->set_exception(std::current_exception());
+         }
+      }, read_only});
+      return future_result;
+   }
+
+   /**
+    * Pointer-to-member call. A const member function is executed as a read in parallel
+    * with other reads, otherwise it is a write.
+    *
+    * Example:   std::future<int> result = h.call(&Hello::get);
+    */
+   template<typename AsyncCall, typename... Args>
+   auto call(AsyncCall func, Args&& ... args) const -> std::future<typename std::result_of< decltype(func)(T*, Args...)>::type> {
+      typedef typename std::result_of<decltype(func)(T*, Args...)>::type result_type;
+      typedef std::packaged_task<result_type()> task_type;
+
+      if (empty()) {
+         return concurrent_helper::empty_worker_future<result_type>();
+      }
+
+      auto bgCall = std::bind(func, _worker.get(), std::forward<Args>(args)...);
+      task_type task(std::move(bgCall));
+      std::future<result_type> result = task.get_future();
+      _q.push(Task{MoveOnCopy<task_type>(std::move(task)), concurrent_helper::is_const_member_function<AsyncCall>::value});
+      return result;
+   }
+
+   /**
+    * Fire and forget, see concurrent<T>::fire. A const member function is executed as a read.
+    *
+    * WARNING: This function call MAY THROW if instantiated with a null object.
+    */
+   template<typename AsyncCall, typename... Args>
+   void fire(AsyncCall func, Args&& ... args) const noexcept(false) {
+      if (empty()) {
+         throw std::runtime_error("nullptr instantiated worker");
+      }
+      auto bgCall = std::bind(func, _worker.get(), std::forward<Args>(args)...);
+      _q.push(Task{bgCall, concurrent_helper::is_const_member_function<AsyncCall>::value});
+   }
+
+   /// @return number of readers in the pool
+   size_t readers() const { return _readers.size(); }
+
+   /// return snapshot of size. Reads that are handed over to the reader pool are not counted
+   virtual size_t size() { return _q.size(); }
+};
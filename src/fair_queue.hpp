@@ -0,0 +1,199 @@
+/** ==========================================================================
+ * 2014 by KjellKod.cc. This is PUBLIC DOMAIN to use at your own risk and comes
+ * with no warranties. This code is yours to share, use and modify with no
+ * strings attached and no restrictions or obligations.
+ * ============================================================================
+ *
+ * Fair queue with the same interface as shared_queue. Every producer, or every tag,
+ * gets its own FIFO sub-queue and the consumer serves the sub-queues with deficit round
+ * robin. One producer with a large backlog can no longer delay the other producers
+ * by the time it takes to drain that backlog.
+ *
+ * Items are FIFO within one producer (or tag), not across producers.
+ *
+ * Use it as the queue of a concurrent<T>, the producer is then the calling thread:
+ *    concurrent<Engine, fair_queue<concurrent_helper::Callback>> engine;
+ * ============================================================================*/
+
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <unordered_map>
+
+/**
+ * Multiple producer, multiple consumer thread safe queue with deficit round robin between
+ * producers. Since 'return by reference' is used this queue won't throw. */
+template<typename T>
+class fair_queue {
+public:
+   typedef size_t key_type;
+
+private:
+   /// producers and tags are separate key spaces, a tag never shares a sub-queue with a thread
+   struct flow_id {
+      key_type key;
+      bool producer;
+      bool operator==(const flow_id& other) const { return key == other.key && producer == other.producer; }
+   };
+
+   struct flow_id_hash {
+      size_t operator()(const flow_id& id) const { return std::hash<key_type>()(id.key) * 2 + (id.producer ? 1 : 0); }
+   };
+
+   struct Flow {
+      std::queue<T> items;
+      size_t weight = 1;   // items served per round
+      size_t deficit = 0;  // items left to serve in this round
+   };
+
+   std::unordered_map<flow_id, Flow, flow_id_hash> flows_;
+   std::unordered_map<flow_id, size_t, flow_id_hash> weights_; // kept until reset_weight
+   std::deque<flow_id> active_; // flows with items, in round robin order
+   size_t size_ = 0;
+   mutable std::mutex m_;
+   std::condition_variable data_cond_;
+
+   fair_queue& operator=(const fair_queue&) = delete;
+   fair_queue(const fair_queue& other) = delete;
+
+   static flow_id this_producer() {
+      return flow_id{std::hash<std::thread::id>()(std::this_thread::get_id()), true};
+   }
+
+   static flow_id tag(key_type key) {
+      return flow_id{key, false};
+   }
+
+   /// must be called with the lock held and with items in the queue
+   void pop_locked(T& popped_item) {
+      const flow_id key = active_.front();
+      Flow& flow = flows_[key];
+      if (0 == flow.deficit) {
+         flow.deficit = flow.weight;
+      }
+      popped_item = std::move(flow.items.front());
+      flow.items.pop();
+      --flow.deficit;
+      --size_;
+
+      if (flow.items.empty()) {
+         active_.pop_front();
+         flows_.erase(key); // idle producers do not keep memory or credit
+      } else if (0 == flow.deficit) {
+         active_.pop_front();
+         active_.push_back(key);
+      }
+   }
+
+   void push_flow(const flow_id& key, T item) {
+      {
+         std::lock_guard<std::mutex> lock(m_);
+         auto inserted = flows_.emplace(key, Flow{});
+         Flow& flow = inserted.first->second;
+         if (inserted.second) {
+            auto weight = weights_.find(key);
+            flow.weight = (weight == weights_.end()) ? 1 : weight->second;
+            active_.push_back(key);
+         }
+         flow.items.push(std::move(item));
+         ++size_;
+      }
+      data_cond_.notify_one();
+   }
+
+   void set_flow_weight(const flow_id& key, size_t weight) {
+      std::lock_guard<std::mutex> lock(m_);
+      weight = (0 == weight) ? 1 : weight;
+      weights_[key] = weight;
+      auto flow = flows_.find(key);
+      if (flow != flows_.end()) {
+         flow->second.weight = weight;
+      }
+   }
+
+   void reset_flow_weight(const flow_id& key) {
+      std::lock_guard<std::mutex> lock(m_);
+      weights_.erase(key);
+      auto flow = flows_.find(key);
+      if (flow != flows_.end()) {
+         flow->second.weight = 1;
+      }
+   }
+
+public:
+   fair_queue() = default;
+
+   /// push on the sub-queue of the calling thread
+   void push(T item) {
+      push_flow(this_producer(), std::move(item));
+   }
+
+   /// push on the sub-queue for 'key', e.g. a tenant id. Tags never share a sub-queue with a producer thread
+   void push(key_type key, T item) {
+      push_flow(tag(key), std::move(item));
+   }
+
+   /// A sub-queue with weight N is served N items per round. Default weight is 1
+   void set_weight(key_type key, size_t weight) {
+      set_flow_weight(tag(key), weight);
+   }
+
+   /// set the weight of the calling thread's sub-queue
+   void set_weight(size_t weight) {
+      set_flow_weight(this_producer(), weight);
+   }
+
+   /// the weight of 'key' is forgotten, back to 1
+   void reset_weight(key_type key) {
+      reset_flow_weight(tag(key));
+   }
+
+   /// the weight of the calling thread is forgotten, call it before a weighted producer thread exits
+   void reset_weight() {
+      reset_flow_weight(this_producer());
+   }
+
+   /// \return number of weights that are set
+   size_t weights() const {
+      std::lock_guard<std::mutex> lock(m_);
+      return weights_.size();
+   }
+
+   /// \return immediately, with true if successful retrieval
+   bool try_and_pop(T& popped_item) {
+      std::lock_guard<std::mutex> lock(m_);
+      if (0 == size_) {
+         return false;
+      }
+      pop_locked(popped_item);
+      return true;
+   }
+
+   /// Try to retrieve, if no items, wait till an item is available and try again
+   void wait_and_pop(T& popped_item) {
+      std::unique_lock<std::mutex> lock(m_);
+      data_cond_.wait(lock, [this] { return 0 != size_; });
+      pop_locked(popped_item);
+   }
+
+   bool empty() const {
+      std::lock_guard<std::mutex> lock(m_);
+      return 0 == size_;
+   }
+
+   size_t size() const {
+      std::lock_guard<std::mutex> lock(m_);
+      return size_;
+   }
+
+   /// \return number of producers (or tags) with queued items
+   size_t producers() const {
+      std::lock_guard<std::mutex> lock(m_);
+      return active_.size();
+   }
+};
@@ -0,0 +1,58 @@
+/** ==========================================================================
+ * 2014 by KjellKod.cc. This is PUBLIC DOMAIN to use at your own risk and comes
+ * with no warranties. This code is yours to share, use and modify with no
+ * strings attached and no restrictions or obligations.
+ * ============================================================================
+ *
+ * Thin wrapper of the Linux futex system call for a std::atomic<uint32_t>.
+ * The non-private operations are used so the word can live in shared memory
+ * and wake up threads in other processes.
+ * ============================================================================*/
+
+#pragma once
+
+#if defined(__linux__)
+
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <climits>
+#include <cstdint>
+#include <ctime>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace futex {
+   static_assert(sizeof(std::atomic<uint32_t>) == sizeof(uint32_t), "futex needs a plain 32 bit word");
+
+   inline uint32_t* word(std::atomic<uint32_t>& atomic) {
+      return reinterpret_cast<uint32_t*>(&atomic);
+   }
+
+   /**
+    * Sleep while 'atomic' still holds 'expected'
+    * @return false on timeout. Spurious wake-ups return true, the caller re-checks its condition
+    */
+   template<typename Rep, typename Period>
+   bool wait_for(std::atomic<uint32_t>& atomic, uint32_t expected, const std::chrono::duration<Rep, Period>& timeout) {
+      const auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(timeout).count();
+      timespec relative;
+      relative.tv_sec = static_cast<time_t>(ns / 1000000000);
+      relative.tv_nsec = static_cast<long>(ns % 1000000000);
+      const long result = syscall(SYS_futex, word(atomic), FUTEX_WAIT, expected, &relative, nullptr, 0);
+      return !(-1 == result && ETIMEDOUT == errno);
+   }
+
+   /// Sleep while 'atomic' still holds 'expected'. Spurious wake-ups are possible
+   inline void wait(std::atomic<uint32_t>& atomic, uint32_t expected) {
+      syscall(SYS_futex, word(atomic), FUTEX_WAIT, expected, nullptr, nullptr, 0);
+   }
+
+   /// Wake up to 'count' waiters on 'atomic', in any process
+   inline void wake(std::atomic<uint32_t>& atomic, int count = INT_MAX) {
+      syscall(SYS_futex, word(atomic), FUTEX_WAKE, count, nullptr, nullptr, 0);
+   }
+} // namespace futex
+
+#endif // __linux__
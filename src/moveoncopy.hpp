@@ -41,4 +41,8 @@ struct MoveOnCopy {
    Moveable release() {return std::move(_move_only); }
 };
 
-
+namespace std2 {
+   /// MoveOnCopy only adds copy operations that move, it relocates like what it wraps
+   template<typename Moveable>
+   struct is_trivially_relocatable<MoveOnCopy<Moveable>> : is_trivially_relocatable<Moveable> {};
+}  // namespace std2
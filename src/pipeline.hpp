@@ -0,0 +1,405 @@
+// PUBLIC DOMAIN LICENSE: https://github.com/KjellKod/Concurrent/blob/master/LICENSE
+//
+// Repository: https://github.com/KjellKod/Concurrent
+//
+// Typed Multi-Stage Pipeline
+// ===============================
+// Chains worker stages, e.g. decode -> enrich -> serialize -> write, without a promise
+// and a copy at every hop. Every stage has its own bounded queue and its own thread(s).
+// The output of a stage is moved straight into the queue of the next stage.
+//
+// 1) Backpressure: a full queue blocks the stage in front of it, and in the end push()
+// 2) Batching: a stage can take up to N items per lock of its queue and hand on its outputs the same way
+// 3) Replicas: a stage can run on several threads, each with its own copy of the stage function.
+//    Items are then no longer in FIFO order after that stage
+// 4) stats() reports per stage throughput and queue occupancy
+//
+// The stage functions take their input by value (or rvalue reference) and return the input of the
+// next stage. The last stage consumes the items and returns void. An exception thrown by a stage
+// drops that item and is counted in the stats.
+//
+// example usage:
+//  auto p = make_pipeline<Bytes>(
+//              stage(decode),                     // Bytes  -> Packet
+//              stage(enrich).replicas(4),         // Packet -> Packet
+//              stage(serialize).batch(64),        // Packet -> Json
+//              stage([&](Json json){ out.write(json); }));
+//  p.push(bytes);          // blocks while the first stage is full
+//  p.close();              // drains all stages, also done by the destructor
+//
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+
+/** A stage function with its queue capacity, batch size and number of replicas */
+template<typename F>
+class pipeline_stage {
+   F _func;
+   size_t _capacity = 1024;
+   size_t _batch = 1;
+   size_t _replicas = 1;
+
+ public:
+   typedef F function_type;
+
+   explicit pipeline_stage(F func) : _func(std::move(func)) {}
+
+   /// bounded size of the queue in front of this stage
+   pipeline_stage& capacity(size_t items) { _capacity = std::max<size_t>(1, items); return *this; }
+
+   /// take up to 'items' from the queue at a time
+   pipeline_stage& batch(size_t items) { _batch = std::max<size_t>(1, items); return *this; }
+
+   /// run the stage on this many threads, each with a copy of the stage function
+   pipeline_stage& replicas(size_t threads) { _replicas = std::max<size_t>(1, threads); return *this; }
+
+   const F& function() const { return _func; }
+   size_t capacity() const { return _capacity; }
+   size_t batch() const { return _batch; }
+   size_t replicas() const { return _replicas; }
+};
+
+template<typename F>
+pipeline_stage<F> stage(F func) {
+   return pipeline_stage<F>(std::move(func));
+}
+
+
+/** Snapshot of one stage */
+struct stage_stats {
+   size_t index;               // 0 is the first stage
+   size_t replicas;
+   size_t processed;           // items taken from the queue, including failed ones
+   size_t failed;              // items dropped because the stage threw
+   double items_per_second;    // processed since the pipeline started
+   size_t queue_depth;
+   size_t queue_high_water;
+   size_t queue_capacity;
+
+   double occupancy() const { return queue_capacity ? static_cast<double>(queue_depth) / queue_capacity : 0.0; }
+};
+
+
+namespace pipeline_detail {
+   typedef std::chrono::steady_clock clock;
+
+   /** Blocking, bounded multiple producer, multiple consumer queue that moves items in batches */
+   template<typename T>
+   class bounded_queue {
+      std::deque<T> _items;
+      const size_t _capacity;
+      size_t _high_water = 0;
+      bool _closed = false;
+      mutable std::mutex _m;
+      std::condition_variable _not_empty;
+      std::condition_variable _not_full;
+
+      bounded_queue(const bounded_queue&) = delete;
+      bounded_queue& operator=(const bounded_queue&) = delete;
+
+    public:
+      explicit bounded_queue(size_t capacity) : _capacity(capacity) {}
+
+      /// blocks while full. @return false if the queue is closed
+      bool push(T item) {
+         std::unique_lock<std::mutex> lock(_m);
+         _not_full.wait(lock, [this] { return _items.size() < _capacity || _closed; });
+         if (_closed) {
+            return false;
+         }
+         _items.push_back(std::move(item));
+         _high_water = std::max(_high_water, _items.size());
+         lock.unlock();
+         _not_empty.notify_one();
+         return true;
+      }
+
+      /// moves all of 'items' in, blocking whenever the queue is full. 'items' is left empty
+      void push_n(std::vector<T>& items) {
+         if (items.empty()) {
+            return;
+         }
+         std::unique_lock<std::mutex> lock(_m);
+         for (auto& item : items) {
+            if (_items.size() >= _capacity) {
+               _not_empty.notify_all(); // let the consumers make room
+               _not_full.wait(lock, [this] { return _items.size() < _capacity; });
+            }
+            _items.push_back(std::move(item));
+            _high_water = std::max(_high_water, _items.size());
+         }
+         lock.unlock();
+         items.clear();
+         _not_empty.notify_all();
+      }
+
+      /// blocks while empty. @return false when the queue is closed and drained
+      bool pop_n(std::vector<T>& out, size_t max) {
+         std::unique_lock<std::mutex> lock(_m);
+         _not_empty.wait(lock, [this] { return !_items.empty() || _closed; });
+         if (_items.empty()) {
+            return false;
+         }
+         const size_t count = std::min(max, _items.size());
+         for (size_t index = 0; index < count; ++index) {
+            out.push_back(std::move(_items.front()));
+            _items.pop_front();
+         }
+         lock.unlock();
+         _not_full.notify_all();
+         return true;
+      }
+
+      /// no more pushes. Consumers drain what is left
+      void close() {
+         {
+            std::lock_guard<std::mutex> lock(_m);
+            _closed = true;
+         }
+         _not_empty.notify_all();
+         _not_full.notify_all();
+      }
+
+      size_t size() const {
+         std::lock_guard<std::mutex> lock(_m);
+         return _items.size();
+      }
+
+      size_t high_water() const {
+         std::lock_guard<std::mutex> lock(_m);
+         return _high_water;
+      }
+
+      size_t capacity() const { return _capacity; }
+   };
+
+
+   struct stage_base {
+      virtual ~stage_base() = default;
+      virtual void start() = 0;
+      virtual void close_input() = 0;
+      virtual void join() = 0;
+      virtual stage_stats stats(clock::time_point started) const = 0;
+   };
+
+
+   /** One stage: its input queue, the replicas and where the outputs go */
+   template<typename In, typename F>
+   class stage_runner : public stage_base {
+    public:
+      typedef typename std::result_of<F(In&&)>::type output_type;
+
+    private:
+      // outputs are collected per batch, there is nothing to collect for the last stage
+      typedef typename std::conditional<std::is_void<output_type>::value, char, output_type>::type buffered_type;
+
+      const size_t _index;
+      pipeline_stage<F> _stage;
+      bounded_queue<In> _input;
+      bounded_queue<output_type>* _next = nullptr; // stays nullptr for the last stage
+      std::vector<std::thread> _threads;
+      std::atomic<size_t> _processed{0};
+      std::atomic<size_t> _failed{0};
+
+      size_t process(F& func, std::vector<In>& items, std::vector<buffered_type>& outputs, std::false_type /*void output*/) {
+         size_t failed = 0;
+         for (auto& item : items) {
+            try {
+               outputs.push_back(func(std::move(item)));
+            } catch (...) {
+               ++failed;
+            }
+         }
+         _next->push_n(outputs);
+         return failed;
+      }
+
+      size_t process(F& func, std::vector<In>& items, std::vector<buffered_type>&, std::true_type /*void output*/) {
+         size_t failed = 0;
+         for (auto& item : items) {
+            try {
+               func(std::move(item));
+            } catch (...) {
+               ++failed;
+            }
+         }
+         return failed;
+      }
+
+      void run() {
+         F func = _stage.function();
+         std::vector<In> items;
+         std::vector<buffered_type> outputs;
+         items.reserve(_stage.batch());
+         while (_input.pop_n(items, _stage.batch())) {
+            const size_t count = items.size();
+            const size_t failed = process(func, items, outputs, std::is_void<output_type>());
+            items.clear();
+            _failed += failed;
+            _processed += count;
+         }
+      }
+
+    public:
+      stage_runner(size_t index, pipeline_stage<F> stage)
+         : _index(index)
+         , _stage(std::move(stage))
+         , _input(_stage.capacity()) {
+      }
+
+      bounded_queue<In>& input() { return _input; }
+      void set_next(bounded_queue<output_type>* next) { _next = next; }
+
+      void start() override {
+         for (size_t replica = 0; replica < _stage.replicas(); ++replica) {
+            _threads.emplace_back([this] { run(); });
+         }
+      }
+
+      void close_input() override { _input.close(); }
+
+      void join() override {
+         for (auto& thread : _threads) {
+            if (thread.joinable()) {
+               thread.join();
+            }
+         }
+      }
+
+      stage_stats stats(clock::time_point started) const override {
+         const double seconds = std::chrono::duration<double>(clock::now() - started).count();
+         const size_t processed = _processed.load();
+         stage_stats snapshot;
+         snapshot.index = _index;
+         snapshot.replicas = _stage.replicas();
+         snapshot.processed = processed;
+         snapshot.failed = _failed.load();
+         snapshot.items_per_second = seconds > 0 ? processed / seconds : 0.0;
+         snapshot.queue_depth = _input.size();
+         snapshot.queue_high_water = _input.high_water();
+         snapshot.queue_capacity = _input.capacity();
+         return snapshot;
+      }
+   };
+
+
+   /// no stages left: the previous stage must have been the last, consuming one
+   template<typename In>
+   std::nullptr_t build(std::vector<std::unique_ptr<stage_base>>&) {
+      static_assert(std::is_void<In>::value, "the last pipeline stage must consume the items and return void");
+      return nullptr;
+   }
+
+   /// @return the input queue of 'first', linked to the input queue of the stages after it
+   template<typename In, typename F, typename... Rest>
+   bounded_queue<In>* build(std::vector<std::unique_ptr<stage_base>>& stages, pipeline_stage<F> first, Rest... rest) {
+      typedef stage_runner<In, F> runner_type;
+      std::unique_ptr<runner_type> runner(new runner_type(stages.size(), std::move(first)));
+      runner_type* raw = runner.get();
+      stages.push_back(std::move(runner));
+      raw->set_next(build<typename runner_type::output_type>(stages, std::move(rest)...));
+      return &raw->input();
+   }
+
+   template<typename F>
+   pipeline_stage<F> as_stage(pipeline_stage<F> stage) { return stage; }
+
+   template<typename F>
+   pipeline_stage<F> as_stage(F func) { return pipeline_stage<F>(std::move(func)); }
+} // namespace pipeline_detail
+
+
+/**
+ * Running pipeline that takes items of type In. See make_pipeline.
+ * The destructor closes the pipeline and waits until every stage is drained.
+ */
+template<typename In>
+class pipeline {
+   std::vector<std::unique_ptr<pipeline_detail::stage_base>> _stages; // first to last
+   pipeline_detail::bounded_queue<In>* _entry;
+   pipeline_detail::clock::time_point _started;
+   std::atomic<bool> _closed; // push() reads it on the producers' threads
+
+   pipeline(const pipeline&) = delete;
+   pipeline& operator=(const pipeline&) = delete;
+
+ public:
+   template<typename... Stages>
+   explicit pipeline(Stages... stages)
+      : _entry(pipeline_detail::build<In>(_stages, pipeline_detail::as_stage(std::move(stages))...))
+      , _started(pipeline_detail::clock::now())
+      , _closed(false) {
+      static_assert(sizeof...(Stages) > 0, "a pipeline needs at least one stage");
+      for (auto& stage : _stages) {
+         stage->start();
+      }
+   }
+
+   pipeline(pipeline&& other)
+      : _stages(std::move(other._stages))
+      , _entry(other._entry)
+      , _started(other._started)
+      , _closed(other._closed.load()) {
+      other._entry = nullptr;
+      other._closed = true;
+   }
+
+   ~pipeline() {
+      close();
+   }
+
+   /**
+    * Hand an item to the first stage. Blocks while the first stage's queue is full
+    * WARNING: throws std::runtime_error if the pipeline is closed
+    */
+   void push(In item) {
+      if (_closed || !_entry->push(std::move(item))) {
+         throw std::runtime_error("pipeline is closed");
+      }
+   }
+
+   /// No more pushes. Drains every stage, first to last, and stops their threads
+   void close() {
+      if (_closed.exchange(true)) {
+         return;
+      }
+      for (auto& stage : _stages) {
+         stage->close_input();
+         stage->join();
+      }
+   }
+
+   /// @return snapshot of every stage, first to last
+   std::vector<stage_stats> stats() const {
+      std::vector<stage_stats> snapshot;
+      for (auto& stage : _stages) {
+         snapshot.push_back(stage->stats(_started));
+      }
+      return snapshot;
+   }
+
+   size_t stages() const { return _stages.size(); }
+};
+
+
+/**
+ * Build and start a pipeline for items of type In
+ * @param stages stage(func) with options, or plain functions. The last one returns void
+ */
+template<typename In, typename... Stages>
+pipeline<In> make_pipeline(Stages... stages) {
+   return pipeline<In>(std::move(stages)...);
+}
@@ -0,0 +1,141 @@
+/** ==========================================================================
+ * 2014 by KjellKod.cc. This is PUBLIC DOMAIN to use at your own risk and comes
+ * with no warranties. This code is yours to share, use and modify with no
+ * strings attached and no restrictions or obligations.
+ * ============================================================================
+ *
+ * RCU style publication of immutable snapshots.
+ *
+ * The background worker of a concurrent<T> publishes derived state, for example a routing
+ * table, and any number of threads read the latest version without going through the queue.
+ *
+ * example usage:
+ *   published<Routes> routes;
+ *   concurrent<Router> router;
+ *   router.lambda([&routes](Router& r) {
+ *      r.add(...);
+ *      routes.publish(std::make_shared<const Routes>(r.table()));
+ *   });
+ *   ...
+ *   std::shared_ptr<const Routes> table = routes.snapshot(); // wait-free, any thread
+ *
+ * Readers are wait-free: they announce themselves in one of the striped epoch counters,
+ * copy the current std::shared_ptr and leave. The publisher retires the replaced holder and
+ * frees it once two epoch flips have passed with no reader left in the old epoch.
+ * The snapshot itself lives as long as any reader keeps its std::shared_ptr.
+ * ============================================================================*/
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+template<typename S>
+class published {
+   typedef std::shared_ptr<const S> holder;
+
+   /// two counters, one per epoch parity. Striped over threads to avoid one hot cache line
+   struct alignas(64) Readers {
+      std::atomic<size_t> count[2];
+   };
+   static constexpr size_t kStripes = 16;
+
+   mutable std::array<Readers, kStripes> readers_;
+   std::atomic<uint64_t> epoch_;
+   std::atomic<holder*> current_;
+
+   std::mutex publish_m_; // only taken by publishers, never by readers
+   std::vector<std::pair<holder*, uint64_t>> retired_;
+
+   published& operator=(const published&) = delete;
+   published(const published& other) = delete;
+
+   static size_t stripe() {
+      static thread_local const size_t index = std::hash<std::thread::id>()(std::this_thread::get_id()) % kStripes;
+      return index;
+   }
+
+   bool no_readers(size_t parity) const {
+      for (auto& stripe : readers_) {
+         if (stripe.count[parity].load() != 0) {
+            return false;
+         }
+      }
+      return true;
+   }
+
+   /// advance the epoch when the previous epoch is quiet and free what is two epochs old
+   void reclaim() {
+      for (int flip = 0; flip < 2; ++flip) {
+         const uint64_t epoch = epoch_.load();
+         if (!no_readers((epoch + 1) & 1)) {
+            break;
+         }
+         epoch_.store(epoch + 1);
+      }
+
+      const uint64_t epoch = epoch_.load();
+      auto keep = retired_.begin();
+      for (auto& retired : retired_) {
+         if (retired.second + 2 <= epoch) {
+            delete retired.first;
+         } else {
+            *keep++ = retired;
+         }
+      }
+      retired_.erase(keep, retired_.end());
+   }
+
+public:
+   published()
+      : epoch_(0)
+      , current_(new holder()) {
+      for (auto& stripe : readers_) {
+         stripe.count[0].store(0);
+         stripe.count[1].store(0);
+      }
+   }
+
+   explicit published(holder initial) : published() {
+      publish(std::move(initial));
+   }
+
+   ~published() {
+      for (auto& retired : retired_) {
+         delete retired.first;
+      }
+      delete current_.load();
+   }
+
+   /// Replace the current snapshot. Normally called from the worker thread
+   void publish(holder next) {
+      std::unique_ptr<holder> next_holder(new holder(std::move(next)));
+      std::lock_guard<std::mutex> lock(publish_m_);
+      holder* previous = current_.exchange(next_holder.release());
+      retired_.emplace_back(previous, epoch_.load());
+      reclaim();
+   }
+
+   /// @return the latest published snapshot, or nullptr if nothing is published yet. Wait-free
+   holder snapshot() const {
+      auto& count = readers_[stripe()].count[epoch_.load() & 1];
+      count.fetch_add(1);
+      holder result = *current_.load();
+      count.fetch_sub(1);
+      return result;
+   }
+
+   /// @return number of replaced snapshot holders not yet reclaimed
+   size_t retired() {
+      std::lock_guard<std::mutex> lock(publish_m_);
+      reclaim();
+      return retired_.size();
+   }
+};
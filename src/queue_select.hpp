@@ -0,0 +1,170 @@
+/** ==========================================================================
+ * 2014 by KjellKod.cc. This is PUBLIC DOMAIN to use at your own risk and comes
+ * with no warranties. This code is yours to share, use and modify with no
+ * strings attached and no restrictions or obligations.
+ * ============================================================================
+ *
+ * One consumer thread waiting on several shared_queues at once, instead of polling
+ * them with try_and_pop and sleeps in between.
+ *
+ *    queue_selector select;
+ *    const size_t orders = select.add(order_queue);
+ *    const size_t cancels = select.add(cancel_queue);
+ *    std::vector<size_t> ready;
+ *    while (select.wait_for(ready, std::chrono::milliseconds(100))) {
+ *       for (size_t index : ready) { ... try_and_pop or try_pop_n on that queue ... }
+ *    }
+ *
+ * Every queue that is added wakes the selector's queue_waker on push. The wait is level
+ * triggered: it returns at once while any of the queues has items.
+ * ============================================================================*/
+
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace concurrent_helper {
+   /**
+    * deadline = steady_clock::now() + timeout
+    * @return false if that is beyond the range of the clock, e.g. for duration::max(). Wait without a timeout then
+    */
+   template<typename Rep, typename Period>
+   bool deadline_after(const std::chrono::duration<Rep, Period>& timeout, std::chrono::steady_clock::time_point& deadline) {
+      typedef std::chrono::steady_clock clock;
+      const clock::time_point now = clock::now();
+      const std::chrono::duration<double> room = clock::time_point::max() - now;
+      if (std::chrono::duration<double>(timeout) >= room - std::chrono::seconds(1)) { // compared without overflow
+         return false;
+      }
+      deadline = now + std::chrono::duration_cast<clock::duration>(timeout);
+      return true;
+   }
+} // namespace concurrent_helper
+
+
+/// Wake-up shared by several queues, a counter of pushes that a waiter can sleep on
+class queue_waker {
+   std::mutex m_;
+   std::condition_variable cond_;
+   uint64_t generation_ = 0;
+
+public:
+   /// producer side, called by the queue after a push
+   void notify() {
+      {
+         std::lock_guard<std::mutex> lock(m_);
+         ++generation_;
+      }
+      cond_.notify_all();
+   }
+
+   uint64_t generation() {
+      std::lock_guard<std::mutex> lock(m_);
+      return generation_;
+   }
+
+   /// \return false if the deadline passed with no push since 'seen' was read
+   template<typename Clock, typename Duration>
+   bool wait_until(uint64_t seen, const std::chrono::time_point<Clock, Duration>& deadline) {
+      std::unique_lock<std::mutex> lock(m_);
+      return cond_.wait_until(lock, deadline, [this, seen] { return generation_ != seen; });
+   }
+
+   void wait(uint64_t seen) {
+      std::unique_lock<std::mutex> lock(m_);
+      cond_.wait(lock, [this, seen] { return generation_ != seen; });
+   }
+};
+
+
+/**
+ * Waits on several queues for one consumer thread. It is not thread safe itself, and
+ * the added queues must outlive it. Any queue with watch, unwatch and empty can be added,
+ * e.g. shared_queue.
+ */
+class queue_selector {
+   struct source {
+      std::function<bool()> has_items;
+      std::function<void()> unwatch;
+   };
+
+   std::shared_ptr<queue_waker> waker_;
+   std::vector<source> sources_;
+
+   queue_selector(const queue_selector&) = delete;
+   queue_selector& operator=(const queue_selector&) = delete;
+
+   bool collect(std::vector<size_t>& ready) const {
+      ready.clear();
+      for (size_t index = 0; index < sources_.size(); ++index) {
+         if (sources_[index].has_items()) {
+            ready.push_back(index);
+         }
+      }
+      return !ready.empty();
+   }
+
+public:
+   queue_selector() : waker_(std::make_shared<queue_waker>()) {}
+
+   ~queue_selector() {
+      for (auto& added : sources_) {
+         added.unwatch();
+      }
+   }
+
+   /// \return the index that identifies the queue in the ready list
+   template<typename Queue>
+   size_t add(Queue& queue) {
+      queue.watch(waker_);
+      std::shared_ptr<queue_waker> waker = waker_;
+      sources_.push_back(source{[&queue] { return !queue.empty(); }, [&queue, waker] { queue.unwatch(waker); }});
+      return sources_.size() - 1;
+   }
+
+   /// Block until at least one queue has items. \param ready the indexes of the queues with items
+   void wait(std::vector<size_t>& ready) {
+      for (;;) {
+         const uint64_t seen = waker_->generation();
+         if (collect(ready)) {
+            return;
+         }
+         waker_->wait(seen);
+      }
+   }
+
+   /// \return false if no queue got items before the deadline, ready is then empty
+   template<typename Clock, typename Duration>
+   bool wait_until(std::vector<size_t>& ready, const std::chrono::time_point<Clock, Duration>& deadline) {
+      for (;;) {
+         const uint64_t seen = waker_->generation();
+         if (collect(ready)) {
+            return true;
+         }
+         if (!waker_->wait_until(seen, deadline)) {
+            return collect(ready);
+         }
+      }
+   }
+
+   /// a timeout beyond the range of the clock, e.g. duration::max(), waits like wait
+   template<typename Rep, typename Period>
+   bool wait_for(std::vector<size_t>& ready, const std::chrono::duration<Rep, Period>& timeout) {
+      std::chrono::steady_clock::time_point deadline;
+      if (!concurrent_helper::deadline_after(timeout, deadline)) {
+         wait(ready);
+         return true;
+      }
+      return wait_until(ready, deadline);
+   }
+
+   /// \return number of added queues
+   size_t size() const { return sources_.size(); }
+};
@@ -0,0 +1,271 @@
+/** ==========================================================================
+ * 2014 by KjellKod.cc. This is PUBLIC DOMAIN to use at your own risk and comes
+ * with no warranties. This code is yours to share, use and modify with no
+ * strings attached and no restrictions or obligations.
+ * ============================================================================
+ *
+ * Queue with the same interface as shared_queue whose consumer waits in epoll, so the
+ * thread of a concurrent<T> also serves file descriptors and timers. One thread per
+ * network facing object instead of a reader thread plus a hop to the worker.
+ *
+ * Producers wake the sleeping consumer through an eventfd that is part of the epoll set.
+ * Queued items keep their FIFO order. Handlers of ready descriptors run on the consumer
+ * thread inside wait_and_pop: whenever the queue runs empty, and between every
+ * kPollEvery items so a busy queue does not starve the descriptors.
+ *
+ *    concurrent<Connection, reactor_queue<concurrent_helper::Callback>> connection(socket_fd);
+ *    connection.watch(socket_fd);                                   // Connection::on_readable(fd)
+ *    connection.add_timer(std::chrono::seconds(1), [](Connection& c) { c.heartbeat(); });
+ *    connection.fire(&Connection::send, reply);
+ *
+ * Linux only.
+ * ============================================================================*/
+
+#pragma once
+
+#if defined(__linux__)
+
+#include <cerrno>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <system_error>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+
+template<typename T>
+class reactor_queue {
+   typedef std::function<void()> Handler;
+
+   int epoll_fd_;
+   int wake_fd_;
+   std::mutex m_;
+   std::deque<T> queue_;
+   bool sleeping_;                 // the consumer waits, or is about to, in epoll
+   std::mutex handlers_m_;
+   std::unordered_map<int, std::shared_ptr<Handler>> handlers_;
+   std::unordered_set<int> timers_; // owned timerfds
+   std::vector<int> retired_;      // unwatched timerfds, closed by the consumer after dispatch
+   size_t since_poll_;             // consumer only
+
+   reactor_queue& operator=(const reactor_queue&) = delete;
+   reactor_queue(const reactor_queue& other) = delete;
+
+   static void fail(const char* what) {
+      throw std::system_error(errno, std::generic_category(), what);
+   }
+
+   void add(int fd, uint32_t events) {
+      epoll_event event{};
+      event.events = events;
+      event.data.fd = fd;
+      if (0 != epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, fd, &event)
+            && (EEXIST != errno || 0 != epoll_ctl(epoll_fd_, EPOLL_CTL_MOD, fd, &event))) {
+         fail("epoll_ctl");
+      }
+   }
+
+   /// run the handlers of the ready descriptors, waiting at most timeout_ms (-1: until one is ready)
+   void dispatch(int timeout_ms) {
+      epoll_event events[16];
+      const int ready = epoll_wait(epoll_fd_, events, 16, timeout_ms);
+      for (int index = 0; index < ready; ++index) {
+         const int fd = events[index].data.fd;
+         if (fd == wake_fd_) {
+            uint64_t wakeups;
+            ssize_t ignored = ::read(wake_fd_, &wakeups, sizeof(wakeups));
+            (void)ignored;
+            continue;
+         }
+         std::shared_ptr<Handler> handler;
+         {
+            std::lock_guard<std::mutex> lock(handlers_m_);
+            auto found = handlers_.find(fd);
+            if (found != handlers_.end()) {
+               handler = found->second;
+            }
+         }
+         if (handler) {
+            (*handler)();
+         }
+      }
+      close_retired();
+   }
+
+   /// consumer side: no handler of this dispatch round uses the retired timers anymore
+   void close_retired() {
+      std::vector<int> retired;
+      {
+         std::lock_guard<std::mutex> lock(handlers_m_);
+         retired.swap(retired_);
+      }
+      for (int timer : retired) {
+         ::close(timer);
+      }
+   }
+
+   void wake() {
+      const uint64_t one = 1;
+      ssize_t ignored = ::write(wake_fd_, &one, sizeof(one));
+      (void)ignored;
+   }
+
+public:
+   static const size_t kPollEvery = 64;
+
+   /// WARNING: throws std::system_error if the epoll set or the eventfd can not be created
+   reactor_queue()
+      : epoll_fd_(epoll_create1(EPOLL_CLOEXEC))
+      , wake_fd_(eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC))
+      , sleeping_(false)
+      , since_poll_(0) {
+      if (epoll_fd_ < 0 || wake_fd_ < 0) {
+         const int error = errno;
+         if (epoll_fd_ >= 0) { ::close(epoll_fd_); }
+         if (wake_fd_ >= 0) { ::close(wake_fd_); }
+         errno = error;
+         fail("reactor_queue");
+      }
+      add(wake_fd_, EPOLLIN);
+   }
+
+   ~reactor_queue() {
+      for (int timer : timers_) {
+         ::close(timer);
+      }
+      for (int timer : retired_) {
+         ::close(timer);
+      }
+      ::close(wake_fd_);
+      ::close(epoll_fd_);
+   }
+
+   void push(T item) {
+      bool wake = false;
+      {
+         std::lock_guard<std::mutex> lock(m_);
+         queue_.push_back(std::move(item));
+         std::swap(wake, sleeping_);
+      }
+      if (wake) {
+         this->wake();
+      }
+   }
+
+   /// \return immediately, with true if successful retrieval. Does not serve the descriptors
+   bool try_and_pop(T& popped_item) {
+      std::lock_guard<std::mutex> lock(m_);
+      if (queue_.empty()) {
+         return false;
+      }
+      popped_item = std::move(queue_.front());
+      queue_.pop_front();
+      return true;
+   }
+
+   /// Serve the ready descriptors until an item is queued, then retrieve it
+   void wait_and_pop(T& popped_item) {
+      if (++since_poll_ >= kPollEvery) {
+         since_poll_ = 0;
+         dispatch(0);
+      }
+      while (true) {
+         {
+            std::lock_guard<std::mutex> lock(m_);
+            if (!queue_.empty()) {
+               popped_item = std::move(queue_.front());
+               queue_.pop_front();
+               return;
+            }
+            sleeping_ = true;
+         }
+         dispatch(-1);
+      }
+   }
+
+   /// Call on_readable from the consumer thread while fd is readable (level triggered)
+   void watch(int fd, Handler on_readable) {
+      {
+         std::lock_guard<std::mutex> lock(handlers_m_);
+         handlers_[fd] = std::make_shared<Handler>(std::move(on_readable));
+      }
+      add(fd, EPOLLIN);
+   }
+
+   /**
+    * Stop watching fd. A timer is also closed, but by the consumer thread once its current
+    * dispatch is done: the timer's handler may be running, or its event may be pending, and
+    * the number must not be reused by a new descriptor before that.
+    */
+   void unwatch(int fd) {
+      epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, fd, nullptr);
+      bool timer = false;
+      {
+         std::lock_guard<std::mutex> lock(handlers_m_);
+         handlers_.erase(fd);
+         if (timers_.erase(fd) > 0) {
+            retired_.push_back(fd);
+            timer = true;
+         }
+      }
+      if (timer) {
+         wake(); // a sleeping consumer makes a dispatch round and closes it
+      }
+   }
+
+   /**
+    * Call on_timer from the consumer thread every period
+    * @return timer id for unwatch
+    */
+   int add_timer(std::chrono::milliseconds period, Handler on_timer) {
+      const int timer = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+      if (timer < 0) {
+         fail("timerfd_create");
+      }
+      itimerspec spec{};
+      spec.it_interval.tv_sec = static_cast<time_t>(period.count() / 1000);
+      spec.it_interval.tv_nsec = static_cast<long>(period.count() % 1000) * 1000000;
+      spec.it_value = spec.it_interval;
+      if (0 == period.count() || 0 != timerfd_settime(timer, 0, &spec, nullptr)) {
+         const int error = (0 == period.count()) ? EINVAL : errno;
+         ::close(timer);
+         errno = error;
+         fail("timerfd_settime");
+      }
+      {
+         std::lock_guard<std::mutex> lock(handlers_m_);
+         timers_.insert(timer);
+      }
+      watch(timer, [timer, on_timer] {
+         uint64_t expirations = 0;
+         if (static_cast<ssize_t>(sizeof(expirations)) == ::read(timer, &expirations, sizeof(expirations))) {
+            on_timer();
+         }
+      });
+      return timer;
+   }
+
+   size_t size() {
+      std::lock_guard<std::mutex> lock(m_);
+      return queue_.size();
+   }
+
+   bool empty() {
+      return 0 == size();
+   }
+};
+
+template<typename T>
+const size_t reactor_queue<T>::kPollEvery;
+
+#endif // __linux__
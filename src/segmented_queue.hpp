@@ -0,0 +1,256 @@
+/** ==========================================================================
+ * 2014 by KjellKod.cc. This is PUBLIC DOMAIN to use at your own risk and comes
+ * with no warranties. This code is yours to share, use and modify with no
+ * strings attached and no restrictions or obligations.
+ * ============================================================================
+ *
+ * Storage for shared_queue made of fixed size, cache line aligned segments.
+ * Drained segments are kept on a free list instead of going back to the allocator so
+ * a queue that swings between empty and a large backlog does push/pop without
+ * allocations once it is warm. The number of retained segments is capped and
+ * shrink_to_fit() releases them after a spike.
+ *
+ * It is not thread safe on its own, it replaces the std::queue inside shared_queue:
+ *    shared_queue<Item, segmented_queue<Item>> queue;
+ *    concurrent<T, shared_queue<concurrent_helper::Callback, segmented_queue<concurrent_helper::Callback>>> obj;
+ *
+ * Memory comes from the Allocator. With C++17 a std::pmr::memory_resource can be
+ * used through pmr::segmented_queue and std::pmr::polymorphic_allocator.
+ * ============================================================================*/
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+#include "std2_type_traits.hpp"
+
+#if defined(__cplusplus) && (__cplusplus >= 201703L)
+#include <memory_resource>
+#endif
+
+namespace segmented_queue_detail {
+   constexpr size_t kCacheLine = 64;
+   constexpr size_t kSegmentBytes = 4096;
+
+   /// default number of items per segment, about one page worth
+   template<typename T>
+   constexpr size_t default_items() {
+      return sizeof(T) < kSegmentBytes ? kSegmentBytes / sizeof(T) : 1;
+   }
+} // namespace segmented_queue_detail
+
+
+template<typename T,
+         size_t SegmentItems = segmented_queue_detail::default_items<T>(),
+         typename Allocator = std::allocator<T>>
+class segmented_queue {
+   static_assert(SegmentItems > 0, "a segment must hold at least one item");
+
+   struct alignas(segmented_queue_detail::kCacheLine) Segment {
+      typename std::aligned_storage<sizeof(T), alignof(T)>::type items[SegmentItems];
+      Segment* next;
+      unsigned char* allocation; // where the allocator gave us the memory, before alignment
+   };
+
+   typedef typename std::allocator_traits<Allocator>::template rebind_alloc<unsigned char> byte_allocator;
+   typedef std::allocator_traits<byte_allocator> byte_traits;
+   static constexpr size_t kAllocationBytes = sizeof(Segment) + alignof(Segment);
+
+   byte_allocator allocator_;
+   Segment* head_ = nullptr;
+   Segment* tail_ = nullptr;
+   size_t head_index_ = 0;   // next item to pop in head_
+   size_t tail_index_ = 0;   // next free slot in tail_
+   size_t size_ = 0;
+   Segment* free_ = nullptr; // drained segments kept for reuse
+   size_t retained_ = 0;
+   size_t max_retained_;
+   size_t allocated_ = 0;    // segments in use or retained
+
+   segmented_queue& operator=(const segmented_queue&) = delete;
+   segmented_queue(const segmented_queue&) = delete;
+
+   Segment* allocate_segment() {
+      unsigned char* memory = byte_traits::allocate(allocator_, kAllocationBytes);
+      void* aligned = memory;
+      size_t space = kAllocationBytes;
+      std::align(alignof(Segment), sizeof(Segment), aligned, space);
+      Segment* segment = ::new (aligned) Segment;
+      segment->next = nullptr;
+      segment->allocation = memory;
+      ++allocated_;
+      return segment;
+   }
+
+   void deallocate_segment(Segment* segment) {
+      unsigned char* memory = segment->allocation;
+      segment->~Segment();
+      byte_traits::deallocate(allocator_, memory, kAllocationBytes);
+      --allocated_;
+   }
+
+   Segment* acquire_segment() {
+      if (nullptr == free_) {
+         return allocate_segment();
+      }
+      Segment* segment = free_;
+      free_ = segment->next;
+      segment->next = nullptr;
+      --retained_;
+      return segment;
+   }
+
+   void release_segment(Segment* segment) {
+      if (retained_ >= max_retained_) {
+         deallocate_segment(segment);
+         return;
+      }
+      segment->next = free_;
+      free_ = segment;
+      ++retained_;
+   }
+
+   T* slot(Segment* segment, size_t index) {
+      return reinterpret_cast<T*>(&segment->items[index]);
+   }
+
+   /// step past the front item, its life has already ended
+   void advance() {
+      ++head_index_;
+      --size_;
+      if (0 == size_) {
+         head_index_ = tail_index_ = 0; // head_ is also tail_, start over in the same segment
+      } else if (SegmentItems == head_index_) {
+         Segment* drained = head_;
+         head_ = head_->next;
+         head_index_ = 0;
+         release_segment(drained);
+      }
+   }
+
+public:
+   typedef T value_type;
+   typedef Allocator allocator_type;
+   static constexpr size_t kSegmentItems = SegmentItems;
+   static constexpr size_t kDefaultMaxRetained = 16;
+
+   /**
+    * @param max_retained_segments cap on drained segments kept for reuse
+    * @param allocator where the segments come from
+    */
+   explicit segmented_queue(size_t max_retained_segments = kDefaultMaxRetained, const Allocator& allocator = Allocator())
+      : allocator_(allocator)
+      , max_retained_(max_retained_segments) {
+   }
+
+   segmented_queue(segmented_queue&& other) noexcept
+      : allocator_(other.allocator_)
+      , head_(other.head_), tail_(other.tail_)
+      , head_index_(other.head_index_), tail_index_(other.tail_index_)
+      , size_(other.size_)
+      , free_(other.free_), retained_(other.retained_)
+      , max_retained_(other.max_retained_)
+      , allocated_(other.allocated_) {
+      other.head_ = other.tail_ = other.free_ = nullptr;
+      other.head_index_ = other.tail_index_ = other.size_ = 0;
+      other.retained_ = other.allocated_ = 0;
+   }
+
+   ~segmented_queue() {
+      while (!empty()) {
+         pop();
+      }
+      if (nullptr != head_) {
+         deallocate_segment(head_);
+      }
+      shrink_to_fit();
+   }
+
+   void push(T&& item) {
+      if (nullptr == tail_) {
+         head_ = tail_ = acquire_segment();
+         head_index_ = tail_index_ = 0;
+      } else if (SegmentItems == tail_index_) {
+         Segment* segment = acquire_segment();
+         tail_->next = segment;
+         tail_ = segment;
+         tail_index_ = 0;
+      }
+      ::new (slot(tail_, tail_index_)) T(std::move(item));
+      ++tail_index_;
+      ++size_;
+   }
+
+   void push(const T& item) {
+      T copy(item);
+      push(std::move(copy));
+   }
+
+   T& front() {
+      return *slot(head_, head_index_);
+   }
+
+   void pop() {
+      slot(head_, head_index_)->~T();
+      advance();
+   }
+
+   /// Move the front to popped_item and pop it. A byte copy for std2::is_trivially_relocatable types
+   void pop(T& popped_item) {
+      std2::relocate_assign(popped_item, *slot(head_, head_index_));
+      advance();
+   }
+
+   bool empty() const {
+      return 0 == size_;
+   }
+
+   size_t size() const {
+      return size_;
+   }
+
+   /// Give the retained segments back to the allocator, e.g. after a backlog spike
+   void shrink_to_fit() {
+      while (nullptr != free_) {
+         Segment* segment = free_;
+         free_ = segment->next;
+         deallocate_segment(segment);
+      }
+      retained_ = 0;
+   }
+
+   /// Cap on drained segments kept for reuse. Retained segments above the cap are released
+   void set_max_retained(size_t max_retained_segments) {
+      max_retained_ = max_retained_segments;
+      while (retained_ > max_retained_) {
+         Segment* segment = free_;
+         free_ = segment->next;
+         deallocate_segment(segment);
+         --retained_;
+      }
+   }
+
+   /// @return segments currently allocated, both in use and retained
+   size_t allocated_segments() const {
+      return allocated_;
+   }
+
+   /// @return drained segments kept for reuse
+   size_t retained_segments() const {
+      return retained_;
+   }
+};
+
+
+#if defined(__cplusplus) && (__cplusplus >= 201703L)
+namespace pmr {
+   /// segmented_queue with segments from a std::pmr::memory_resource
+   template<typename T, size_t SegmentItems = segmented_queue_detail::default_items<T>()>
+   using segmented_queue = ::segmented_queue<T, SegmentItems, std::pmr::polymorphic_allocator<T>>;
+} // namespace pmr
+#endif
@@ -0,0 +1,225 @@
+/** ==========================================================================
+ * 2014 by KjellKod.cc. This is PUBLIC DOMAIN to use at your own risk and comes
+ * with no warranties. This code is yours to share, use and modify with no
+ * strings attached and no restrictions or obligations.
+ * ============================================================================
+ *
+ * Request collapsing and result caching behind concurrent<T>::call_shared.
+ *
+ * The first call for a key is queued, its std::shared_future is kept as pending until
+ * the worker has run it. Calls for the same key in the meantime get that same future
+ * instead of queueing the work again. With the cache enabled, a successful result stays
+ * available for 'ttl' in a small LRU cache of 'items' keys. Failures are never cached.
+ *
+ * The key identifies the request: different functions need different keys. Keys are
+ * compared by value with std::hash and ==, C strings as std::string.
+ *
+ * invalidate(key) drops the cached result and detaches the pending call of the key: later
+ * calls start a new call, and the detached one completes its callers but is not cached.
+ * ============================================================================*/
+
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <future>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <type_traits>
+#include <typeindex>
+#include <unordered_map>
+#include <utility>
+#include "coalescing_table.hpp"
+
+struct shared_call_stats {
+   size_t executed;    // calls queued to the worker
+   size_t collapsed;   // calls that got the future of a pending call
+   size_t cache_hits;  // calls that got a cached result
+   size_t cached;      // results in the cache, expired ones included until they are looked up
+};
+
+
+namespace concurrent_helper {
+   /// what shared_call_table::share hands out
+   template<typename R>
+   struct shared_call {
+      std::shared_future<R> result;
+      bool first;       // the caller must queue the call and complete it with 'id'
+      uint64_t id;
+   };
+
+
+   class shared_call_table {
+      typedef std::chrono::steady_clock clock;
+
+      struct table_base {
+         virtual ~table_base() = default;
+         virtual void invalidate(std::type_index key_type, const void* key) = 0;
+         virtual void clear_cache() = 0;
+         virtual size_t cached() const = 0;
+      };
+
+      /// pending calls and cached results of one key and result type
+      template<typename Key, typename R>
+      struct table : table_base {
+         struct Cached {
+            std::shared_future<R> result;
+            clock::time_point expires;
+            typename std::list<Key>::iterator recent;
+         };
+         struct Pending {
+            std::shared_future<R> result;
+            uint64_t id;
+         };
+         std::unordered_map<Key, Pending> pending;
+         std::unordered_map<Key, Cached> cache;
+         std::list<Key> recent; // most recently used first
+
+         void erase_cached(typename std::unordered_map<Key, Cached>::iterator it) {
+            recent.erase(it->second.recent);
+            cache.erase(it);
+         }
+
+         void invalidate(std::type_index key_type, const void* key) override {
+            if (key_type == std::type_index(typeid(Key))) {
+               const Key& invalid = *static_cast<const Key*>(key);
+               auto it = cache.find(invalid);
+               if (it != cache.end()) {
+                  erase_cached(it);
+               }
+               pending.erase(invalid); // it may have read the data before the change
+            }
+         }
+
+         void clear_cache() override {
+            cache.clear();
+            recent.clear();
+         }
+
+         size_t cached() const override { return cache.size(); }
+      };
+
+      mutable std::mutex _m;
+      std::unordered_map<std::type_index, std::unique_ptr<table_base>> _tables;
+      size_t _cache_items;
+      std::chrono::milliseconds _ttl;
+      size_t _executed;
+      size_t _collapsed;
+      size_t _cache_hits;
+      uint64_t _next_id;
+
+      shared_call_table(const shared_call_table&) = delete;
+      shared_call_table& operator=(const shared_call_table&) = delete;
+
+      template<typename Key, typename R>
+      table<Key, R>& table_locked() {
+         auto& entry = _tables[std::type_index(typeid(table<Key, R>))];
+         if (!entry) {
+            entry.reset(new table<Key, R>());
+         }
+         return *static_cast<table<Key, R>*>(entry.get());
+      }
+
+    public:
+      template<typename Key>
+      using key_type = typename coalescing_key<typename std::decay<Key>::type>::type;
+
+      shared_call_table()
+         : _cache_items(0), _ttl(0), _executed(0), _collapsed(0), _cache_hits(0), _next_id(1) {}
+
+      /// Enable the result cache with 'items' keys per key and result type, 0 disables it.
+      /// A ttl of 0 keeps results until they are evicted or invalidated. Clears the cache
+      void configure_cache(size_t items, std::chrono::milliseconds ttl) {
+         std::lock_guard<std::mutex> lock(_m);
+         _cache_items = items;
+         _ttl = ttl;
+         for (auto& entry : _tables) {
+            entry.second->clear_cache();
+         }
+      }
+
+      /**
+       * @return the cached or pending result for the key, or the candidate with first set
+       * if the key is new. The caller must then queue the call and complete it.
+       */
+      template<typename R, typename Key>
+      shared_call<R> share(const Key& key, std::shared_future<R> candidate) {
+         const key_type<Key> stored(key);
+         std::lock_guard<std::mutex> lock(_m);
+         auto& calls = table_locked<key_type<Key>, R>();
+         auto cached = calls.cache.find(stored);
+         if (cached != calls.cache.end()) {
+            if (_ttl.count() > 0 && clock::now() >= cached->second.expires) {
+               calls.erase_cached(cached);
+            } else {
+               calls.recent.splice(calls.recent.begin(), calls.recent, cached->second.recent);
+               ++_cache_hits;
+               return shared_call<R>{cached->second.result, false, 0};
+            }
+         }
+         auto pending = calls.pending.find(stored);
+         if (pending != calls.pending.end()) {
+            ++_collapsed;
+            return shared_call<R>{pending->second.result, false, 0};
+         }
+         const uint64_t id = _next_id++;
+         calls.pending.emplace(stored, typename table<key_type<Key>, R>::Pending{candidate, id});
+         ++_executed;
+         return shared_call<R>{candidate, true, id};
+      }
+
+      /// called by the worker once the result is set. Successful results go to the cache, unless the call was detached
+      template<typename R, typename Key>
+      void complete(const Key& key, uint64_t id, bool succeeded) {
+         const key_type<Key> stored(key);
+         std::lock_guard<std::mutex> lock(_m);
+         auto& calls = table_locked<key_type<Key>, R>();
+         auto pending = calls.pending.find(stored);
+         if (pending == calls.pending.end() || pending->second.id != id) { // invalidated meanwhile
+            return;
+         }
+         std::shared_future<R> result = std::move(pending->second.result);
+         calls.pending.erase(pending);
+         if (!succeeded || 0 == _cache_items) {
+            return;
+         }
+         auto cached = calls.cache.find(stored);
+         if (cached != calls.cache.end()) {
+            calls.erase_cached(cached);
+         }
+         while (calls.cache.size() >= _cache_items) {
+            calls.erase_cached(calls.cache.find(calls.recent.back()));
+         }
+         calls.recent.push_front(stored);
+         calls.cache.emplace(stored, typename table<key_type<Key>, R>::Cached{result, clock::now() + _ttl, calls.recent.begin()});
+      }
+
+      /// remove the cached results of the key, of all result types, and detach its pending calls
+      template<typename Key>
+      void invalidate(const Key& key) {
+         const key_type<Key> stored(key);
+         std::lock_guard<std::mutex> lock(_m);
+         for (auto& entry : _tables) {
+            entry.second->invalidate(std::type_index(typeid(key_type<Key>)), &stored);
+         }
+      }
+
+      void invalidate_all() {
+         std::lock_guard<std::mutex> lock(_m);
+         for (auto& entry : _tables) {
+            entry.second->clear_cache();
+         }
+      }
+
+      shared_call_stats stats() const {
+         std::lock_guard<std::mutex> lock(_m);
+         shared_call_stats snapshot{_executed, _collapsed, _cache_hits, 0};
+         for (auto& entry : _tables) {
+            snapshot.cached += entry.second->cached();
+         }
+         return snapshot;
+      }
+   };
+} // namespace concurrent_helper
@@ -14,29 +14,64 @@
 
 #include <queue>
 #include <mutex>
+#include <algorithm>
+#include <chrono>
 #include <exception>
 #include <condition_variable>
+#include <memory>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include "queue_select.hpp"
+#include "std2_type_traits.hpp"
 
 /**
  * Multiple producer, multiple consumer thread safe queue.  Since 'return by
- * reference' is used this queue won't throw. */
-template<typename T>
+ * reference' is used this queue won't throw, unless the Container does.
+ *
+ * The Container is std::queue<T> by default. Any container with push, front, pop, empty
+ * and size works, e.g. segmented_queue<T> that recycles its memory.
+ * WARNING: with spill_queue<T> push and the pops throw std::system_error on disk errors */
+template<typename T, typename Container = std::queue<T>>
 class shared_queue {
-   std::queue<T> queue_;
+   Container queue_;
    mutable std::mutex m_;
    std::condition_variable data_cond_;
+   std::vector<std::shared_ptr<queue_waker>> wakers_; // of the queue_selectors this queue is added to
 
    shared_queue& operator=(const shared_queue&) = delete;
    shared_queue(const shared_queue& other) = delete;
 
+   /// containers with pop(T&), e.g. segmented_queue, move out the front themselves
+   template<typename C, typename = void>
+   struct pops_into : std::false_type {};
+
+   template<typename C>
+   struct pops_into<C, std2::void_t<decltype(std::declval<C&>().pop(std::declval<T&>()))>> : std::true_type {};
+
+   void pop_front(T& popped_item, std::true_type) {
+      queue_.pop(popped_item);
+   }
+
+   void pop_front(T& popped_item, std::false_type) {
+      popped_item = std::move(queue_.front());
+      queue_.pop();
+   }
+
 public:
 
    shared_queue() = default;
 
+   /// Use an already configured container, e.g. segmented_queue<T> with its own allocator
+   explicit shared_queue(Container storage) : queue_(std::move(storage)) {}
+
    void push(T item) {
       {
          std::lock_guard<std::mutex> lock(m_);
          queue_.push(std::move(item));
+         for (auto& waker : wakers_) {
+            waker->notify();
+         }
       }
       data_cond_.notify_one();
    }
@@ -47,8 +82,7 @@ public:
       if (queue_.empty()) {
          return false;
       }
-      popped_item = std::move(queue_.front());
-      queue_.pop();
+      pop_front(popped_item, pops_into<Container>());
       return true;
    }
 
@@ -60,8 +94,55 @@ public:
          //  This 'while' loop is equal to
          //  data_cond_.wait(lock, [](bool result){return !queue_.empty();});
       }
-      popped_item = std::move(queue_.front());
-      queue_.pop();
+      pop_front(popped_item, pops_into<Container>());
+   }
+
+   /**
+    * Like wait_and_pop but gives up after timeout. \return true if an item was retrieved
+    * A timeout beyond the range of the clock, e.g. duration::max(), waits like wait_and_pop
+    */
+   template<typename Rep, typename Period>
+   bool wait_and_pop_for(T& popped_item, const std::chrono::duration<Rep, Period>& timeout) {
+      std::chrono::steady_clock::time_point deadline;
+      if (!concurrent_helper::deadline_after(timeout, deadline)) {
+         wait_and_pop(popped_item);
+         return true;
+      }
+      return wait_and_pop_until(popped_item, deadline);
+   }
+
+   /// Like wait_and_pop but gives up at the deadline. \return true if an item was retrieved
+   template<typename Clock, typename Duration>
+   bool wait_and_pop_until(T& popped_item, const std::chrono::time_point<Clock, Duration>& deadline) {
+      std::unique_lock<std::mutex> lock(m_);
+      if (!data_cond_.wait_until(lock, deadline, [this] { return !queue_.empty(); })) {
+         return false;
+      }
+      pop_front(popped_item, pops_into<Container>());
+      return true;
+   }
+
+   /// Append up to max items to out under one lock, without waiting. \return the number of items
+   size_t try_pop_n(std::vector<T>& out, size_t max) {
+      std::lock_guard<std::mutex> lock(m_);
+      const size_t count = std::min(max, static_cast<size_t>(queue_.size()));
+      out.reserve(out.size() + count);
+      for (size_t popped = 0; popped < count; ++popped) {
+         out.emplace_back();
+         pop_front(out.back(), pops_into<Container>());
+      }
+      return count;
+   }
+
+   /// Wake the waker on every push, see queue_selector
+   void watch(std::shared_ptr<queue_waker> waker) {
+      std::lock_guard<std::mutex> lock(m_);
+      wakers_.push_back(std::move(waker));
+   }
+
+   void unwatch(const std::shared_ptr<queue_waker>& waker) {
+      std::lock_guard<std::mutex> lock(m_);
+      wakers_.erase(std::remove(wakers_.begin(), wakers_.end(), waker), wakers_.end());
    }
 
    bool empty() const {
@@ -73,4 +154,17 @@ public:
       std::lock_guard<std::mutex> lock(m_);
       return queue_.size();
    }
+
+   /// Release memory kept by the container. Only for containers with shrink_to_fit, e.g. segmented_queue
+   void shrink_to_fit() {
+      std::lock_guard<std::mutex> lock(m_);
+      queue_.shrink_to_fit();
+   }
+
+   /// Run func(const Container&) under the lock, e.g. to read the statistics of a spill_queue
+   template<typename F>
+   auto with_storage(F func) const -> decltype(func(std::declval<const Container&>())) {
+      std::lock_guard<std::mutex> lock(m_);
+      return func(queue_);
+   }
 };
@@ -0,0 +1,451 @@
+/** ==========================================================================
+ * 2014 by KjellKod.cc. This is PUBLIC DOMAIN to use at your own risk and comes
+ * with no warranties. This code is yours to share, use and modify with no
+ * strings attached and no restrictions or obligations.
+ * ============================================================================
+ *
+ * Inter-process queue in a POSIX shared memory segment, Linux only.
+ *
+ * A bounded, lock-free, multiple producer, multiple consumer ring of trivially copyable
+ * messages. Waiting producers and consumers sleep on futex words in the segment so they
+ * are woken up across processes. shm_consumer is the matching consumer loop: the thread
+ * of an active object in one process, fed by producers in other processes.
+ *
+ * Robustness: a producer claims a slot by writing its pid into the slot state, in the same
+ * atomic operation as the claim. If it dies before the message is published the consumers
+ * find the pid dead and skip the slot, see skipped(). A dead writer that is not yet reaped
+ * by its parent, or whose pid is reused, is taken for alive. A consumer that dies in the
+ * middle of a pop is not recovered.
+ *
+ * example usage:
+ *   // back-end process, owns the segment
+ *   shm_consumer<Order> engine_feed(shm_queue<Order>::create("/orders"),
+ *                                   [&engine](const Order& order) { engine.handle(order); });
+ *   // front-end process
+ *   auto orders = shm_queue<Order>::open("/orders");
+ *   orders.push(order);
+ * ============================================================================*/
+
+#pragma once
+
+#if defined(__linux__)
+
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <fcntl.h>
+#include <pthread.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "futex.hpp"
+
+namespace shm_queue_detail {
+   static_assert(ATOMIC_LLONG_LOCK_FREE == 2 && ATOMIC_INT_LOCK_FREE == 2,
+                 "atomics in shared memory must be lock-free");
+
+   constexpr uint64_t kMagic = 0x6b6a656c6c6b6f64ULL;
+   constexpr uint32_t kFree = 0;               // slot state owner: not claimed in this lap
+   constexpr uint32_t kPublished = 0xffffffff; // a message is ready
+   constexpr uint32_t kAbandoned = 0xfffffffe; // the writer gave up, e.g. it threw
+   // anything else is the pid of the writer
+
+   /// a crashed writer does not wake anyone up, sleepers poll for it this often
+   constexpr std::chrono::milliseconds kLivenessPoll{10};
+
+   inline uint64_t make_state(uint32_t lap, uint32_t owner) {
+      return (static_cast<uint64_t>(lap) << 32) | owner;
+   }
+   inline uint32_t lap_of(uint64_t state) { return static_cast<uint32_t>(state >> 32); }
+   inline uint32_t owner_of(uint64_t state) { return static_cast<uint32_t>(state); }
+
+   inline bool is_alive(uint32_t pid) {
+      return 0 == kill(static_cast<pid_t>(pid), 0) || EPERM == errno;
+   }
+
+   /// getpid() is a system call, the pid is cached and forgotten in a forked child
+   inline uint32_t current_pid() {
+      static std::atomic<pid_t> cached{0};
+      static const int registered = pthread_atfork(nullptr, nullptr, [] { cached.store(0); });
+      (void)registered;
+      pid_t pid = cached.load(std::memory_order_relaxed);
+      if (0 == pid) {
+         pid = getpid();
+         cached.store(pid, std::memory_order_relaxed);
+      }
+      return static_cast<uint32_t>(pid);
+   }
+
+   constexpr size_t log2(size_t value) {
+      return value <= 1 ? 0 : 1 + log2(value >> 1);
+   }
+} // namespace shm_queue_detail
+
+
+template<typename T, size_t Capacity = 1024>
+class shm_queue {
+   static_assert(std::is_trivially_copyable<T>::value, "shm_queue messages must be trivially copyable");
+   static_assert(Capacity > 1 && (Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+   static constexpr size_t kMask = Capacity - 1;
+   static constexpr size_t kShift = shm_queue_detail::log2(Capacity);
+
+   struct Slot {
+      std::atomic<uint64_t> state; // lap and owner, see shm_queue_detail
+      T item;
+   };
+
+   struct Header {
+      std::atomic<uint64_t> magic; // stored last by the creator
+      uint64_t capacity;
+      uint64_t item_size;
+      alignas(64) std::atomic<uint64_t> enqueue_pos;
+      alignas(64) std::atomic<uint64_t> dequeue_pos;
+      alignas(64) std::atomic<uint32_t> items;    // bumped on publish, futex word of consumers
+      std::atomic<uint32_t> consumers_waiting;
+      alignas(64) std::atomic<uint32_t> space;    // bumped on pop, futex word of producers
+      std::atomic<uint32_t> producers_waiting;
+      alignas(64) std::atomic<uint64_t> skipped;
+   };
+
+   struct Segment {
+      Header header;
+      Slot slots[Capacity];
+   };
+
+   std::string name_;
+   Segment* segment_;
+   bool owner_; // the creator unlinks the segment
+
+   shm_queue(const shm_queue&) = delete;
+   shm_queue& operator=(const shm_queue&) = delete;
+
+   shm_queue(std::string name, Segment* segment, bool owner)
+      : name_(std::move(name)), segment_(segment), owner_(owner) {
+   }
+
+   static Segment* map(int fd, const std::string& name) {
+      void* memory = mmap(nullptr, sizeof(Segment), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+      const int error = errno;
+      close(fd);
+      if (MAP_FAILED == memory) {
+         throw std::system_error(error, std::generic_category(), "mmap " + name);
+      }
+      return static_cast<Segment*>(memory);
+   }
+
+   void notify(std::atomic<uint32_t>& word, std::atomic<uint32_t>& waiting) {
+      word.fetch_add(1);
+      if (waiting.load() > 0) {
+         futex::wake(word);
+      }
+   }
+
+   void release(Slot& slot, uint32_t lap) {
+      slot.state.store(shm_queue_detail::make_state(lap + 1, shm_queue_detail::kFree), std::memory_order_release);
+      notify(segment_->header.space, segment_->header.producers_waiting);
+   }
+
+public:
+   typedef T value_type;
+   static constexpr size_t kCapacity = Capacity;
+
+   /**
+    * Create and map a new segment. It is unlinked when this object, the owner, goes away
+    * @param name POSIX shared memory name, e.g. "/orders"
+    * WARNING: throws std::system_error if the segment exists, see remove()
+    */
+   static shm_queue create(const std::string& name) {
+      const int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+      if (fd < 0) {
+         throw std::system_error(errno, std::generic_category(), "shm_open " + name);
+      }
+      if (0 != ftruncate(fd, sizeof(Segment))) {
+         const int error = errno;
+         close(fd);
+         shm_unlink(name.c_str());
+         throw std::system_error(error, std::generic_category(), "ftruncate " + name);
+      }
+      Segment* segment = nullptr;
+      try {
+         segment = map(fd, name); // zero filled: every slot is free in lap 0
+      } catch (...) {
+         shm_unlink(name.c_str());
+         throw;
+      }
+      segment->header.capacity = Capacity;
+      segment->header.item_size = sizeof(T);
+      segment->header.magic.store(shm_queue_detail::kMagic, std::memory_order_release);
+      return shm_queue(name, segment, true);
+   }
+
+   /**
+    * Map an existing segment, waiting up to 'timeout' for its creator to initialize it
+    * WARNING: throws std::system_error, or std::runtime_error if the segment does not match T and Capacity
+    */
+   static shm_queue open(const std::string& name, std::chrono::milliseconds timeout = std::chrono::milliseconds(1000)) {
+      const auto deadline = std::chrono::steady_clock::now() + timeout;
+      const int fd = shm_open(name.c_str(), O_RDWR, 0);
+      if (fd < 0) {
+         throw std::system_error(errno, std::generic_category(), "shm_open " + name);
+      }
+      struct stat info;
+      while (0 == fstat(fd, &info) && sizeof(Segment) != static_cast<size_t>(info.st_size)) {
+         if (0 != info.st_size || std::chrono::steady_clock::now() > deadline) { // 0: not truncated yet
+            close(fd);
+            throw std::runtime_error("shm_queue " + name + " has another capacity or message size");
+         }
+         std::this_thread::sleep_for(std::chrono::milliseconds(1));
+      }
+      Segment* segment = map(fd, name);
+      shm_queue queue(name, segment, false);
+      while (shm_queue_detail::kMagic != segment->header.magic.load(std::memory_order_acquire)) {
+         if (std::chrono::steady_clock::now() > deadline) {
+            throw std::runtime_error("shm_queue " + name + " was not initialized");
+         }
+         std::this_thread::sleep_for(std::chrono::milliseconds(1));
+      }
+      if (Capacity != segment->header.capacity || sizeof(T) != segment->header.item_size) {
+         throw std::runtime_error("shm_queue " + name + " has another capacity or message size");
+      }
+      return queue;
+   }
+
+   /// Unlink a segment that was left behind, e.g. by a crashed owner. @return true if it existed
+   static bool remove(const std::string& name) {
+      return 0 == shm_unlink(name.c_str());
+   }
+
+   shm_queue(shm_queue&& other) noexcept
+      : name_(std::move(other.name_)), segment_(other.segment_), owner_(other.owner_) {
+      other.segment_ = nullptr;
+      other.owner_ = false;
+   }
+
+   ~shm_queue() {
+      if (nullptr != segment_) {
+         munmap(segment_, sizeof(Segment));
+      }
+      if (owner_) {
+         shm_unlink(name_.c_str());
+      }
+   }
+
+   /**
+    * Claim a slot, fill the message in place with fill(T&) and publish it
+    * @return false immediately if the ring is full. If fill throws the slot is skipped
+    */
+   template<typename Fill>
+   bool try_push_with(Fill fill) {
+      using namespace shm_queue_detail;
+      Header& header = segment_->header;
+      const uint32_t pid = current_pid();
+      uint64_t pos = header.enqueue_pos.load(std::memory_order_acquire);
+      while (true) {
+         Slot& slot = segment_->slots[pos & kMask];
+         const uint32_t lap = static_cast<uint32_t>(pos >> kShift);
+         uint64_t state = slot.state.load(std::memory_order_acquire);
+
+         if (make_state(lap, kFree) == state) {
+            if (!slot.state.compare_exchange_strong(state, make_state(lap, pid), std::memory_order_acq_rel)) {
+               pos = header.enqueue_pos.load(std::memory_order_acquire);
+               continue;
+            }
+            uint64_t expected = pos; // a helper may have moved it already
+            header.enqueue_pos.compare_exchange_strong(expected, pos + 1);
+            try {
+               fill(slot.item);
+            } catch (...) {
+               slot.state.store(make_state(lap, kAbandoned), std::memory_order_release);
+               notify(header.items, header.consumers_waiting);
+               throw;
+            }
+            slot.state.store(make_state(lap, kPublished), std::memory_order_release);
+            notify(header.items, header.consumers_waiting);
+            return true;
+         }
+
+         const int32_t laps_ahead = static_cast<int32_t>(lap_of(state) - lap);
+         if (0 == laps_ahead) {
+            // claimed by a producer that has not moved enqueue_pos yet, maybe never will: help it
+            uint64_t expected = pos;
+            header.enqueue_pos.compare_exchange_strong(expected, pos + 1);
+         } else if (laps_ahead < 0) {
+            return false; // the message from the previous lap is not consumed yet
+         }
+         pos = header.enqueue_pos.load(std::memory_order_acquire);
+      }
+   }
+
+   /// \return immediately, with false if the ring is full
+   bool try_push(const T& item) {
+      return try_push_with([&item](T& slot) { slot = item; });
+   }
+
+   /// push, sleeping while the ring is full
+   void push(const T& item) {
+      Header& header = segment_->header;
+      while (!try_push(item)) {
+         header.producers_waiting.fetch_add(1);
+         const uint32_t seen = header.space.load();
+         if (!try_push(item)) {
+            futex::wait_for(header.space, seen, shm_queue_detail::kLivenessPoll);
+            header.producers_waiting.fetch_sub(1);
+            continue;
+         }
+         header.producers_waiting.fetch_sub(1);
+         return;
+      }
+   }
+
+   /// \return immediately, with true if a message was retrieved. Slots of dead writers are skipped
+   bool try_and_pop(T& popped_item) {
+      using namespace shm_queue_detail;
+      Header& header = segment_->header;
+      uint64_t pos = header.dequeue_pos.load(std::memory_order_acquire);
+      while (true) {
+         Slot& slot = segment_->slots[pos & kMask];
+         const uint32_t lap = static_cast<uint32_t>(pos >> kShift);
+         const uint64_t state = slot.state.load(std::memory_order_acquire);
+
+         if (lap_of(state) != lap) { // another consumer took it already
+            pos = header.dequeue_pos.load(std::memory_order_acquire);
+            continue;
+         }
+         const uint32_t owner = owner_of(state);
+         if (kFree == owner) {
+            return false; // empty
+         }
+         const bool has_item = (kPublished == owner);
+         if (!has_item && kAbandoned != owner && is_alive(owner)) {
+            return false; // the writer is still at it
+         }
+         if (!header.dequeue_pos.compare_exchange_strong(pos, pos + 1, std::memory_order_acq_rel)) {
+            continue;
+         }
+         if (has_item) {
+            popped_item = slot.item;
+         }
+         release(slot, lap);
+         if (has_item) {
+            return true;
+         }
+         header.skipped.fetch_add(1);
+         pos = header.dequeue_pos.load(std::memory_order_acquire);
+      }
+   }
+
+   /// Try to retrieve, if no message wait up to 'timeout' for one. \return true if retrieved
+   template<typename Rep, typename Period>
+   bool wait_and_pop_for(T& popped_item, const std::chrono::duration<Rep, Period>& timeout) {
+      Header& header = segment_->header;
+      const auto deadline = std::chrono::steady_clock::now() + timeout;
+      while (true) {
+         if (try_and_pop(popped_item)) {
+            return true;
+         }
+         header.consumers_waiting.fetch_add(1);
+         const uint32_t seen = header.items.load();
+         if (try_and_pop(popped_item)) {
+            header.consumers_waiting.fetch_sub(1);
+            return true;
+         }
+         const auto left = deadline - std::chrono::steady_clock::now();
+         if (left <= decltype(left)::zero()) {
+            header.consumers_waiting.fetch_sub(1);
+            return false;
+         }
+         const auto poll = std::chrono::duration_cast<std::chrono::nanoseconds>(left);
+         futex::wait_for(header.items, seen, std::min<std::chrono::nanoseconds>(poll, shm_queue_detail::kLivenessPoll));
+         header.consumers_waiting.fetch_sub(1);
+      }
+   }
+
+   /// Try to retrieve, if no message wait till one is available and try again
+   void wait_and_pop(T& popped_item) {
+      while (!wait_and_pop_for(popped_item, shm_queue_detail::kLivenessPoll)) {
+      }
+   }
+
+   bool empty() const {
+      return 0 == size();
+   }
+
+   /// \return snapshot of claimed and not yet consumed slots
+   size_t size() const {
+      const uint64_t dequeued = segment_->header.dequeue_pos.load();
+      const uint64_t enqueued = segment_->header.enqueue_pos.load();
+      return enqueued > dequeued ? static_cast<size_t>(enqueued - dequeued) : 0;
+   }
+
+   /// \return slots skipped because the writer died or gave up before publishing
+   uint64_t skipped() const {
+      return segment_->header.skipped.load();
+   }
+
+   const std::string& name() const { return name_; }
+};
+
+
+/**
+ * Consumer loop over a shm_queue: one thread that hands every message to 'handler'.
+ * Used as the thread of an active object, e.g. an engine that is fed from other processes.
+ * At shutdown the messages that are already in the queue are handled first.
+ */
+template<typename T, size_t Capacity = 1024>
+class shm_consumer {
+   shm_queue<T, Capacity> _queue;
+   std::function<void(const T&)> _handler;
+   std::atomic<bool> _stop;
+   std::atomic<size_t> _consumed;
+   std::thread _thd;
+
+   shm_consumer(const shm_consumer&) = delete;
+   shm_consumer& operator=(const shm_consumer&) = delete;
+
+   void run() {
+      T item;
+      while (!_stop.load()) {
+         if (_queue.wait_and_pop_for(item, shm_queue_detail::kLivenessPoll)) {
+            _handler(item);
+            ++_consumed;
+         }
+      }
+      while (_queue.try_and_pop(item)) {
+         _handler(item);
+         ++_consumed;
+      }
+   }
+
+ public:
+   shm_consumer(shm_queue<T, Capacity> queue, std::function<void(const T&)> handler)
+      : _queue(std::move(queue))
+      , _handler(std::move(handler))
+      , _stop(false)
+      , _consumed(0)
+      , _thd([this] { run(); }) {
+   }
+
+   virtual ~shm_consumer() {
+      _stop.store(true);
+      if (_thd.joinable()) {
+         _thd.join();
+      }
+   }
+
+   /// @return messages handled so far
+   size_t consumed() const { return _consumed.load(); }
+
+   const shm_queue<T, Capacity>& queue() const { return _queue; }
+};
+
+#endif // __linux__
@@ -0,0 +1,331 @@
+/** ==========================================================================
+ * 2014 by KjellKod.cc. This is PUBLIC DOMAIN to use at your own risk and comes
+ * with no warranties. This code is yours to share, use and modify with no
+ * strings attached and no restrictions or obligations.
+ * ============================================================================
+ *
+ * Storage for shared_queue that spills to disk instead of dropping items or growing
+ * without bound. Up to 'memory_items' are kept in memory. Beyond that, new items are
+ * serialized and appended to memory-mapped segment files in a local directory. The
+ * consumer reads them back in FIFO order once it catches up: while anything is on disk
+ * new items also go to disk, so the order holds across the memory/disk boundary.
+ *
+ * Writes and reads are sequential. A segment file is deleted once it is read back,
+ * the last one is kept and rewound for the next spill. Segment files are allocated on
+ * disk up front, so a full disk is a std::system_error from the push, not a SIGBUS.
+ *
+ * Two things differ from the plain std::queue of a shared_queue:
+ *    - push, front and pop throw std::system_error when a segment file can not be
+ *      created, allocated or mapped. shared_queue passes the exception to its caller.
+ *    - items still on disk when the queue is destroyed are lost, with their files.
+ *      Drain the queue first if they matter, stats().on_disk tells how many there are.
+ *
+ * It is not thread safe on its own, it replaces the std::queue inside shared_queue:
+ *    shared_queue<AuditEvent, spill_queue<AuditEvent>> sink{spill_queue<AuditEvent>(config)};
+ *    auto stats = sink.with_storage([](const spill_queue<AuditEvent>& s) { return s.stats(); });
+ *
+ * The payload must be serializable through spill_traits<T>. Trivially copyable types and
+ * std::string are supported, other types specialize spill_traits. The callbacks of a
+ * concurrent<T> can not be serialized, use it for queues of data.
+ * ============================================================================*/
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <string>
+#include <system_error>
+#include <type_traits>
+#include <utility>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+/**
+ * Serialization of a spilled item. Specialize for your payload:
+ *   static size_t size(const T& item);                      // bytes needed
+ *   static void write(const T& item, char* out);            // exactly size(item) bytes
+ *   static T read(const char* in, size_t size);
+ */
+template<typename T, typename Enable = void>
+struct spill_traits;
+
+template<typename T>
+struct spill_traits<T, typename std::enable_if<std::is_trivially_copyable<T>::value>::type> {
+   static size_t size(const T&) { return sizeof(T); }
+   static void write(const T& item, char* out) { std::memcpy(out, &item, sizeof(T)); }
+   static T read(const char* in, size_t) {
+      T item;
+      std::memcpy(&item, in, sizeof(T));
+      return item;
+   }
+};
+
+template<>
+struct spill_traits<std::string> {
+   static size_t size(const std::string& item) { return item.size(); }
+   static void write(const std::string& item, char* out) { std::memcpy(out, item.data(), item.size()); }
+   static std::string read(const char* in, size_t size) { return std::string(in, size); }
+};
+
+
+struct spill_config {
+   std::string directory = ".";            // must exist
+   std::string prefix = "spill";           // segment files are <directory>/<prefix>-<pid>-<queue>-<n>.seg
+   size_t memory_items = 4096;             // in-memory depth before items go to disk
+   size_t segment_bytes = 16 * 1024 * 1024;
+};
+
+struct spill_stats {
+   size_t in_memory;
+   size_t on_disk;
+   size_t segments;            // segment files in use
+   size_t spilled;             // items written to disk, total
+   size_t refilled;            // items read back from disk, total
+   size_t spilled_bytes;
+   double spill_rate;          // items per second written to disk, since the first spill
+   double refill_rate;         // items per second read back, since the first spill
+};
+
+
+template<typename T, typename Traits = spill_traits<T>>
+class spill_queue {
+   typedef std::chrono::steady_clock clock;
+   typedef uint32_t record_size;
+
+   struct Segment {
+      std::string path;
+      char* data = nullptr;   // mapped while it is written or read
+      size_t capacity = 0;
+      size_t write_pos = 0;
+      size_t read_pos = 0;
+      size_t written = 0;
+      size_t read = 0;
+   };
+
+   spill_config config_;
+   std::deque<T> memory_;
+   std::deque<Segment> segments_; // oldest first, the last one is written to
+   size_t on_disk_ = 0;
+   size_t next_segment_ = 0;
+   size_t queue_id_;
+   size_t spilled_ = 0;
+   size_t refilled_ = 0;
+   size_t spilled_bytes_ = 0;
+   clock::time_point first_spill_;
+
+   spill_queue& operator=(const spill_queue&) = delete;
+   spill_queue(const spill_queue&) = delete;
+
+   static size_t next_queue_id() {
+      static std::atomic<size_t> queues{0};
+      return queues++;
+   }
+
+   static void fail(const std::string& what, const std::string& path) {
+      throw std::system_error(errno, std::generic_category(), what + " " + path);
+   }
+
+   void map(Segment& segment) {
+      if (nullptr != segment.data) {
+         return;
+      }
+      const int fd = ::open(segment.path.c_str(), O_RDWR);
+      if (fd < 0) {
+         fail("open", segment.path);
+      }
+      void* memory = mmap(nullptr, segment.capacity, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+      ::close(fd);
+      if (MAP_FAILED == memory) {
+         fail("mmap", segment.path);
+      }
+      segment.data = static_cast<char*>(memory);
+   }
+
+   void unmap(Segment& segment) {
+      if (nullptr != segment.data) {
+         munmap(segment.data, segment.capacity);
+         segment.data = nullptr;
+      }
+   }
+
+   void remove_front_segment() {
+      Segment& segment = segments_.front();
+      unmap(segment);
+      ::unlink(segment.path.c_str());
+      segments_.pop_front();
+   }
+
+   void add_segment(size_t capacity) {
+      if (segments_.size() > 1) {
+         unmap(segments_.back()); // full, and not the one that is read
+      }
+      Segment segment;
+      segment.path = config_.directory + "/" + config_.prefix + "-" + std::to_string(getpid()) + "-"
+                     + std::to_string(queue_id_) + "-" + std::to_string(next_segment_++) + ".seg";
+      segment.capacity = capacity;
+      const int fd = ::open(segment.path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0600);
+      if (fd < 0) {
+         fail("open", segment.path);
+      }
+      // allocated, not sparse: writing to a hole of the mapping on a full disk is a SIGBUS
+      const int error = posix_fallocate(fd, 0, static_cast<off_t>(capacity));
+      if (0 != error) {
+         ::close(fd);
+         ::unlink(segment.path.c_str());
+         errno = error;
+         fail("posix_fallocate", segment.path);
+      }
+      ::close(fd);
+      segments_.push_back(std::move(segment));
+      map(segments_.back());
+   }
+
+   void spill(const T& item) {
+      const size_t bytes = Traits::size(item);
+      const size_t record = sizeof(record_size) + bytes;
+      if (segments_.empty() || segments_.back().capacity - segments_.back().write_pos < record) {
+         add_segment(std::max(config_.segment_bytes, record));
+      }
+      if (0 == spilled_) {
+         first_spill_ = clock::now();
+      }
+      Segment& segment = segments_.back();
+      char* out = segment.data + segment.write_pos;
+      const record_size size = static_cast<record_size>(bytes);
+      std::memcpy(out, &size, sizeof(size));
+      Traits::write(item, out + sizeof(size));
+      segment.write_pos += record;
+      ++segment.written;
+      ++on_disk_;
+      ++spilled_;
+      spilled_bytes_ += record;
+   }
+
+   /// read back from disk until memory is full again or the disk is empty
+   void refill() {
+      while (memory_.size() < config_.memory_items && on_disk_ > 0) {
+         Segment& segment = segments_.front();
+         if (segment.read == segment.written) { // read back completely, the writer is in a later one
+            remove_front_segment();
+            continue;
+         }
+         map(segment);
+         const char* in = segment.data + segment.read_pos;
+         record_size size;
+         std::memcpy(&size, in, sizeof(size));
+         memory_.push_back(Traits::read(in + sizeof(size), size));
+         segment.read_pos += sizeof(size) + size;
+         ++segment.read;
+         --on_disk_;
+         ++refilled_;
+      }
+      if (0 == on_disk_) {
+         while (segments_.size() > 1) {
+            remove_front_segment();
+         }
+         if (!segments_.empty()) { // keep the last file for the next spill
+            Segment& segment = segments_.front();
+            segment.write_pos = segment.read_pos = segment.written = segment.read = 0;
+         }
+      }
+   }
+
+public:
+   typedef T value_type;
+
+   explicit spill_queue(spill_config config = spill_config())
+      : config_(std::move(config))
+      , queue_id_(next_queue_id()) {
+      config_.memory_items = std::max<size_t>(1, config_.memory_items);
+   }
+
+   spill_queue(spill_queue&& other)
+      : config_(std::move(other.config_))
+      , memory_(std::move(other.memory_))
+      , segments_(std::move(other.segments_))
+      , on_disk_(other.on_disk_)
+      , next_segment_(other.next_segment_)
+      , queue_id_(other.queue_id_)
+      , spilled_(other.spilled_)
+      , refilled_(other.refilled_)
+      , spilled_bytes_(other.spilled_bytes_)
+      , first_spill_(other.first_spill_) {
+      other.segments_.clear();
+      other.on_disk_ = 0;
+   }
+
+   /// deletes the segment files. WARNING: items still on disk are lost, check stats().on_disk
+   ~spill_queue() {
+      while (!segments_.empty()) {
+         remove_front_segment();
+      }
+   }
+
+   /// WARNING: throws std::system_error if an item must be spilled and the segment file can not be created,
+   /// allocated (e.g. the disk is full) or mapped. The item is then not queued
+   void push(T&& item) {
+      if (0 == on_disk_ && memory_.size() < config_.memory_items) {
+         memory_.push_back(std::move(item));
+      } else {
+         spill(item);
+      }
+   }
+
+   void push(const T& item) {
+      T copy(item);
+      push(std::move(copy));
+   }
+
+   /// WARNING: throws std::system_error if a segment file can not be mapped for the read back
+   T& front() {
+      if (memory_.empty()) {
+         refill();
+      }
+      return memory_.front();
+   }
+
+   void pop() {
+      if (memory_.empty()) {
+         refill();
+      }
+      memory_.pop_front();
+   }
+
+   bool empty() const {
+      return memory_.empty() && 0 == on_disk_;
+   }
+
+   size_t size() const {
+      return memory_.size() + on_disk_;
+   }
+
+   /// Delete the file kept for the next spill. Only when nothing is on disk
+   void shrink_to_fit() {
+      if (0 == on_disk_) {
+         while (!segments_.empty()) {
+            remove_front_segment();
+         }
+      }
+   }
+
+   spill_stats stats() const {
+      spill_stats snapshot;
+      snapshot.in_memory = memory_.size();
+      snapshot.on_disk = on_disk_;
+      snapshot.segments = segments_.size();
+      snapshot.spilled = spilled_;
+      snapshot.refilled = refilled_;
+      snapshot.spilled_bytes = spilled_bytes_;
+      const double seconds = spilled_ ? std::chrono::duration<double>(clock::now() - first_spill_).count() : 0.0;
+      snapshot.spill_rate = seconds > 0 ? spilled_ / seconds : 0.0;
+      snapshot.refill_rate = seconds > 0 ? refilled_ / seconds : 0.0;
+      return snapshot;
+   }
+};
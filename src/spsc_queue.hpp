@@ -0,0 +1,186 @@
+/** ==========================================================================
+ * 2014 by KjellKod.cc. This is PUBLIC DOMAIN to use at your own risk and comes
+ * with no warranties. This code is yours to share, use and modify with no
+ * strings attached and no restrictions or obligations.
+ * ============================================================================
+ *
+ * Single producer, single consumer bounded ring with the same interface as shared_queue.
+ *
+ * Push and pop are wait-free as long as the ring is neither full nor empty. The producer
+ * and the consumer each own an index on a cache line of their own and keep a cached copy
+ * of the other side's index, so they only touch the other cache line when the cached
+ * value says the ring is full or empty.
+ *
+ * A push to a full ring waits for the consumer. wait_and_pop spins for a short while and
+ * then sleeps on a condition variable that the producer only touches when the consumer
+ * is actually asleep.
+ *
+ * Use it for a concurrent<T> that is fed by exactly one thread at a time:
+ *    concurrent<Engine, single_producer> engine;
+ * Debug builds assert if two threads push at the same time.
+ * ============================================================================*/
+
+#pragma once
+
+#include <atomic>
+#include <cassert>
+#include <condition_variable>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <thread>
+#include <type_traits>
+#include <utility>
+
+#include "std2_type_traits.hpp"
+
+/** Tag for concurrent<T, single_producer>. Calls must come from one thread at a time */
+struct single_producer {};
+
+template<typename T, size_t Capacity = 1024>
+class spsc_queue {
+   static_assert(Capacity > 1 && (Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+   static constexpr size_t kMask = Capacity - 1;
+   static constexpr size_t kCacheLine = 64;
+   static constexpr int kSpinBeforeSleep = 64;
+
+   typedef typename std::aligned_storage<sizeof(T), alignof(T)>::type Slot;
+
+   // consumer side
+   alignas(kCacheLine) std::atomic<size_t> head_;
+   size_t cached_tail_;
+   // producer side
+   alignas(kCacheLine) std::atomic<size_t> tail_;
+   size_t cached_head_;
+#ifndef NDEBUG
+   std::atomic<bool> pushing_;
+#endif
+   // only touched when the consumer goes to sleep
+   alignas(kCacheLine) std::atomic<bool> sleeping_;
+   std::mutex m_;
+   std::condition_variable data_cond_;
+
+   std::unique_ptr<Slot[]> ring_;
+
+   spsc_queue& operator=(const spsc_queue&) = delete;
+   spsc_queue(const spsc_queue& other) = delete;
+
+   T* slot(size_t index) {
+      return reinterpret_cast<T*>(&ring_[index & kMask]);
+   }
+
+   /// moves from 'item' only if there is room
+   bool try_emplace(T& item) {
+      const size_t tail = tail_.load(std::memory_order_relaxed);
+      if (tail - cached_head_ == Capacity) {
+         cached_head_ = head_.load(std::memory_order_acquire);
+         if (tail - cached_head_ == Capacity) {
+            return false;
+         }
+      }
+      ::new (slot(tail)) T(std::move(item));
+      tail_.store(tail + 1, std::memory_order_release);
+
+      // pairs with the fence in wait_and_pop: either the consumer sees the item or we see it sleeping
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+      if (sleeping_.load(std::memory_order_relaxed)) {
+         std::lock_guard<std::mutex> lock(m_);
+         data_cond_.notify_one();
+      }
+      return true;
+   }
+
+#ifndef NDEBUG
+   struct PushGuard {
+      std::atomic<bool>& pushing;
+      explicit PushGuard(std::atomic<bool>& p) : pushing(p) {
+         const bool second_producer = pushing.exchange(true);
+         assert(!second_producer && "spsc_queue: more than one thread is pushing");
+         (void)second_producer;
+      }
+      ~PushGuard() { pushing.store(false); }
+   };
+#endif
+
+public:
+   static constexpr size_t kCapacity = Capacity;
+
+   spsc_queue()
+      : head_(0), cached_tail_(0)
+      , tail_(0), cached_head_(0)
+#ifndef NDEBUG
+      , pushing_(false)
+#endif
+      , sleeping_(false)
+      , ring_(new Slot[Capacity]) {
+   }
+
+   ~spsc_queue() {
+      const size_t tail = tail_.load();
+      for (size_t index = head_.load(); index != tail; ++index) {
+         slot(index)->~T();
+      }
+   }
+
+   /// \return immediately, with false if the ring is full. The item is untouched then
+   bool try_push(T& item) {
+#ifndef NDEBUG
+      PushGuard guard(pushing_);
+#endif
+      return try_emplace(item);
+   }
+
+   /// push, waiting for the consumer if the ring is full
+   void push(T item) {
+#ifndef NDEBUG
+      PushGuard guard(pushing_);
+#endif
+      while (!try_emplace(item)) {
+         std::this_thread::yield();
+      }
+   }
+
+   /// \return immediately, with true if successful retrieval
+   bool try_and_pop(T& popped_item) {
+      const size_t head = head_.load(std::memory_order_relaxed);
+      if (head == cached_tail_) {
+         cached_tail_ = tail_.load(std::memory_order_acquire);
+         if (head == cached_tail_) {
+            return false;
+         }
+      }
+      T* item = slot(head);
+      std2::relocate_assign(popped_item, *item);
+      head_.store(head + 1, std::memory_order_release);
+      return true;
+   }
+
+   /// Try to retrieve, spin a little, then sleep till an item is available
+   void wait_and_pop(T& popped_item) {
+      for (int spin = 0; spin < kSpinBeforeSleep; ++spin) {
+         if (try_and_pop(popped_item)) {
+            return;
+         }
+         std::this_thread::yield();
+      }
+
+      std::unique_lock<std::mutex> lock(m_);
+      sleeping_.store(true, std::memory_order_relaxed);
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+      while (!try_and_pop(popped_item)) {
+         data_cond_.wait(lock);
+      }
+      sleeping_.store(false, std::memory_order_relaxed);
+   }
+
+   bool empty() const {
+      return head_.load() == tail_.load();
+   }
+
+   size_t size() const {
+      const size_t head = head_.load();
+      const size_t tail = tail_.load();
+      return tail - head;
+   }
+};
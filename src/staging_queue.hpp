@@ -0,0 +1,292 @@
+/** ==========================================================================
+ * 2014 by KjellKod.cc. This is PUBLIC DOMAIN to use at your own risk and comes
+ * with no warranties. This code is yours to share, use and modify with no
+ * strings attached and no restrictions or obligations.
+ * ============================================================================
+ *
+ * Queue with producer side staging buffers and the same interface as shared_queue.
+ *
+ * Every producer thread appends to a buffer of its own and publishes the whole buffer to
+ * the shared queue in one locked operation: when the buffer is full, when the time window
+ * since its first item has passed, or on an explicit flush(). Many producers at a high rate
+ * then take the shared lock once per batch instead of once per item.
+ *
+ * Items are FIFO per producer, not across producers. Nothing is stranded in a buffer:
+ * a consumer that finds the shared queue empty sweeps the buffers itself, a waiting consumer
+ * sweeps them when a window has passed, and a thread that exits publishes its buffers.
+ *
+ * Use it as the queue of a concurrent<T>:
+ *    concurrent<Logger, staging_queue<concurrent_helper::Callback>> logger;
+ *    logger.fire(&Logger::write, line);
+ *    logger.flush(); // optional, publish this thread's calls now
+ * ============================================================================*/
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+struct staging_config {
+   size_t buffer_items = 64;                     // a full buffer is published
+   std::chrono::microseconds window{200};        // a buffer is published at most this long after its first item
+};
+
+
+template<typename T>
+class staging_queue {
+   typedef std::chrono::steady_clock clock;
+
+   struct Buffer {
+      std::mutex m;
+      std::vector<T> items;
+      clock::time_point first;
+   };
+
+   struct Core {
+      const staging_config config;
+      std::mutex m;
+      std::condition_variable data_cond;
+      std::deque<T> items;
+      std::mutex registry_m;
+      std::vector<std::shared_ptr<Buffer>> buffers;
+      std::atomic<size_t> staged_buffers{0};   // buffers with items
+      std::atomic<int> idle_consumers{0};      // consumers that sleep without a timeout
+
+      explicit Core(staging_config c) : config(std::move(c)) {}
+
+      /// move the buffer's items to the shared queue. Called with the buffer locked
+      size_t publish_locked(Buffer& buffer) {
+         const size_t count = buffer.items.size();
+         if (0 == count) {
+            return 0;
+         }
+         {
+            std::lock_guard<std::mutex> lock(m);
+            for (auto& item : buffer.items) {
+               items.push_back(std::move(item));
+            }
+         }
+         buffer.items.clear();
+         staged_buffers.fetch_sub(1);
+         return count;
+      }
+
+      /// publish the buffers whose first item was staged at or before staged_before
+      void sweep(clock::time_point staged_before = clock::time_point::max()) {
+         std::lock_guard<std::mutex> registry_lock(registry_m);
+         for (auto& buffer : buffers) {
+            std::lock_guard<std::mutex> lock(buffer->m);
+            if (buffer->first <= staged_before) {
+               publish_locked(*buffer);
+            }
+         }
+      }
+
+      void unregister(const std::shared_ptr<Buffer>& buffer) {
+         std::lock_guard<std::mutex> registry_lock(registry_m);
+         for (auto it = buffers.begin(); it != buffers.end(); ++it) {
+            if (*it == buffer) {
+               buffers.erase(it);
+               return;
+            }
+         }
+      }
+   };
+
+   /// the buffers of one thread, published when the thread exits
+   struct Registration {
+      uint64_t queue_id;
+      std::weak_ptr<Core> core;
+      std::shared_ptr<Buffer> buffer;
+   };
+
+   struct ThreadBuffers {
+      std::vector<Registration> registrations;
+
+      ~ThreadBuffers() {
+         for (auto& registration : registrations) {
+            if (auto core = registration.core.lock()) {
+               {
+                  std::lock_guard<std::mutex> lock(registration.buffer->m);
+                  core->publish_locked(*registration.buffer);
+               }
+               core->data_cond.notify_one();
+               core->unregister(registration.buffer);
+            }
+         }
+      }
+   };
+
+   const uint64_t id_;
+   std::shared_ptr<Core> core_;
+
+   staging_queue& operator=(const staging_queue&) = delete;
+   staging_queue(const staging_queue& other) = delete;
+
+   static uint64_t next_id() {
+      static std::atomic<uint64_t> ids{0};
+      return ++ids;
+   }
+
+   /// the calling thread's buffer for this queue, registered on first use
+   Buffer& this_thread_buffer() {
+      static thread_local ThreadBuffers thread_buffers;
+      static thread_local uint64_t last_id = 0; // ids are never reused
+      static thread_local Buffer* last_buffer = nullptr;
+      if (last_id == id_) {
+         return *last_buffer;
+      }
+      auto& registrations = thread_buffers.registrations;
+      for (auto it = registrations.begin(); it != registrations.end();) {
+         if (it->queue_id == id_) {
+            last_id = id_;
+            last_buffer = it->buffer.get();
+            return *last_buffer;
+         }
+         it = it->core.expired() ? registrations.erase(it) : it + 1; // queues that are gone
+      }
+      auto buffer = std::make_shared<Buffer>();
+      buffer->items.reserve(core_->config.buffer_items);
+      {
+         std::lock_guard<std::mutex> lock(core_->registry_m);
+         core_->buffers.push_back(buffer);
+      }
+      registrations.push_back(Registration{id_, core_, buffer});
+      last_id = id_;
+      last_buffer = buffer.get();
+      return *buffer;
+   }
+
+   /// must be called with the core lock held and with items in the shared queue
+   void pop_locked(T& popped_item) {
+      popped_item = std::move(core_->items.front());
+      core_->items.pop_front();
+   }
+
+public:
+   explicit staging_queue(staging_config config = staging_config())
+      : id_(next_id())
+      , core_(std::make_shared<Core>(std::move(config))) {
+   }
+
+   /// stage the item in the calling thread's buffer, publish the buffer if it is full or old
+   void push(T item) {
+      Core& core = *core_;
+      Buffer& buffer = this_thread_buffer();
+      bool published = false;
+      {
+         std::lock_guard<std::mutex> lock(buffer.m); // only contended while a consumer sweeps
+         const auto now = clock::now();
+         if (buffer.items.empty()) {
+            buffer.first = now;
+            core.staged_buffers.fetch_add(1);
+            if (core.idle_consumers.load() > 0) {
+               std::lock_guard<std::mutex> wake(core.m);
+               core.data_cond.notify_all(); // the consumer waits with a timeout from now on
+            }
+         }
+         buffer.items.push_back(std::move(item));
+         if (buffer.items.size() >= core.config.buffer_items || now - buffer.first >= core.config.window) {
+            published = core.publish_locked(buffer) > 0;
+         }
+      }
+      if (published) {
+         core.data_cond.notify_one();
+      }
+   }
+
+   /// publish the calling thread's buffer now
+   void flush() {
+      Buffer& buffer = this_thread_buffer();
+      bool published = false;
+      {
+         std::lock_guard<std::mutex> lock(buffer.m);
+         published = core_->publish_locked(buffer) > 0;
+      }
+      if (published) {
+         core_->data_cond.notify_one();
+      }
+   }
+
+   /// \return immediately, with true if successful retrieval. Sweeps the buffers if the shared queue is empty
+   bool try_and_pop(T& popped_item) {
+      Core& core = *core_;
+      {
+         std::lock_guard<std::mutex> lock(core.m);
+         if (!core.items.empty()) {
+            pop_locked(popped_item);
+            return true;
+         }
+      }
+      if (0 == core.staged_buffers.load()) {
+         return false;
+      }
+      core.sweep();
+      std::lock_guard<std::mutex> lock(core.m);
+      if (core.items.empty()) {
+         return false;
+      }
+      pop_locked(popped_item);
+      return true;
+   }
+
+   /**
+    * Try to retrieve, if no items, wait till an item is published. While items are staged
+    * the wait lasts at most a window, after which the buffers that are older than a window
+    * are swept. The producers publish the younger ones themselves, or the next sweep does.
+    */
+   void wait_and_pop(T& popped_item) {
+      Core& core = *core_;
+      std::unique_lock<std::mutex> lock(core.m);
+      while (core.items.empty()) {
+         if (core.staged_buffers.load() > 0) {
+            const auto waited = clock::now() + core.config.window;
+            if (!core.data_cond.wait_until(lock, waited, [&core] { return !core.items.empty(); })) {
+               lock.unlock();
+               core.sweep(clock::now() - core.config.window);
+               lock.lock();
+            }
+            continue;
+         }
+         core.idle_consumers.fetch_add(1);
+         if (0 == core.staged_buffers.load()) { // pairs with the producer: it sees us idle or we see its buffer
+            core.data_cond.wait(lock);
+         }
+         core.idle_consumers.fetch_sub(1);
+      }
+      pop_locked(popped_item);
+   }
+
+   bool empty() const {
+      return 0 == size();
+   }
+
+   /// \return snapshot of published and staged items
+   size_t size() const {
+      Core& core = *core_;
+      size_t count = 0;
+      {
+         std::lock_guard<std::mutex> registry_lock(core.registry_m);
+         for (auto& buffer : core.buffers) {
+            std::lock_guard<std::mutex> lock(buffer->m);
+            count += buffer->items.size();
+         }
+      }
+      std::lock_guard<std::mutex> lock(core.m);
+      return count + core.items.size();
+   }
+
+   /// \return number of producer threads with a buffer
+   size_t producers() const {
+      std::lock_guard<std::mutex> registry_lock(core_->registry_m);
+      return core_->buffers.size();
+   }
+};
@@ -0,0 +1,245 @@
+/** ==========================================================================
+ * 2014 by KjellKod.cc. This is PUBLIC DOMAIN to use at your own risk and comes
+ * with no warranties. This code is yours to share, use and modify with no
+ * strings attached and no restrictions or obligations.
+ * ============================================================================
+ *
+ * Watchdog for tasks that run too long on a concurrent<T> worker. One slow call stalls
+ * everything queued behind it, the watchdog reports it while it is still running.
+ *
+ * The worker of a watched concurrent<T> stores the start time of each task in an atomic,
+ * nothing more. The watchdog thread polls those start times and calls the user callback
+ * with the instance id, the call-site tag, how long the task has run and the queue depth
+ * behind it. Each stalled task is reported once.
+ *
+ *    stall_watchdog watchdog(std::chrono::milliseconds(200), [](const stall_report& report) {
+ *       std::cerr << "concurrent #" << report.instance << " " << (report.tag ? report.tag : "?")
+ *                 << " ran " << report.running.count() << "ms, " << report.queue_depth << " waiting\n";
+ *    });
+ *    watchdog.watch(database);
+ *    {
+ *       concurrent_helper::call_site_tag tag("Database::compact");
+ *       database.fire(&Database::compact);
+ *    }
+ * ============================================================================*/
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace concurrent_helper {
+
+   /**
+    * Tags the calls that this thread queues while the object is in scope. The tag is what
+    * stall_watchdog reports for the call. It must outlive the calls, use a string literal.
+    * Tags nest, the innermost one is used.
+    */
+   class call_site_tag {
+      const char* _previous;
+
+      call_site_tag(const call_site_tag&) = delete;
+      call_site_tag& operator=(const call_site_tag&) = delete;
+
+      static const char*& slot() {
+         static thread_local const char* tag = nullptr;
+         return tag;
+      }
+
+    public:
+      explicit call_site_tag(const char* tag) : _previous(slot()) { slot() = tag; }
+      ~call_site_tag() { slot() = _previous; }
+
+      /// @return the tag of the calling thread, nullptr if none
+      static const char* current() { return slot(); }
+   };
+
+
+   /**
+    * What the worker of a concurrent<T> shares with the watchdogs that watch it. The worker
+    * only writes relaxed atomics, and only while at least one watchdog watches it.
+    */
+   class task_monitor {
+      typedef std::chrono::steady_clock clock;
+
+      const uint64_t _id;
+      std::atomic<int> _watchers{0};
+      std::atomic<int64_t> _started{0};          // clock ticks, 0 when no task runs
+      std::atomic<const char*> _tag{nullptr};
+      std::mutex _depth_m;                       // never taken by the worker
+      std::function<size_t()> _depth;
+
+      static uint64_t next_id() {
+         static std::atomic<uint64_t> ids{0};
+         return ++ids;
+      }
+
+    public:
+      task_monitor() : _id(next_id()) {}
+
+      uint64_t id() const { return _id; }
+
+      // worker side
+      bool watched() const { return _watchers.load(std::memory_order_relaxed) > 0; }
+      void begin() {
+         _tag.store(nullptr, std::memory_order_relaxed);
+         _started.store(std::max<int64_t>(1, clock::now().time_since_epoch().count()), std::memory_order_relaxed);
+      }
+      void end() { _started.store(0, std::memory_order_relaxed); }
+      void tag(const char* call_site) { _tag.store(call_site, std::memory_order_relaxed); }
+
+      // owner side, the depth function is removed before the queue goes away
+      void attach(std::function<size_t()> depth) {
+         std::lock_guard<std::mutex> lock(_depth_m);
+         _depth = std::move(depth);
+      }
+      void detach() { attach(nullptr); }
+
+      // watchdog side
+      void watch() { _watchers.fetch_add(1); }
+      void unwatch() { _watchers.fetch_sub(1); }
+      int64_t started() const { return _started.load(std::memory_order_relaxed); }
+      const char* current_tag() const { return _tag.load(std::memory_order_relaxed); }
+
+      /// @return the queue depth, or -1 if the owner is gone
+      int64_t queue_depth() {
+         std::lock_guard<std::mutex> lock(_depth_m);
+         return _depth ? static_cast<int64_t>(_depth()) : -1;
+      }
+   };
+} // namespace concurrent_helper
+
+
+struct stall_report {
+   uint64_t instance;                     // concurrent<T>::instance_id()
+   const char* tag;                       // call_site_tag of the task, nullptr if untagged
+   std::chrono::milliseconds running;     // how long the task has run when it was reported
+   size_t queue_depth;                    // calls waiting behind it
+};
+
+
+class stall_watchdog {
+   typedef std::chrono::steady_clock clock;
+
+   struct Watched {
+      std::weak_ptr<concurrent_helper::task_monitor> monitor;
+      int64_t reported; // start time of the last reported task
+   };
+
+   const std::chrono::milliseconds _threshold;
+   const std::chrono::milliseconds _period;
+   const std::function<void(const stall_report&)> _on_stall;
+   std::mutex _m;
+   std::condition_variable _cond;
+   std::vector<Watched> _watched;
+   size_t _reported;
+   bool _stop;
+   std::thread _thd;
+
+   stall_watchdog(const stall_watchdog&) = delete;
+   stall_watchdog& operator=(const stall_watchdog&) = delete;
+
+   void run() {
+      std::unique_lock<std::mutex> lock(_m);
+      while (!_stop) {
+         _cond.wait_for(lock, _period);
+         if (_stop) {
+            break;
+         }
+         std::vector<stall_report> reports = check();
+         _reported += reports.size();
+         lock.unlock(); // the callback may watch more objects
+         for (auto& report : reports) {
+            _on_stall(report);
+         }
+         lock.lock();
+      }
+   }
+
+   /// called with the lock held
+   std::vector<stall_report> check() {
+      std::vector<stall_report> reports;
+      const int64_t now = clock::now().time_since_epoch().count();
+      for (auto it = _watched.begin(); it != _watched.end();) {
+         auto monitor = it->monitor.lock();
+         if (!monitor) { // the concurrent object is gone
+            it = _watched.erase(it);
+            continue;
+         }
+         const int64_t started = monitor->started();
+         const auto running = std::chrono::duration_cast<std::chrono::milliseconds>(clock::duration(now - started));
+         if (0 != started && started != it->reported && running >= _threshold) {
+            const int64_t depth = monitor->queue_depth(); // locks the queue, only for a report
+            if (depth < 0) { // the concurrent object is being destroyed
+               it = _watched.erase(it);
+               continue;
+            }
+            it->reported = started;
+            reports.push_back(stall_report{monitor->id(), monitor->current_tag(), running, static_cast<size_t>(depth)});
+         }
+         ++it;
+      }
+      return reports;
+   }
+
+ public:
+   /**
+    * @param threshold a task that runs longer than this is reported
+    * @param on_stall called from the watchdog thread, once per stalled task
+    * @param period how often the workers are checked, a quarter of the threshold by default
+    */
+   stall_watchdog(std::chrono::milliseconds threshold, std::function<void(const stall_report&)> on_stall,
+                  std::chrono::milliseconds period = std::chrono::milliseconds(0))
+      : _threshold(threshold)
+      , _period(period.count() > 0 ? period : std::max(std::chrono::milliseconds(1), threshold / 4))
+      , _on_stall(std::move(on_stall))
+      , _reported(0)
+      , _stop(false)
+      , _thd([this] { run(); }) {
+   }
+
+   ~stall_watchdog() {
+      {
+         std::lock_guard<std::mutex> lock(_m);
+         _stop = true;
+      }
+      _cond.notify_all();
+      _thd.join();
+      for (auto& watched : _watched) {
+         if (auto monitor = watched.monitor.lock()) {
+            monitor->unwatch();
+         }
+      }
+   }
+
+   /// Watch a concurrent<T>, or anything else with a monitor(). Until then its worker keeps no timestamps
+   template<typename Object>
+   void watch(const Object& object) {
+      std::shared_ptr<concurrent_helper::task_monitor> monitor = object.monitor();
+      monitor->watch();
+      std::lock_guard<std::mutex> lock(_m);
+      _watched.push_back(Watched{monitor, 0});
+   }
+
+   /// @return number of objects that are watched and still alive at the last check
+   size_t watched() {
+      std::lock_guard<std::mutex> lock(_m);
+      return _watched.size();
+   }
+
+   /// @return number of stalled tasks reported so far
+   size_t reported() {
+      std::lock_guard<std::mutex> lock(_m);
+      return _reported;
+   }
+};
@@ -11,6 +11,10 @@
 
 #pragma once
 
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <new>
 #include <type_traits>
 
 namespace std2 {
@@ -28,5 +32,56 @@ namespace std2 {
    template<typename T >
    inline constexpr bool is_nothrow_move_assignable_v = std::is_nothrow_move_assignable_v<T>;
 #endif
+
+   // std::void_t is C++17. Defined through a struct to work around CWG 1558 on older compilers
+   template<typename... Ts>
+   struct make_void { typedef void type; };
+
+   template<typename... Ts>
+   using void_t = typename make_void<Ts...>::type;
+
+
+   // is_trivially_relocatable is proposed for the standard (P1144), it is not in C++17.
+   // Relocating is moving an object to new storage and ending the life of the old one.
+   // For a trivially relocatable type that is the same as copying its bytes.
+   // Trivially copyable types are, other types opt in with a specialization:
+   //    namespace std2 { template<> struct is_trivially_relocatable<Handle> : std::true_type {}; }
+   // Opt in only if the type holds no pointer into itself and nothing keeps its address.
+   template<typename T>
+   struct is_trivially_relocatable : std::is_trivially_copyable<T> {};
+
+   template<typename T>
+   struct is_trivially_relocatable<std::unique_ptr<T, std::default_delete<T>>> : std::true_type {};
+
+   template<typename T>
+   struct is_trivially_relocatable<std::shared_ptr<T>> : std::true_type {};
+
+   template<typename T>
+   struct is_trivially_relocatable<std::weak_ptr<T>> : std::true_type {};
+
+#if defined(__GLIBCXX__)
+   // libstdc++ only keeps trivially copyable functors inside the std::function, libc++ does not
+   template<typename Signature>
+   struct is_trivially_relocatable<std::function<Signature>> : std::true_type {};
+#endif
+
+   template<typename T>
+   constexpr bool is_trivially_relocatable_v = is_trivially_relocatable<T>::value;
+
+
+   /// to = std::move(from) and end the life of from. A byte copy for trivially relocatable types
+   template<typename T>
+   typename std::enable_if<is_trivially_relocatable<T>::value>::type
+   relocate_assign(T& to, T& from) noexcept {
+      to.~T();
+      std::memcpy(static_cast<void*>(&to), static_cast<const void*>(&from), sizeof(T));
+   }
+
+   template<typename T>
+   typename std::enable_if<!is_trivially_relocatable<T>::value>::type
+   relocate_assign(T& to, T& from) noexcept(std::is_nothrow_move_assignable<T>::value) {
+      to = std::move(from);
+      from.~T();
+   }
 }  // namespace std2
 
@@ -0,0 +1,171 @@
+/** ==========================================================================
+ * 2014 by KjellKod.cc. This is PUBLIC DOMAIN to use at your own risk and comes
+ * with no warranties. This code is yours to share, use and modify with no
+ * strings attached and no restrictions or obligations.
+ * ============================================================================
+ *
+ * Synchronous round trip to a concurrent<T> worker, behind call_and_wait and
+ * lambda_and_wait. The task, the result slot and the wake-up word all live in a
+ * wait_frame on the caller's stack. The queued callback only holds a pointer to the
+ * frame, small enough for the std::function to store it without an allocation.
+ *
+ * On a multi-core machine the caller spins for a short while, since many calls are done
+ * within a few microseconds, and then sleeps on a futex (a condition variable on other platforms).
+ * ============================================================================*/
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <new>
+#include <thread>
+#include <type_traits>
+#include <utility>
+
+#if defined(__linux__)
+#include "futex.hpp"
+#else
+#include <condition_variable>
+#include <mutex>
+#endif
+
+namespace concurrent_helper {
+
+   /// one-shot wake-up of one waiting thread
+   class wait_slot {
+      static const int kSpins = 4000;
+      enum : uint32_t { kWaiting = 0, kSleeping = 1, kDone = 2 };
+      std::atomic<uint32_t> _state{kWaiting};
+#if !defined(__linux__)
+      std::mutex _m;
+      std::condition_variable _cond;
+#endif
+
+      /// spinning only helps if the worker runs on another core meanwhile
+      static int spins() {
+         static const int spins = std::thread::hardware_concurrency() > 1 ? kSpins : 0;
+         return spins;
+      }
+
+    public:
+      void wait() {
+         for (int spin = 0, limit = spins(); spin < limit; ++spin) {
+            if (kDone == _state.load(std::memory_order_acquire)) {
+               return;
+            }
+         }
+#if defined(__linux__)
+         uint32_t expected = kWaiting;
+         if (_state.compare_exchange_strong(expected, kSleeping, std::memory_order_acq_rel)) {
+            while (kDone != _state.load(std::memory_order_acquire)) {
+               futex::wait(_state, kSleeping);
+            }
+         }
+#else
+         std::unique_lock<std::mutex> lock(_m);
+         _cond.wait(lock, [this] { return kDone == _state.load(std::memory_order_acquire); });
+#endif
+      }
+
+      void notify() {
+#if defined(__linux__)
+         // the waiter may return, and its frame go away, as soon as it sees kDone. A wake on
+         // the stale address is harmless, futex waiters re-check their condition
+         if (kSleeping == _state.exchange(kDone, std::memory_order_acq_rel)) {
+            futex::wake(_state, 1);
+         }
+#else
+         std::lock_guard<std::mutex> lock(_m); // notify before the waiter can return
+         _state.store(kDone, std::memory_order_release);
+         _cond.notify_one();
+#endif
+      }
+   };
+
+
+   /// stored result of a wait_frame, references are kept as std::reference_wrapper
+   template<typename R>
+   struct wait_result {
+      typedef typename std::conditional<std::is_reference<R>::value,
+              std::reference_wrapper<typename std::remove_reference<R>::type>, R>::type type;
+   };
+
+   /// func(worker) and its result or exception, on the caller's stack
+   template<typename R, typename F, typename T>
+   class wait_frame {
+      typedef typename wait_result<R>::type stored_type;
+
+      F& _func;
+      T& _worker;
+      wait_slot _done;
+      std::exception_ptr _error;
+      typename std::aligned_storage<sizeof(stored_type), alignof(stored_type)>::type _value;
+      bool _has_value;
+
+      wait_frame(const wait_frame&) = delete;
+      wait_frame& operator=(const wait_frame&) = delete;
+
+      stored_type& value() { return *reinterpret_cast<stored_type*>(&_value); }
+
+    public:
+      wait_frame(F& func, T& worker) : _func(func), _worker(worker), _has_value(false) {}
+
+      ~wait_frame() {
+         if (_has_value) {
+            value().~stored_type();
+         }
+      }
+
+      /// worker side
+      void run() {
+         try {
+            new (&_value) stored_type(_func(_worker));
+            _has_value = true;
+         } catch (...) {
+            _error = std::current_exception();
+         }
+         _done.notify();
+      }
+
+      /// caller side. @return the result or rethrow the exception of func
+      R get() {
+         _done.wait();
+         if (_error) {
+            std::rethrow_exception(_error);
+         }
+         return std::move(value());
+      }
+   };
+
+   template<typename F, typename T>
+   class wait_frame<void, F, T> {
+      F& _func;
+      T& _worker;
+      wait_slot _done;
+      std::exception_ptr _error;
+
+      wait_frame(const wait_frame&) = delete;
+      wait_frame& operator=(const wait_frame&) = delete;
+
+    public:
+      wait_frame(F& func, T& worker) : _func(func), _worker(worker) {}
+
+      void run() {
+         try {
+            _func(_worker);
+         } catch (...) {
+            _error = std::current_exception();
+         }
+         _done.notify();
+      }
+
+      void get() {
+         _done.wait();
+         if (_error) {
+            std::rethrow_exception(_error);
+         }
+      }
+   };
+} // namespace concurrent_helper
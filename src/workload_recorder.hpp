@@ -0,0 +1,198 @@
+/** ==========================================================================
+ * 2014 by KjellKod.cc. This is PUBLIC DOMAIN to use at your own risk and comes
+ * with no warranties. This code is yours to share, use and modify with no
+ * strings attached and no restrictions or obligations.
+ * ============================================================================
+ *
+ * Records the calls of a concurrent<T>: when each call was submitted, by which producer
+ * thread, with which call_site_tag, and how long it ran on the worker. The recording is
+ * saved to a compact binary file, and workload_replay.hpp plays it back with the same
+ * arrival pattern and service times against any queue, so configurations can be compared
+ * on production shaped load.
+ *
+ *    workload_recorder recorder;
+ *    service.start_recording(recorder);
+ *    ...
+ *    service.stop_recording();
+ *    recorder.save("service.workload");
+ *
+ * File layout, native byte order:
+ *    uint32 magic 'CWL1', uint32 tag count, per tag: uint32 length + bytes,
+ *    uint64 record count, records of 24 bytes (workload_record)
+ * ============================================================================*/
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+struct workload_record {
+   uint64_t submit_ns;   // since the recording started
+   uint64_t service_ns;  // time the call ran on the worker
+   uint32_t producer;    // small id of the submitting thread
+   uint32_t tag;         // index in workload::tags, 0 is untagged
+};
+static_assert(sizeof(workload_record) == 24, "workload_record is written as is");
+
+
+struct workload {
+   std::vector<std::string> tags{""};
+   std::vector<workload_record> records;   // in order of execution
+
+   /// WARNING: throws std::runtime_error if the file can not be written
+   void save(const std::string& path) const {
+      std::ofstream out(path, std::ios::binary | std::ios::trunc);
+      const uint32_t magic = kMagic;
+      const uint32_t tag_count = static_cast<uint32_t>(tags.size());
+      const uint64_t record_count = records.size();
+      out.write(reinterpret_cast<const char*>(&magic), sizeof(magic));
+      out.write(reinterpret_cast<const char*>(&tag_count), sizeof(tag_count));
+      for (auto& tag : tags) {
+         const uint32_t length = static_cast<uint32_t>(tag.size());
+         out.write(reinterpret_cast<const char*>(&length), sizeof(length));
+         out.write(tag.data(), length);
+      }
+      out.write(reinterpret_cast<const char*>(&record_count), sizeof(record_count));
+      out.write(reinterpret_cast<const char*>(records.data()), records.size() * sizeof(workload_record));
+      if (!out) {
+         throw std::runtime_error("can not write workload file " + path);
+      }
+   }
+
+   /**
+    * WARNING: throws std::runtime_error if the file can not be read or is not a workload file.
+    * Counts and lengths are checked against the size of the file before anything is allocated
+    */
+   static workload load(const std::string& path) {
+      std::ifstream in(path, std::ios::binary);
+      in.seekg(0, std::ios::end);
+      const std::streamoff file_size = in.tellg();
+      in.seekg(0, std::ios::beg);
+      uint32_t magic = 0;
+      uint32_t tag_count = 0;
+      in.read(reinterpret_cast<char*>(&magic), sizeof(magic));
+      in.read(reinterpret_cast<char*>(&tag_count), sizeof(tag_count));
+      if (!in || kMagic != magic) {
+         throw std::runtime_error("not a workload file " + path);
+      }
+      const std::string truncated = "truncated workload file " + path;
+      auto remaining = [&in, file_size] { return static_cast<uint64_t>(file_size - in.tellg()); };
+      if (0 == tag_count || tag_count > remaining() / sizeof(uint32_t)) {
+         throw std::runtime_error(truncated);
+      }
+      workload loaded;
+      loaded.tags.clear();
+      for (uint32_t index = 0; index < tag_count; ++index) {
+         uint32_t length = 0;
+         in.read(reinterpret_cast<char*>(&length), sizeof(length));
+         if (!in || length > remaining()) {
+            throw std::runtime_error(truncated);
+         }
+         std::string tag(length, '\0');
+         in.read(&tag[0], length);
+         loaded.tags.push_back(tag);
+      }
+      uint64_t record_count = 0;
+      in.read(reinterpret_cast<char*>(&record_count), sizeof(record_count));
+      if (!in || record_count > remaining() / sizeof(workload_record)) {
+         throw std::runtime_error(truncated);
+      }
+      loaded.records.resize(static_cast<size_t>(record_count));
+      in.read(reinterpret_cast<char*>(loaded.records.data()), loaded.records.size() * sizeof(workload_record));
+      if (!in) {
+         throw std::runtime_error(truncated);
+      }
+      for (auto& record : loaded.records) {
+         if (record.tag >= loaded.tags.size()) {
+            throw std::runtime_error("bad tag index in workload file " + path);
+         }
+      }
+      return loaded;
+   }
+
+ private:
+   static const uint32_t kMagic = 0x314c5743; // "CWL1"
+};
+
+
+class workload_recorder {
+ public:
+   typedef std::chrono::steady_clock clock;
+
+ private:
+   const clock::time_point _start;
+   const size_t _max_records;
+   mutable std::mutex _m;
+   workload _workload;
+   std::unordered_map<const char*, uint32_t> _tag_index; // tags are string literals
+   size_t _missed;
+
+   workload_recorder(const workload_recorder&) = delete;
+   workload_recorder& operator=(const workload_recorder&) = delete;
+
+   static uint64_t ns(clock::duration duration) {
+      return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count());
+   }
+
+   uint32_t tag_locked(const char* tag) {
+      if (nullptr == tag) {
+         return 0;
+      }
+      auto found = _tag_index.find(tag);
+      if (found != _tag_index.end()) {
+         return found->second;
+      }
+      uint32_t index = 0;
+      for (; index < _workload.tags.size() && _workload.tags[index] != tag; ++index) {}
+      if (index == _workload.tags.size()) {
+         _workload.tags.push_back(tag);
+      }
+      _tag_index.emplace(tag, index);
+      return index;
+   }
+
+ public:
+   /// @param max_records calls beyond this are not recorded, see missed()
+   explicit workload_recorder(size_t max_records = 1 << 22)
+      : _start(clock::now()), _max_records(max_records), _missed(0) {}
+
+   /// @return small id of the calling thread, the same for all recorders
+   static uint32_t producer_id() {
+      static std::atomic<uint32_t> producers{0};
+      static thread_local uint32_t id = producers++;
+      return id;
+   }
+
+   /// worker side, called after each recorded call
+   void record(clock::time_point submitted, clock::duration service, uint32_t producer, const char* tag) {
+      std::lock_guard<std::mutex> lock(_m);
+      if (_workload.records.size() >= _max_records) {
+         ++_missed;
+         return;
+      }
+      _workload.records.push_back(workload_record{ns(submitted - _start), ns(service), producer, tag_locked(tag)});
+   }
+
+   /// @return copy of what is recorded so far
+   workload recorded() const {
+      std::lock_guard<std::mutex> lock(_m);
+      return _workload;
+   }
+
+   /// @return number of calls that were not recorded since max_records was reached
+   size_t missed() const {
+      std::lock_guard<std::mutex> lock(_m);
+      return _missed;
+   }
+
+   /// WARNING: throws std::runtime_error if the file can not be written
+   void save(const std::string& path) const { recorded().save(path); }
+};
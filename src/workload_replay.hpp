@@ -0,0 +1,108 @@
+/** ==========================================================================
+ * 2014 by KjellKod.cc. This is PUBLIC DOMAIN to use at your own risk and comes
+ * with no warranties. This code is yours to share, use and modify with no
+ * strings attached and no restrictions or obligations.
+ * ============================================================================
+ *
+ * Plays back a workload from workload_recorder.hpp against a concurrent<T> with any queue.
+ * One thread per recorded producer submits its calls at the recorded times, under the
+ * recorded call_site_tag, and each call keeps the worker busy for its recorded service time.
+ *
+ *    workload recorded = workload::load("service.workload");
+ *    replay_result fifo = replay<shared_queue<concurrent_helper::Callback>>(recorded);
+ *    replay_result fair = replay<fair_queue<concurrent_helper::Callback>>(recorded);
+ * ============================================================================*/
+
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <map>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include "concurrent.hpp"
+#include "workload_recorder.hpp"
+
+struct replay_result {
+   std::chrono::steady_clock::duration elapsed;   // first submit until the last call is done
+   std::vector<long long> latency_ns;             // per record, from submit until done
+};
+
+namespace concurrent_helper {
+   /// the replayed worker, it only burns the recorded service times
+   struct replay_service {
+      typedef std::chrono::steady_clock clock;
+      void serve(clock::duration service, clock::time_point submitted, long long* latency_ns) {
+         const auto until = clock::now() + service;
+         while (clock::now() < until) {}
+         *latency_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(clock::now() - submitted).count();
+      }
+   };
+} // namespace concurrent_helper
+
+
+/**
+ * Replay the recorded calls against concurrent<replay_service, Queue>
+ * @param recorded workload, e.g. from workload::load
+ * @param speed arrivals come speed times faster than recorded, the service times are kept
+ *
+ * WARNING: throws std::runtime_error if a record's tag is not in recorded.tags, and
+ * std::invalid_argument if speed is not positive, or so small that the replay would not fit in the clock
+ */
+template<typename Queue = shared_queue<concurrent_helper::Callback>>
+replay_result replay(const workload& recorded, double speed = 1.0) {
+   typedef std::chrono::steady_clock clock;
+   if (!(speed > 0)) { // NaN too
+      throw std::invalid_argument("replay speed must be positive");
+   }
+   uint64_t last_submit = 0;
+   for (auto& record : recorded.records) {
+      if (record.tag >= recorded.tags.size()) {
+         throw std::runtime_error("workload record with an unknown tag");
+      }
+      last_submit = std::max(last_submit, record.submit_ns);
+   }
+   if (last_submit / speed >= static_cast<double>(std::numeric_limits<long long>::max() / 2)) {
+      throw std::invalid_argument("replay speed too small for the recording");
+   }
+   std::map<uint32_t, std::vector<size_t>> producers;
+   for (size_t index = 0; index < recorded.records.size(); ++index) {
+      producers[recorded.records[index].producer].push_back(index);
+   }
+   for (auto& producer : producers) {
+      std::sort(producer.second.begin(), producer.second.end(), [&recorded](size_t lhs, size_t rhs) {
+         return recorded.records[lhs].submit_ns < recorded.records[rhs].submit_ns;
+      });
+   }
+
+   replay_result result;
+   result.latency_ns.resize(recorded.records.size());
+   const clock::time_point start = clock::now();
+   {
+      concurrent<concurrent_helper::replay_service, Queue> service;
+      std::vector<std::thread> threads;
+      for (auto& producer : producers) {
+         const std::vector<size_t>* calls = &producer.second;
+         threads.emplace_back([&service, &recorded, &result, calls, start, speed] {
+            for (size_t index : *calls) {
+               const workload_record& record = recorded.records[index];
+               std::this_thread::sleep_until(start + std::chrono::nanoseconds(static_cast<long long>(record.submit_ns / speed)));
+               const char* tag = 0 == record.tag ? nullptr : recorded.tags[record.tag].c_str();
+               concurrent_helper::call_site_tag scope(tag);
+               const clock::duration service_time = std::chrono::nanoseconds(record.service_ns);
+               service.fire(&concurrent_helper::replay_service::serve, service_time, clock::now(), &result.latency_ns[index]);
+            }
+         });
+      }
+      for (auto& thread : threads) {
+         thread.join();
+      }
+   } // all calls are done when the worker has joined
+   result.elapsed = clock::now() - start;
+   return result;
+}
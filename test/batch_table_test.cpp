@@ -0,0 +1,187 @@
+#include "batch_table.hpp"
+
+#include <gtest/gtest.h>
+#include <future>
+#include <chrono>
+#include <map>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <vector>
+
+#include "concurrent.hpp"
+#include "staging_queue.hpp"
+#include "test_helper.hpp"
+using namespace test_helper;
+
+namespace {
+   struct Index {
+      std::map<int, std::string> entries;
+      std::vector<std::string> log;   // "insert", "batch <size>" or "note"
+      std::vector<std::pair<int, int>> order; // (producer, sequence) in the order they were applied
+
+      void insert(int key, std::string value) {
+         entries[key] = value;
+         log.push_back("insert");
+      }
+      void insert_batch(std::vector<std::tuple<int, std::string>>& calls) {
+         for (auto& call : calls) {
+            entries[std::get<0>(call)] = std::get<1>(call);
+         }
+         log.push_back("batch " + std::to_string(calls.size()));
+      }
+      void note() { log.push_back("note"); }
+
+      void apply(int producer, int sequence) { order.push_back(std::make_pair(producer, sequence)); }
+      void apply_batch(std::vector<std::tuple<int, int>>& calls) {
+         for (auto& call : calls) {
+            order.push_back(std::make_pair(std::get<0>(call), std::get<1>(call)));
+         }
+      }
+
+      void wait(std::shared_future<void> gate) { gate.wait(); }
+   };
+} // anonymous
+
+
+TEST(TestOfBatchCalls, ConsecutiveCallsBecomeOneBatch) {
+   concurrent<Index> index;
+   index.batch_calls(&Index::insert, &Index::insert_batch);
+   std::promise<void> open;
+   index.fire(&Index::wait, open.get_future().share()); // the inserts stay queued
+
+   for (int key = 0; key < 500; ++key) {
+      index.fire(&Index::insert, key, std::to_string(key));
+   }
+   EXPECT_EQ(499U, index.fused());
+   EXPECT_GE(2U, index.size()); // the batch, and the wait if it has not started yet
+   open.set_value();
+
+   auto result = index.lambda([](Index& i) { return std::make_pair(i.log, i.entries); }).get();
+   EXPECT_EQ(std::vector<std::string>{"batch 500"}, result.first);
+   ASSERT_EQ(500U, result.second.size());
+   EXPECT_EQ("499", result.second[499]);
+}
+
+TEST(TestOfBatchCalls, OtherCallsEndTheRun) {
+   concurrent<Index> index;
+   index.batch_calls(&Index::insert, &Index::insert_batch);
+   std::promise<void> open;
+   index.fire(&Index::wait, open.get_future().share());
+
+   for (int key = 0; key < 3; ++key) {
+      index.fire(&Index::insert, key, "a");
+   }
+   index.fire(&Index::note);
+   index.fire(&Index::insert, 10, "b");
+   index.call(&Index::insert, 11, "c"); // not fused
+   index.fire(&Index::insert, 12, "d");
+   index.fire(&Index::insert, 13, "d");
+   open.set_value();
+
+   auto log = index.lambda([](Index& i) { return i.log; }).get();
+   const std::vector<std::string> expected{"batch 3", "note", "batch 1", "insert", "batch 2"};
+   EXPECT_EQ(expected, log);
+}
+
+TEST(TestOfBatchCalls, OnlyCallsFromTheSameThreadJoin) {
+   concurrent<Index> index;
+   index.batch_calls(&Index::insert, &Index::insert_batch);
+   std::promise<void> open;
+   index.fire(&Index::wait, open.get_future().share());
+
+   index.fire(&Index::insert, 1, "main");
+   index.fire(&Index::insert, 2, "main");
+   std::thread other([&index] {
+      index.fire(&Index::insert, 3, "other");
+      index.fire(&Index::insert, 4, "other");
+   });
+   other.join();
+   index.fire(&Index::insert, 5, "main"); // the other thread's batch ended the run
+   open.set_value();
+
+   auto log = index.lambda([](Index& i) { return i.log; }).get();
+   const std::vector<std::string> expected{"batch 2", "batch 2", "batch 1"};
+   EXPECT_EQ(expected, log);
+   EXPECT_EQ(2U, index.fused());
+}
+
+TEST(TestOfBatchCalls, UnregisteredMethodsAreNotFused) {
+   concurrent<Index> index;
+   for (int key = 0; key < 10; ++key) {
+      index.fire(&Index::insert, key, "plain");
+   }
+   index.batch_calls(&Index::apply, &Index::apply_batch);
+   for (int key = 0; key < 10; ++key) {
+      index.fire(&Index::insert, key, "plain");
+   }
+   auto log = index.lambda([](Index& i) { return i.log; }).get();
+   EXPECT_EQ(20U, log.size());
+   EXPECT_EQ(0U, index.fused());
+}
+
+TEST(TestOfBatchCalls, NewBatchesCanBeQueuedOnAFullSingleProducerRing) {
+   concurrent<Index, single_producer> index;
+   index.batch_calls(&Index::insert, &Index::insert_batch);
+   index.batch_calls(&Index::apply, &Index::apply_batch);
+   std::promise<void> open;
+   std::shared_future<void> gate = open.get_future().share();
+   size_t fused_seen = 1;
+   auto done = index.lambda([&index, gate, &fused_seen](Index&) {
+      gate.wait();
+      fused_seen = index.fused(); // needs the table while the producer waits on the full ring
+   });
+   std::thread opener([&open] {
+      std::this_thread::sleep_for(std::chrono::milliseconds(50));
+      open.set_value();
+   });
+
+   const int kBatches = 2 * static_cast<int>(spsc_queue<concurrent_helper::Callback>::kCapacity);
+   for (int key = 0; key < kBatches; ++key) { // the ring fills up with batches of one call
+      index.fire(&Index::insert, key, "a");
+      index.fire(&Index::apply, 0, key);
+   }
+   opener.join();
+   done.get();
+   EXPECT_EQ(0U, fused_seen);
+   auto result = index.lambda([](Index& i) { return std::make_pair(i.entries.size(), i.order.size()); }).get();
+   EXPECT_EQ(static_cast<size_t>(kBatches), result.first);
+   EXPECT_EQ(static_cast<size_t>(kBatches), result.second);
+}
+
+namespace {
+   /// each producer's calls are applied in the order they were made, whatever the queue
+   template<typename Queue>
+   void ExpectOrderPerProducer() {
+      concurrent<Index, Queue> index;
+      index.batch_calls(&Index::apply, &Index::apply_batch);
+      const int kProducers = 4;
+      const int kCalls = 2000;
+      std::vector<std::thread> producers;
+      for (int producer = 0; producer < kProducers; ++producer) {
+         producers.emplace_back([&index, producer] {
+            for (int sequence = 0; sequence < kCalls; ++sequence) {
+               if (0 == sequence % 100) {
+                  index.fire(&Index::note);
+               }
+               index.fire(&Index::apply, producer, sequence);
+            }
+         });
+      }
+      for (auto& producer : producers) {
+         producer.join();
+      }
+      auto order = index.lambda([](Index& i) { return i.order; }).get();
+      ASSERT_EQ(static_cast<size_t>(kProducers * kCalls), order.size());
+      std::vector<int> next(kProducers, 0);
+      for (auto& applied : order) {
+         ASSERT_EQ(next[applied.first], applied.second);
+         ++next[applied.first];
+      }
+   }
+} // anonymous
+
+TEST(TestOfBatchCalls, OrderIsKeptWithManyProducers) {
+   ExpectOrderPerProducer<shared_queue<concurrent_helper::Callback>>();
+   ExpectOrderPerProducer<staging_queue<concurrent_helper::Callback>>();
+}
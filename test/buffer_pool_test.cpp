@@ -0,0 +1,117 @@
+#include "buffer_pool.hpp"
+
+#include <gtest/gtest.h>
+#include <atomic>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "concurrent.hpp"
+#include "test_helper.hpp"
+using namespace test_helper;
+
+namespace {
+   struct Decoder {
+      std::vector<const char*> seen;
+      std::string last;
+      void decode(pooled_buffer frame) {
+         seen.push_back(frame.data());
+         last.assign(frame.data(), frame.size());
+      }
+   };
+} // anonymous
+
+
+TEST(TestOfBufferPool, LeaseAndRelease) {
+   buffer_pool pool(2, 1024);
+   {
+      pooled_buffer first = pool.lease();
+      ASSERT_TRUE(bool(first));
+      EXPECT_EQ(1024U, first.capacity());
+      EXPECT_EQ(0U, first.size());
+      pooled_buffer second = pool.try_lease();
+      ASSERT_TRUE(bool(second));
+      EXPECT_NE(first.data(), second.data());
+      EXPECT_FALSE(bool(pool.try_lease())); // exhausted
+
+      auto stats = pool.stats();
+      EXPECT_EQ(2U, stats.in_use);
+      EXPECT_EQ(2U, stats.leases);
+      EXPECT_EQ(1U, stats.exhausted);
+   }
+   auto stats = pool.stats();
+   EXPECT_EQ(0U, stats.in_use);
+   EXPECT_EQ(2U, stats.peak_in_use);
+   EXPECT_TRUE(bool(pool.try_lease()));
+}
+
+TEST(TestOfBufferPool, CopiesShareThePayload) {
+   buffer_pool pool(1, 64);
+   pooled_buffer buffer = pool.lease();
+   std::strcpy(buffer.data(), "frame");
+   buffer.resize(5);
+   {
+      pooled_buffer copy = buffer;
+      EXPECT_EQ(2U, buffer.use_count());
+      EXPECT_EQ(buffer.data(), copy.data());
+      EXPECT_EQ(5U, copy.size());
+      pooled_buffer moved = std::move(copy);
+      EXPECT_FALSE(bool(copy));
+      EXPECT_EQ(2U, moved.use_count());
+   }
+   EXPECT_EQ(1U, buffer.use_count());
+   buffer = pooled_buffer();
+   EXPECT_EQ(0U, pool.stats().in_use);
+}
+
+TEST(TestOfBufferPool, HandedToTheWorkerWithoutACopy) {
+   buffer_pool pool(4, 64 * 1024);
+   concurrent<Decoder> decoder;
+   std::vector<const char*> sent;
+   for (int frame = 0; frame < 100; ++frame) {
+      pooled_buffer buffer = pool.lease(); // waits for the worker to release one
+      const std::string payload = "frame " + std::to_string(frame);
+      std::memcpy(buffer.data(), payload.data(), payload.size());
+      buffer.resize(payload.size());
+      sent.push_back(buffer.data());
+      decoder.fire(&Decoder::decode, std::move(buffer));
+   }
+   auto seen = decoder.lambda([](Decoder& d) { return d.seen; }).get();
+   EXPECT_EQ(sent, seen);
+   EXPECT_EQ("frame 99", decoder.lambda([](Decoder& d) { return d.last; }).get());
+
+   auto stats = pool.stats();
+   EXPECT_EQ(0U, stats.in_use); // released by the worker
+   EXPECT_EQ(100U, stats.leases);
+   EXPECT_GE(4U, stats.peak_in_use);
+}
+
+TEST(TestOfBufferPool, ManyThreadsGetExclusiveBuffers) {
+   buffer_pool pool(8, sizeof(size_t));
+   std::atomic<bool> shared{false};
+   std::vector<std::thread> threads;
+   for (size_t thread = 0; thread < 16; ++thread) {
+      threads.emplace_back([&pool, &shared, thread] {
+         for (size_t round = 0; round < 10000; ++round) {
+            pooled_buffer buffer = pool.lease();
+            const size_t mark = thread * 100000 + round;
+            std::memcpy(buffer.data(), &mark, sizeof(mark));
+            std::this_thread::yield();
+            size_t read = 0;
+            std::memcpy(&read, buffer.data(), sizeof(read));
+            if (read != mark) {
+               shared = true;
+            }
+         }
+      });
+   }
+   for (auto& thread : threads) {
+      thread.join();
+   }
+   EXPECT_FALSE(shared.load());
+   auto stats = pool.stats();
+   EXPECT_EQ(0U, stats.in_use);
+   EXPECT_EQ(160000U, stats.leases);
+   EXPECT_GE(8U, stats.peak_in_use);
+}
@@ -0,0 +1,104 @@
+#include "coalescing_table.hpp"
+
+#include <gtest/gtest.h>
+#include <future>
+#include <map>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "concurrent.hpp"
+#include "test_helper.hpp"
+using namespace test_helper;
+
+namespace {
+   struct Gauges {
+      std::vector<std::pair<std::string, int>> applied;
+      void set(std::string name, int value) { applied.push_back(std::make_pair(name, value)); }
+      void wait(std::shared_future<void> gate) { gate.wait(); }
+   };
+} // anonymous
+
+
+TEST(TestOfCoalescing, LatestWinsAtTheOriginalPosition) {
+   concurrent<Gauges> gauges;
+   std::promise<void> open;
+   gauges.fire(&Gauges::wait, open.get_future().share()); // the updates stay queued
+
+   gauges.fire_coalesced(std::string("cpu"), &Gauges::set, "cpu", 1);
+   gauges.fire_coalesced(std::string("mem"), &Gauges::set, "mem", 1);
+   gauges.fire(&Gauges::set, "plain", 0);
+   for (int value = 2; value <= 100; ++value) {
+      gauges.fire_coalesced(std::string("cpu"), &Gauges::set, "cpu", value);
+   }
+   gauges.fire_coalesced(std::string("mem"), &Gauges::set, "mem", 2);
+   EXPECT_EQ(100U, gauges.coalesced());
+   open.set_value();
+
+   auto applied = gauges.lambda([](Gauges& g) { return g.applied; }).get();
+   ASSERT_EQ(3U, applied.size());
+   EXPECT_EQ(std::make_pair(std::string("cpu"), 100), applied[0]);
+   EXPECT_EQ(std::make_pair(std::string("mem"), 2), applied[1]);
+   EXPECT_EQ(std::make_pair(std::string("plain"), 0), applied[2]);
+}
+
+TEST(TestOfCoalescing, AKeyIsQueuedAgainOnceItRuns) {
+   concurrent<Gauges> gauges;
+   for (int value = 0; value < 3; ++value) {
+      gauges.fire_coalesced(7, &Gauges::set, "seven", value);
+      gauges.call(&Gauges::set, "sync", value).wait();
+   }
+   auto applied = gauges.lambda([](Gauges& g) { return g.applied; }).get();
+   ASSERT_EQ(6U, applied.size());
+   EXPECT_EQ(std::make_pair(std::string("seven"), 2), applied[4]);
+   EXPECT_EQ(0U, gauges.coalesced());
+}
+
+TEST(TestOfCoalescing, KeysOfDifferentTypesAndCStrings) {
+   concurrent_helper::coalescing_table table;
+   std::vector<int> ran;
+   auto first = table.submit(1, [&] { ran.push_back(1); });
+   auto text = table.submit("1", [&] { ran.push_back(10); });
+   char name[] = "1";
+   EXPECT_FALSE(bool(table.submit(static_cast<const char*>(name), [&] { ran.push_back(11); }))); // same text
+   EXPECT_FALSE(bool(table.submit(std::string("1"), [&] { ran.push_back(12); })));
+   ASSERT_TRUE(bool(first));
+   ASSERT_TRUE(bool(text));
+   EXPECT_EQ(2U, table.queued());
+   EXPECT_EQ(2U, table.coalesced());
+
+   first();
+   text();
+   EXPECT_EQ((std::vector<int>{1, 12}), ran);
+   EXPECT_EQ(0U, table.queued());
+}
+
+TEST(TestOfCoalescing, ManyProducers) {
+   concurrent<Gauges> gauges;
+   std::promise<void> open;
+   gauges.fire(&Gauges::wait, open.get_future().share());
+   std::vector<std::thread> producers;
+   for (int producer = 0; producer < 4; ++producer) {
+      producers.emplace_back([&gauges, producer] {
+         for (int value = 0; value < 1000; ++value) {
+            gauges.fire_coalesced(producer, &Gauges::set, std::to_string(producer), value);
+         }
+      });
+   }
+   for (auto& producer : producers) {
+      producer.join();
+   }
+   open.set_value();
+   auto applied = gauges.lambda([](Gauges& g) { return g.applied; }).get();
+   ASSERT_EQ(4U, applied.size());
+   for (auto& update : applied) {
+      EXPECT_EQ(999, update.second);
+   }
+   EXPECT_EQ(4U * 999U, gauges.coalesced());
+}
+
+TEST(TestOfCoalescing, NullWorkerThrows) {
+   concurrent<Gauges> gauges{std::unique_ptr<Gauges>()};
+   EXPECT_THROW(gauges.fire_coalesced(1, &Gauges::set, "one", 1), std::runtime_error);
+}
@@ -0,0 +1,110 @@
+#include "codel_policy.hpp"
+
+#include <gtest/gtest.h>
+#include <chrono>
+#include <future>
+#include <thread>
+#include <vector>
+
+#include "concurrent.hpp"
+#include "test_helper.hpp"
+using namespace test_helper;
+
+namespace {
+   typedef codel_policy::clock codel_clock;
+   typedef std::chrono::milliseconds ms;
+
+   codel_config config(int target_ms, int interval_ms) {
+      codel_config c;
+      c.target = ms(target_ms);
+      c.interval = ms(interval_ms);
+      return c;
+   }
+
+   struct Service {
+      int served = 0;
+      int serve(int cost_us) {
+         std::this_thread::sleep_for(std::chrono::microseconds(cost_us));
+         return ++served;
+      }
+      void wait(std::shared_future<void> gate) { gate.wait(); }
+   };
+} // anonymous
+
+
+TEST(TestOfCodelPolicy, ShortQueuesAreNeverShed) {
+   codel_policy policy;
+   policy.configure(true, config(5, 100));
+   auto now = codel_clock::now();
+   for (int call = 0; call < 1000; ++call) {
+      now += ms(1);
+      EXPECT_FALSE(policy.drop(now - ms(4), now)); // below target
+   }
+   EXPECT_EQ(0U, policy.stats().dropped);
+}
+
+TEST(TestOfCodelPolicy, StandingQueueIsShedAtAnIncreasingRate) {
+   codel_policy policy;
+   policy.configure(true, config(5, 100));
+   auto start = codel_clock::now();
+   std::vector<int> drops_at; // ms
+   for (int t = 0; t < 1000; ++t) { // a call per ms, each 20ms in the queue
+      auto now = start + ms(t);
+      if (policy.drop(now - ms(20), now)) {
+         drops_at.push_back(t);
+      }
+   }
+   ASSERT_LT(3U, drops_at.size());
+   EXPECT_GE(drops_at[0], 100); // not before a whole interval above target
+   EXPECT_LE(drops_at[0], 101);
+   for (size_t drop = 2; drop < drops_at.size(); ++drop) {
+      EXPECT_LE(drops_at[drop] - drops_at[drop - 1], drops_at[drop - 1] - drops_at[drop - 2]);
+   }
+   EXPECT_TRUE(policy.stats().dropping);
+
+   auto now = start + ms(1000);
+   EXPECT_FALSE(policy.drop(now - ms(1), now)); // below target: stops shedding
+   EXPECT_FALSE(policy.stats().dropping);
+   EXPECT_EQ(drops_at.size(), policy.stats().dropped);
+}
+
+TEST(TestOfCodelPolicy, DisabledRunsEverything) {
+   codel_policy policy;
+   auto now = codel_clock::now();
+   for (int call = 0; call < 1000; ++call) {
+      now += ms(1);
+      EXPECT_FALSE(policy.drop(now - ms(500), now));
+   }
+   EXPECT_EQ(1000U, policy.stats().executed);
+}
+
+TEST(TestOfCodelPolicy, ConcurrentShedsDroppableCallsUnderOverload) {
+   concurrent<Service> service;
+   service.enable_codel(config(1, 10));
+   std::promise<void> open;
+   service.fire(&Service::wait, open.get_future().share());
+   std::vector<std::future<int>> droppable;
+   for (int call = 0; call < 300; ++call) {
+      droppable.push_back(service.call_droppable(&Service::serve, 200));
+   }
+   auto must_run = service.call(&Service::serve, 0);
+   std::this_thread::sleep_for(ms(20)); // a standing queue
+   open.set_value();
+
+   size_t shed = 0;
+   for (auto& result : droppable) {
+      try {
+         result.get();
+      } catch (const overload_error&) {
+         ++shed;
+      }
+   }
+   EXPECT_LT(0U, shed);
+   EXPECT_GT(300U, shed);
+   EXPECT_LT(0, must_run.get()); // plain calls are never shed
+   auto stats = service.codel();
+   EXPECT_EQ(shed, stats.dropped);
+   EXPECT_EQ(300U - shed, stats.executed);
+
+   EXPECT_NO_THROW(service.lambda_droppable([](Service& s) { return s.served; }).get()); // no queue, no shedding
+}
@@ -0,0 +1,184 @@
+#include "completion_queue.hpp"
+
+#include <gtest/gtest.h>
+#include <chrono>
+#include <memory>
+#include <set>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include "concurrent.hpp"
+#include "test_helper.hpp"
+using namespace test_helper;
+
+TEST(TestOfCompletionQueue, CompilerCheckForNoCopyConstructibleAndAssignable) {
+   static_assert(std::is_copy_constructible<completion_queue<int>>::value == false,
+      "completion queue can't be copied by constructor");
+   static_assert(std::is_copy_assignable<completion_queue<int>>::value == false,
+      "completion queue can't be copied by assignment operator");
+}
+
+TEST(TestOfCompletionQueue, CapacityIsPowerOfTwo) {
+   completion_queue<int> cq{1000};
+   EXPECT_EQ(1024U, cq.capacity());
+   EXPECT_TRUE(cq.empty());
+   EXPECT_EQ(0U, cq.size());
+}
+
+TEST(TestOfCompletionQueue, CallResultsLandWithTheirTag) {
+   completion_queue<std::string> cq;
+   concurrent<Greeting> greeting;
+   for (uint64_t tag = 0; tag < 100; ++tag) {
+      greeting.call_to(cq, tag, &Greeting::ping, tag);
+   }
+
+   std::vector<completion<std::string>> results;
+   while (results.size() < 100) {
+      cq.wait_and_drain(results, std::chrono::seconds(1));
+   }
+   for (uint64_t tag = 0; tag < 100; ++tag) {
+      EXPECT_EQ(tag, results[tag].tag); // FIFO from one concurrent
+      EXPECT_FALSE(results[tag].failed());
+      EXPECT_EQ("Hello World" + std::to_string(tag), results[tag].get());
+   }
+   EXPECT_TRUE(cq.empty());
+}
+
+TEST(TestOfCompletionQueue, ExceptionLandsWithItsTag) {
+   completion_queue<int> cq;
+   concurrent<DummyObject> object;
+   object.lambda_to(cq, 7, [](DummyObject&) -> int { throw std::runtime_error("failed"); });
+   object.lambda_to(cq, 8, [](DummyObject&) { return 8; });
+
+   std::vector<completion<int>> results;
+   while (results.size() < 2) {
+      cq.wait_and_drain(results, std::chrono::seconds(1));
+   }
+   EXPECT_EQ(7U, results[0].tag);
+   EXPECT_TRUE(results[0].failed());
+   EXPECT_THROW(results[0].get(), std::runtime_error);
+   EXPECT_EQ(8U, results[1].tag);
+   EXPECT_EQ(8, results[1].get());
+}
+
+TEST(TestOfCompletionQueue, VoidCallsAndEmptyWorker) {
+   completion_queue<void> cq;
+   concurrent<DummyObject> object;
+   object.call_to(cq, 1, &DummyObject::doNothing);
+
+   concurrent<DummyObject> nothing{std::unique_ptr<DummyObject>()};
+   nothing.call_to(cq, 2, &DummyObject::doNothing);
+
+   std::vector<completion<void>> results;
+   while (results.size() < 2) {
+      cq.wait_and_drain(results, std::chrono::seconds(1));
+   }
+   std::set<uint64_t> failed;
+   for (auto& result : results) {
+      if (result.failed()) {
+         failed.insert(result.tag);
+         EXPECT_THROW(result.get(), std::runtime_error);
+      }
+   }
+   EXPECT_EQ(std::set<uint64_t>{2}, failed);
+}
+
+TEST(TestOfCompletionQueue, WaitTimesOut) {
+   completion_queue<int> cq;
+   std::vector<completion<int>> results;
+   auto start = std::chrono::steady_clock::now();
+   EXPECT_EQ(0U, cq.wait_and_drain(results, std::chrono::milliseconds(20)));
+   EXPECT_GE(std::chrono::steady_clock::now() - start, std::chrono::milliseconds(20));
+   EXPECT_TRUE(results.empty());
+}
+
+TEST(TestOfCompletionQueue, DrainIsBoundedByMax) {
+   completion_queue<int> cq;
+   concurrent<DummyObject> object;
+   for (int tag = 0; tag < 10; ++tag) {
+      object.lambda_to(cq, tag, [tag](DummyObject&) { return tag; });
+   }
+   object.lambda([](DummyObject&) {}).wait(); // all ten are done
+   std::vector<completion<int>> results;
+   EXPECT_EQ(4U, cq.drain(results, 4));
+   EXPECT_EQ(6U, cq.drain(results));
+   for (int tag = 0; tag < 10; ++tag) {
+      EXPECT_EQ(tag, results[tag].get());
+   }
+}
+
+TEST(TestOfCompletionQueue, ManyConcurrentObjectsShareOneQueue) {
+   const size_t kObjects = 8;
+   const size_t kCalls = 1000;
+   completion_queue<std::string> cq{256}; // smaller than the number of calls, workers wait for the drain
+   std::vector<std::unique_ptr<concurrent<Greeting>>> objects;
+   for (size_t index = 0; index < kObjects; ++index) {
+      objects.emplace_back(new concurrent<Greeting>());
+   }
+
+   std::thread submitter([&] {
+      for (size_t call = 0; call < kCalls; ++call) {
+         for (size_t index = 0; index < kObjects; ++index) {
+            objects[index]->call_to(cq, index * kCalls + call, &Greeting::ping, call);
+         }
+      }
+   });
+
+   std::vector<completion<std::string>> results;
+   std::set<uint64_t> tags;
+   while (tags.size() < kObjects * kCalls) {
+      results.clear();
+      cq.wait_and_drain(results, std::chrono::seconds(1));
+      for (auto& result : results) {
+         EXPECT_EQ("Hello World" + std::to_string(result.tag % kCalls), result.get());
+         tags.insert(result.tag);
+      }
+   }
+   submitter.join();
+   EXPECT_EQ(kObjects * kCalls, tags.size());
+   EXPECT_TRUE(cq.empty());
+}
+
+#if defined(__linux__)
+namespace {
+   double thread_cpu_ms() {
+      timespec now;
+      clock_gettime(CLOCK_THREAD_CPUTIME_ID, &now);
+      return now.tv_sec * 1000.0 + now.tv_nsec / 1000000.0;
+   }
+} // anonymous
+
+TEST(TestOfCompletionQueue, WorkerSleepsOnAFullQueue) {
+   completion_queue<double> cq{2};
+   concurrent<Greeting> greeting;
+   for (uint64_t tag = 0; tag < 4; ++tag) { // two fit, the third blocks the worker
+      greeting.lambda_to(cq, tag, [](Greeting&) { return thread_cpu_ms(); });
+   }
+   std::this_thread::sleep_for(std::chrono::milliseconds(200));
+   EXPECT_EQ(2U, cq.size());
+
+   std::vector<completion<double>> results;
+   while (results.size() < 4) {
+      cq.wait_and_drain(results, std::chrono::seconds(1));
+   }
+   for (uint64_t tag = 0; tag < 4; ++tag) {
+      EXPECT_EQ(tag, results[tag].tag);
+   }
+   EXPECT_GT(50.0, results[3].get() - results[0].get()); // CPU time of the worker while it waited
+}
+#endif // __linux__
+
+TEST(TestOfCompletionQueue, LeftoverCompletionsAreDestroyed) {
+   auto shared = std::make_shared<int>(1);
+   {
+      completion_queue<std::shared_ptr<int>> cq{4};
+      concurrent<DummyObject> object;
+      object.lambda_to(cq, 1, [shared](DummyObject&) { return shared; });
+      object.lambda([](DummyObject&) {}).wait();
+      EXPECT_EQ(1U, cq.size());
+   }
+   EXPECT_EQ(1, shared.use_count());
+}
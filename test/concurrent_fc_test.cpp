@@ -0,0 +1,109 @@
+#include "concurrent_fc.hpp"
+
+#include <gtest/gtest.h>
+#include <atomic>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "test_helper.hpp"
+using namespace test_helper;
+
+namespace {
+   /** not thread safe on purpose */
+   struct Counter {
+      size_t value = 0;
+      void add() { ++value; }
+      size_t get() { return value; }
+      std::thread::id where() { return std::this_thread::get_id(); }
+   };
+} // namespace
+
+
+TEST(TestOfFlatCombiningConcurrent, Hello_World) {
+   concurrent_fc<Greeting> cs;
+   EXPECT_FALSE(cs.empty());
+   EXPECT_EQ("Hello World", cs.call(&Greeting::sayHello).get());
+   EXPECT_EQ("Hello World", cs.lambda([](Greeting& g) { return g.sayHello(); }).get());
+}
+
+TEST(TestOfFlatCombiningConcurrent, Empty) {
+   concurrent_fc<Greeting> cs{std::unique_ptr<Greeting>{nullptr}};
+   EXPECT_TRUE(cs.empty());
+   EXPECT_ANY_THROW(cs.call(&Greeting::sayHello).get());
+   EXPECT_ANY_THROW(cs.fire(&Greeting::sayHello));
+}
+
+TEST(TestOfFlatCombiningConcurrent, UncontendedCallRunsOnTheCallingThread) {
+   concurrent_fc<Counter> counter;
+   auto where = counter.call(&Counter::where);
+   EXPECT_TRUE(concurrent_helper::is_ready(where));
+   EXPECT_EQ(std::this_thread::get_id(), where.get());
+   EXPECT_EQ(0U, counter.size());
+}
+
+TEST(TestOfFlatCombiningConcurrent, VerifyFifoCalls) {
+   concurrent_fc<std::string> asyncString = {"start"};
+   std::string expected{"start"};
+   for (size_t index = 0; index < 1000; ++index) {
+      expected.append(" ").append(std::to_string(index));
+      asyncString.lambda([ = ](std::string & s) { s.append(" ").append(std::to_string(index)); });
+   }
+   EXPECT_EQ(expected, asyncString.lambda([](std::string & s) { return s; }).get());
+}
+
+TEST(TestOfFlatCombiningConcurrent, MutualExclusionAcrossManyProducers) {
+   concurrent_fc<Counter> counter;
+   std::vector<std::thread> producers;
+   for (int thread = 0; thread < 8; ++thread) {
+      producers.emplace_back([&counter] {
+         for (int call = 0; call < 10000; ++call) {
+            counter.fire(&Counter::add);
+         }
+      });
+   }
+   for (auto& producer : producers) {
+      producer.join();
+   }
+   EXPECT_EQ(80000U, counter.call(&Counter::get).get());
+}
+
+TEST(TestOfFlatCombiningConcurrent, CallFromInsideACallIsCombinedLater) {
+   concurrent_fc<Counter> counter;
+   auto inner = std::make_shared<std::future<size_t>>();
+   counter.lambda([&counter, inner](Counter& c) {
+      c.add();
+      *inner = counter.call(&Counter::get); // cannot run now, we are the combiner
+   }).get();
+   EXPECT_EQ(1U, inner->get());
+}
+
+TEST(TestOfFlatCombiningConcurrent, DestroyedRightAfterTheLastCallWhileOthersCombine) {
+   for (int round = 0; round < 200; ++round) {
+      std::unique_ptr<concurrent_fc<Counter>> counter(new concurrent_fc<Counter>());
+      concurrent_fc<Counter>* shared = counter.get();
+      std::vector<std::thread> producers;
+      for (int thread = 0; thread < 4; ++thread) {
+         producers.emplace_back([shared] {
+            for (int call = 0; call < 100; ++call) {
+               shared->fire(&Counter::add);
+            }
+         });
+      }
+      while (counter->call(&Counter::get).get() < 400U) {}
+      counter.reset(); // producers may still be inside their last fire
+      for (auto& producer : producers) {
+         producer.join();
+      }
+   }
+}
+
+TEST(TestOfFlatCombiningConcurrent, VerifyDestruction) {
+   std::atomic<bool> flag{true};
+   {
+      concurrent_fc<TrueAtExit> notifyAtExit{&flag};
+      EXPECT_FALSE(flag);
+   }
+   EXPECT_TRUE(flag);
+}
@@ -0,0 +1,150 @@
+#include "concurrent_future.hpp"
+
+#include <gtest/gtest.h>
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <vector>
+
+#include "concurrent.hpp"
+#include "test_helper.hpp"
+using namespace test_helper;
+
+namespace {
+   struct Sleeper {
+      int sleep_and_return(int ms) {
+         std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+         return ms;
+      }
+   };
+} // anonymous
+
+
+TEST(TestOfConcurrentFuture, ValueAndCopies) {
+   concurrent_promise<std::string> promise;
+   concurrent_future<std::string> future = promise.get_future();
+   concurrent_future<std::string> copy = future;
+   EXPECT_TRUE(future.valid());
+   EXPECT_FALSE(future.is_ready());
+   EXPECT_EQ(std::future_status::timeout, future.wait_for(std::chrono::milliseconds(1)));
+
+   promise.set_value("Hello");
+   EXPECT_TRUE(copy.is_ready());
+   EXPECT_EQ("Hello", future.get());
+   EXPECT_EQ("Hello", copy.get()); // read many times, like std::shared_future
+   EXPECT_THROW(promise.set_value("again"), std::future_error);
+}
+
+TEST(TestOfConcurrentFuture, ExceptionAndBrokenPromise) {
+   concurrent_future<int> failed;
+   concurrent_future<void> broken;
+   {
+      concurrent_promise<int> promise;
+      failed = promise.get_future();
+      promise.set_exception(std::make_exception_ptr(std::runtime_error("failed")));
+      concurrent_promise<void> never_set;
+      broken = never_set.get_future();
+   }
+   EXPECT_THROW(failed.get(), std::runtime_error);
+   EXPECT_THROW(broken.get(), std::future_error);
+}
+
+TEST(TestOfConcurrentFuture, CallbackRunsWhenReadyOrRightAway) {
+   concurrent_promise<void> promise;
+   auto future = promise.get_future();
+   int called = 0;
+   future.on_ready([&] { ++called; });
+   EXPECT_EQ(0, called);
+   promise.set_value();
+   EXPECT_EQ(1, called);
+   future.on_ready([&] { ++called; }); // already ready
+   EXPECT_EQ(2, called);
+}
+
+TEST(TestOfConcurrentFuture, FutureCallAndFutureLambda) {
+   concurrent<Greeting> greeting;
+   auto hello = greeting.future_call(&Greeting::ping, size_t{42});
+   auto world = greeting.future_lambda([](Greeting& g) { return g.sayHello(); });
+   auto nothing = greeting.future_lambda([](Greeting&) {});
+   EXPECT_EQ("Hello World42", hello.get());
+   EXPECT_EQ("Hello World", world.get());
+   nothing.get();
+
+   concurrent<Greeting> empty{std::unique_ptr<Greeting>()};
+   EXPECT_THROW(empty.future_call(&Greeting::sayHello).get(), std::runtime_error);
+}
+
+TEST(TestOfConcurrentFuture, WhenAllOverSeveralObjects) {
+   concurrent<Sleeper> a, b;
+   concurrent<Greeting> c;
+   auto all = when_all(a.future_call(&Sleeper::sleep_and_return, 20),
+                       b.future_call(&Sleeper::sleep_and_return, 1),
+                       c.future_call(&Greeting::sayHello));
+   auto futures = all.get();
+   EXPECT_EQ(20, std::get<0>(futures).get());
+   EXPECT_EQ(1, std::get<1>(futures).get());
+   EXPECT_EQ("Hello World", std::get<2>(futures).get());
+}
+
+TEST(TestOfConcurrentFuture, WhenAllKeepsExceptionsInTheFutures) {
+   concurrent<Greeting> greeting;
+   std::vector<concurrent_future<int>> futures;
+   futures.push_back(greeting.future_lambda([](Greeting&) { return 1; }));
+   futures.push_back(greeting.future_lambda([](Greeting&) -> int { throw std::runtime_error("failed"); }));
+   auto all = when_all(futures.begin(), futures.end()).get();
+   ASSERT_EQ(2U, all.size());
+   EXPECT_EQ(1, all[0].get());
+   EXPECT_THROW(all[1].get(), std::runtime_error);
+
+   std::vector<concurrent_future<int>> none;
+   EXPECT_TRUE(when_all(none.begin(), none.end()).get().empty());
+}
+
+TEST(TestOfConcurrentFuture, WhenAnyGivesTheFirstReady) {
+   concurrent<Sleeper> slow, fast;
+   concurrent_promise<int> never;
+   std::vector<concurrent_future<int>> futures;
+   futures.push_back(never.get_future());
+   futures.push_back(slow.future_call(&Sleeper::sleep_and_return, 200));
+   futures.push_back(fast.future_call(&Sleeper::sleep_and_return, 1));
+
+   auto start = std::chrono::steady_clock::now();
+   auto first = when_any(futures.begin(), futures.end()).get();
+   EXPECT_LT(std::chrono::steady_clock::now() - start, std::chrono::milliseconds(200));
+   EXPECT_EQ(2U, first.index);
+   EXPECT_EQ(1, first.futures[first.index].get());
+   EXPECT_FALSE(first.futures[0].is_ready());
+   never.set_value(0);
+}
+
+TEST(TestOfConcurrentFuture, WhenAnyOfEmptyRange) {
+   std::vector<concurrent_future<int>> none;
+   auto first = when_any(none.begin(), none.end()).get();
+   EXPECT_EQ(static_cast<size_t>(-1), first.index);
+   EXPECT_TRUE(first.futures.empty());
+}
+
+TEST(TestOfConcurrentFuture, ManyProducersOneWhenAll) {
+   const size_t kObjects = 8;
+   std::vector<std::unique_ptr<concurrent<Greeting>>> objects;
+   std::vector<concurrent_future<std::string>> futures;
+   for (size_t index = 0; index < kObjects; ++index) {
+      objects.emplace_back(new concurrent<Greeting>());
+   }
+   for (size_t round = 0; round < 100; ++round) {
+      futures.clear();
+      for (size_t index = 0; index < kObjects; ++index) {
+         futures.push_back(objects[index]->future_call(&Greeting::ping, index));
+      }
+      auto all = when_all(futures.begin(), futures.end()).get();
+      for (size_t index = 0; index < kObjects; ++index) {
+         ASSERT_TRUE(all[index].is_ready());
+         EXPECT_EQ("Hello World" + std::to_string(index), all[index].get());
+      }
+   }
+}
@@ -0,0 +1,108 @@
+#include "concurrent_pool.hpp"
+
+#include <gtest/gtest.h>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "test_helper.hpp"
+using namespace test_helper;
+
+namespace {
+   struct Parser {
+      std::string prefix;
+      explicit Parser(const std::string& p) : prefix(p) {}
+      std::string parse(int value) { return prefix + std::to_string(value); }
+      std::thread::id slow() {
+         std::this_thread::sleep_for(std::chrono::milliseconds(20));
+         return std::this_thread::get_id();
+      }
+   };
+
+   pool_config small_pool() {
+      pool_config config;
+      config.min_replicas = 1;
+      config.max_replicas = 4;
+      config.depth_threshold = 2;
+      config.wait_threshold = std::chrono::milliseconds(5);
+      config.cool_down = std::chrono::milliseconds(100);
+      return config;
+   }
+} // namespace
+
+
+TEST(TestOfConcurrentPool, CallAndLambda) {
+   concurrent_pool<Parser> pool{small_pool(), std::string{"#"}};
+   EXPECT_EQ(1U, pool.replicas());
+   EXPECT_EQ("#42", pool.call(&Parser::parse, 42).get());
+   EXPECT_EQ("#7", pool.lambda([](Parser& p) { return p.parse(7); }).get());
+}
+
+TEST(TestOfConcurrentPool, FactoryCreatesEveryReplica) {
+   std::atomic<int> created{0};
+   pool_config config = small_pool();
+   config.min_replicas = 3;
+   {
+      concurrent_pool<Parser> pool{config, [&created] {
+         ++created;
+         return std::make_unique<Parser>("factory:");
+      }};
+      EXPECT_EQ("factory:1", pool.call(&Parser::parse, 1).get());
+      EXPECT_EQ(3U, pool.replicas());
+   }
+   EXPECT_EQ(3, created);
+}
+
+TEST(TestOfConcurrentPool, ScalesUpWithBacklogAndRetiresIdleReplicas) {
+   std::mutex m;
+   std::vector<scaling_event> events;
+   pool_config config = small_pool();
+   config.on_scaling = [&](const scaling_event& event) {
+      std::lock_guard<std::mutex> lock(m);
+      events.push_back(event);
+   };
+
+   concurrent_pool<Parser> pool{config, std::string{}};
+   std::vector<std::future<std::thread::id>> results;
+   for (int call = 0; call < 40; ++call) {
+      results.push_back(pool.call(&Parser::slow));
+   }
+   std::set<std::thread::id> threads;
+   for (auto& result : results) {
+      threads.insert(result.get());
+   }
+   EXPECT_GT(threads.size(), 1U);
+   EXPECT_GT(pool.scale_ups(), 0U);
+   EXPECT_LE(pool.replicas(), 4U);
+
+   auto start = clock::now();
+   while (pool.replicas() > 1 && clock::now() - start < std::chrono::seconds(3)) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+   }
+   EXPECT_EQ(1U, pool.replicas());
+   EXPECT_EQ(pool.scale_ups(), pool.scale_downs());
+
+   std::lock_guard<std::mutex> lock(m);
+   ASSERT_FALSE(events.empty());
+   EXPECT_EQ(scaling_event::Kind::Added, events.front().kind);
+   EXPECT_EQ(scaling_event::Kind::Retired, events.back().kind);
+   EXPECT_EQ(1U, events.back().replicas);
+}
+
+TEST(TestOfConcurrentPool, AllCallsAreExecutedAtShutdown) {
+   std::atomic<int> executed{0};
+   {
+      concurrent_pool<DummyObject> pool{small_pool()};
+      for (int call = 0; call < 100; ++call) {
+         pool.lambda([&executed](DummyObject&) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            ++executed;
+         });
+      }
+   }
+   EXPECT_EQ(100, executed);
+}
@@ -0,0 +1,57 @@
+#include "concurrent_reaper.hpp"
+
+#include <gtest/gtest.h>
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "concurrent.hpp"
+#include "test_helper.hpp"
+using namespace test_helper;
+
+namespace {
+   struct Backlog {
+      std::atomic<int>* done;
+      explicit Backlog(std::atomic<int>* counter) : done(counter) {}
+      void slow() {
+         std::this_thread::sleep_for(std::chrono::milliseconds(10));
+         ++(*done);
+      }
+   };
+} // anonymous
+
+
+TEST(TestOfConcurrentReaper, DestroyAsyncDoesNotWaitForTheBacklog) {
+   std::atomic<int> done{0};
+   std::unique_ptr<concurrent<Backlog>> backlog(new concurrent<Backlog>(&done));
+   for (int call = 0; call < 10; ++call) {
+      backlog->fire(&Backlog::slow);
+   }
+   auto start = clock::now();
+   auto destroyed = concurrent<Backlog>::destroy_async(std::move(backlog));
+   EXPECT_LT(clock::now() - start, std::chrono::milliseconds(50));
+   EXPECT_EQ(nullptr, backlog.get());
+   EXPECT_FALSE(concurrent_helper::is_ready(destroyed));
+
+   destroyed.wait();
+   EXPECT_EQ(10, done.load()); // the queued calls were still executed
+}
+
+TEST(TestOfConcurrentReaper, DeleterAndWaitAll) {
+   std::atomic<int> done{0};
+   {
+      std::vector<std::unique_ptr<concurrent<Backlog>, concurrent_helper::async_delete>> connections;
+      for (int connection = 0; connection < 5; ++connection) {
+         connections.emplace_back(new concurrent<Backlog>(&done));
+         connections.back()->fire(&Backlog::slow);
+         connections.back()->fire(&Backlog::slow);
+      }
+   } // handed to the reaper
+   EXPECT_LT(done.load(), 10);
+   concurrent_reaper::wait_all();
+   EXPECT_EQ(10, done.load());
+   EXPECT_EQ(0U, concurrent_reaper::pending());
+}
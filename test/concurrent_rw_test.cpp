@@ -0,0 +1,115 @@
+#include "concurrent_rw.hpp"
+
+#include <gtest/gtest.h>
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "test_helper.hpp"
+using namespace test_helper;
+
+namespace {
+   struct Table {
+      int value = 0;
+
+      int get() const { return value; }
+      void set(int v) { value = v; }
+      void add(int v) { value += v; }
+   };
+
+   /** Wait until 'count' readers are inside at the same time. Impossible if reads are serialized */
+   bool rendezvous(std::atomic<int>& inside, int count) {
+      ++inside;
+      auto start = clock::now();
+      while (inside.load() < count) {
+         if (clock::now() - start > std::chrono::seconds(2)) {
+            return false;
+         }
+         std::this_thread::yield();
+      }
+      return true;
+   }
+} // namespace
+
+
+TEST(TestOfConcurrentRW, CompilerCheckForReadOnlyClassification) {
+   auto reader = [](const Table& t) { return t.get(); };
+   auto writer = [](Table& t) { t.set(1); };
+   static_assert(concurrent_helper::is_read_only_lambda<decltype(reader), Table>::value, "const T& lambda is a read");
+   static_assert(!concurrent_helper::is_read_only_lambda<decltype(writer), Table>::value, "T& lambda is a write");
+   auto generic_writer = [](auto& t) { t.set(1); return t.get(); };
+   auto generic_reader = [](const auto& t) { return t.get(); };
+   static_assert(!concurrent_helper::is_read_only_lambda<decltype(generic_writer), Table>::value, "generic lambda is a write");
+   static_assert(!concurrent_helper::is_read_only_lambda<decltype(generic_reader), Table>::value, "generic lambda is a write");
+   static_assert(concurrent_helper::is_const_member_function<decltype(&Table::get)>::value, "const member is a read");
+   static_assert(!concurrent_helper::is_const_member_function<decltype(&Table::set)>::value, "member is a write");
+}
+
+TEST(TestOfConcurrentRW, GenericLambdaIsAWrite) {
+   concurrent_rw<Table> table;
+   EXPECT_EQ(7, table.lambda([](auto& t) { t.set(7); return t.get(); }).get());
+   EXPECT_EQ(7, table.lambda([](const auto& t) { return t.get(); }).get());
+}
+
+TEST(TestOfConcurrentRW, Empty) {
+   concurrent_rw<Table> table{std::unique_ptr<Table>{nullptr}};
+   EXPECT_TRUE(table.empty());
+   EXPECT_ANY_THROW(table.call(&Table::get).get());
+   EXPECT_ANY_THROW(table.lambda([](const Table& t) { return t.get(); }).get());
+   EXPECT_ANY_THROW(table.fire(&Table::set, 1));
+}
+
+TEST(TestOfConcurrentRW, ReadsAreExecutedInParallel) {
+   concurrent_rw<Table> table{std::make_unique<Table>(), 2};
+   EXPECT_EQ(2U, table.readers());
+   std::atomic<int> inside{0};
+   auto read = [&inside](const Table&) { return rendezvous(inside, 2); };
+   auto first = table.lambda(read);
+   auto second = table.lambda(read);
+   EXPECT_TRUE(first.get());
+   EXPECT_TRUE(second.get());
+}
+
+TEST(TestOfConcurrentRW, WriteWaitsForEarlierReadsAndBlocksLaterReads) {
+   concurrent_rw<Table> table;
+   auto before = table.lambda([](const Table& t) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(100));
+      return t.get();
+   });
+   table.lambda([](Table& t) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(100));
+      t.set(42);
+   });
+   auto after1 = table.call(&Table::get);
+   auto after2 = table.lambda([](const Table& t) { return t.get(); });
+
+   EXPECT_EQ(0, before.get());
+   EXPECT_EQ(42, after1.get());
+   EXPECT_EQ(42, after2.get());
+}
+
+TEST(TestOfConcurrentRW, ReadsSeeWritesInSubmissionOrder) {
+   concurrent_rw<Table> table{std::make_unique<Table>(), 4};
+   std::vector<std::future<int>> reads;
+   for (int index = 1; index <= 1000; ++index) {
+      table.fire(&Table::add, 1);
+      reads.push_back(table.call(&Table::get));
+   }
+   for (size_t index = 0; index < reads.size(); ++index) {
+      EXPECT_EQ(static_cast<int>(index + 1), reads[index].get());
+   }
+}
+
+TEST(TestOfConcurrentRW, VerifyDestruction) {
+   std::atomic<bool> flag{true};
+   {
+      concurrent_rw<TrueAtExit> notifyAtExit{&flag};
+      EXPECT_FALSE(flag);
+      notifyAtExit.lambda([](const TrueAtExit&) {
+         std::this_thread::sleep_for(std::chrono::milliseconds(50));
+      });
+   }
+   EXPECT_TRUE(flag);
+}
@@ -0,0 +1,167 @@
+#include "fair_queue.hpp"
+
+#include <gtest/gtest.h>
+#include <chrono>
+#include <functional>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include "concurrent.hpp"
+#include "test_helper.hpp"
+using namespace test_helper;
+
+TEST(TestOfFairQueue, CompilerCheckForNoCopyConstructibleAndAssignable) {
+   static_assert(std::is_copy_constructible<fair_queue<int>>::value == false,
+      "Fair queue can't be copied by constructor");
+   static_assert(std::is_copy_assignable<fair_queue<int>>::value == false,
+      "Fair queue can't be copied by assignment operator");
+}
+
+TEST(TestOfFairQueue, FifoForOneProducer) {
+   fair_queue<int> queue;
+   EXPECT_TRUE(queue.empty());
+   for (int value = 0; value < 10; ++value) {
+      queue.push(value);
+   }
+   EXPECT_EQ(10U, queue.size());
+   EXPECT_EQ(1U, queue.producers());
+
+   int value{-1};
+   for (int expected = 0; expected < 10; ++expected) {
+      ASSERT_TRUE(queue.try_and_pop(value));
+      EXPECT_EQ(expected, value);
+   }
+   EXPECT_FALSE(queue.try_and_pop(value));
+   EXPECT_TRUE(queue.empty());
+   EXPECT_EQ(0U, queue.producers());
+}
+
+TEST(TestOfFairQueue, RoundRobinBetweenTags) {
+   fair_queue<std::string> queue;
+   queue.push(1, "a1");
+   queue.push(1, "a2");
+   queue.push(1, "a3");
+   queue.push(2, "b1");
+   queue.push(3, "c1");
+   queue.push(2, "b2");
+
+   std::string order;
+   std::string item;
+   while (queue.try_and_pop(item)) {
+      order += item + " ";
+   }
+   EXPECT_EQ("a1 b1 c1 a2 b2 a3 ", order);
+}
+
+TEST(TestOfFairQueue, WeightIsItemsPerRound) {
+   fair_queue<std::string> queue;
+   queue.set_weight(1, 2);
+   for (auto item : {"a1", "a2", "a3", "a4"}) {
+      queue.push(1, item);
+   }
+   queue.push(2, "b1");
+   queue.push(2, "b2");
+
+   std::string order;
+   std::string item;
+   while (queue.try_and_pop(item)) {
+      order += item + " ";
+   }
+   EXPECT_EQ("a1 a2 b1 a3 a4 b2 ", order);
+}
+
+TEST(TestOfFairQueue, TagsAndProducersAreSeparateSubQueues) {
+   fair_queue<std::string> queue;
+   const size_t same_as_thread = std::hash<std::thread::id>()(std::this_thread::get_id());
+   queue.push("p1");
+   queue.push("p2");
+   queue.push(same_as_thread, "t1");
+   EXPECT_EQ(2U, queue.producers());
+
+   std::string order;
+   std::string item;
+   while (queue.try_and_pop(item)) {
+      order += item + " ";
+   }
+   EXPECT_EQ("p1 t1 p2 ", order);
+}
+
+TEST(TestOfFairQueue, ResetWeightForgetsIt) {
+   fair_queue<std::string> queue;
+   queue.set_weight(1, 2);
+   queue.set_weight(3);
+   EXPECT_EQ(2U, queue.weights());
+   queue.reset_weight();
+   queue.reset_weight(1);
+   EXPECT_EQ(0U, queue.weights());
+
+   for (auto item : {"a1", "a2"}) {
+      queue.push(1, item);
+   }
+   queue.push(2, "b1");
+   std::string order;
+   std::string item;
+   while (queue.try_and_pop(item)) {
+      order += item + " ";
+   }
+   EXPECT_EQ("a1 b1 a2 ", order);
+}
+
+TEST(TestOfFairQueue, WaitAndPopWaitsForValue) {
+   fair_queue<int> queue;
+   std::thread producer{[&]() {
+      std::this_thread::sleep_for(std::chrono::milliseconds(100));
+      queue.push(12);
+   }};
+   int consumed{0};
+   queue.wait_and_pop(consumed);
+   producer.join();
+   EXPECT_EQ(12, consumed);
+}
+
+namespace {
+   struct Log {
+      std::vector<std::string> entries;
+      void add(std::string entry) { entries.push_back(entry); }
+      void slow() { std::this_thread::sleep_for(std::chrono::milliseconds(2)); }
+      size_t count() { return entries.size(); }
+   };
+} // namespace
+
+TEST(TestOfFairQueue, QuietProducerOvertakesNoisyBacklog) {
+   concurrent<Log, fair_queue<concurrent_helper::Callback>> log;
+   for (int call = 0; call < 200; ++call) {
+      log.fire(&Log::slow); // ~400ms backlog from this thread
+   }
+
+   auto start = clock::now();
+   std::thread quiet{[&log] { log.call(&Log::add, std::string{"quiet"}).wait(); }};
+   quiet.join();
+   auto waited = std::chrono::duration_cast<std::chrono::milliseconds>(clock::now() - start).count();
+   EXPECT_LT(waited, 200) << "quiet producer waited for the noisy backlog";
+}
+
+TEST(TestOfFairQueue, ConcurrentDrainsAllProducersAtShutdown) {
+   struct Collect {
+      std::vector<std::string>& entries;
+      explicit Collect(std::vector<std::string>& e) : entries(e) {}
+      void add(std::string entry) { entries.push_back(entry); }
+   };
+
+   std::vector<std::string> entries;
+   {
+      concurrent<Collect, fair_queue<concurrent_helper::Callback>> collect{entries};
+      std::thread other{[&collect] {
+         for (int call = 0; call < 100; ++call) {
+            collect.fire(&Collect::add, std::string{"other"});
+         }
+      }};
+      other.join();
+      for (int call = 0; call < 100; ++call) {
+         collect.fire(&Collect::add, std::string{"self"});
+      }
+   } // the shutdown message is fair queued, the other producer's calls are drained after it
+   EXPECT_EQ(200U, entries.size());
+}
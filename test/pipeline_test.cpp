@@ -0,0 +1,131 @@
+#include "pipeline.hpp"
+
+#include <gtest/gtest.h>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "test_helper.hpp"
+using namespace test_helper;
+
+namespace {
+   int parse(std::string text) {
+      return std::stoi(text);
+   }
+} // anonymous
+
+
+TEST(TestOfPipeline, StagesRunInOrderAndItemsStayFifo) {
+   std::vector<std::string> written;
+   {
+      auto p = make_pipeline<std::string>(
+                  parse,                                                 // plain function
+                  [](int value) { return value * 2; },                   // plain lambda
+                  stage([](int value) { return std::to_string(value); }),
+                  stage([&](std::string text) { written.push_back(std::move(text)); }));
+      EXPECT_EQ(4U, p.stages());
+      for (int value = 0; value < 100; ++value) {
+         p.push(std::to_string(value));
+      }
+   } // destructor drains all stages
+   ASSERT_EQ(100U, written.size());
+   for (int value = 0; value < 100; ++value) {
+      EXPECT_EQ(std::to_string(value * 2), written[value]);
+   }
+}
+
+TEST(TestOfPipeline, OutputsAreMovedNotCopied) {
+   std::vector<std::unique_ptr<int>> received;
+   {
+      auto p = make_pipeline<std::unique_ptr<int>>(
+                  [](std::unique_ptr<int> value) { ++*value; return value; },
+                  [&](std::unique_ptr<int> value) { received.push_back(std::move(value)); });
+      p.push(std::unique_ptr<int>(new int(41)));
+   }
+   ASSERT_EQ(1U, received.size());
+   EXPECT_EQ(42, *received[0]);
+}
+
+TEST(TestOfPipeline, BackpressureBlocksThePush) {
+   std::mutex gate;
+   std::unique_lock<std::mutex> closed_gate(gate);
+   std::atomic<size_t> pushed{0};
+   auto p = make_pipeline<int>(
+               stage([&](int value) { std::lock_guard<std::mutex> lock(gate); return value; }).capacity(4),
+               stage([](int) {}).capacity(4));
+
+   std::thread producer([&] {
+      for (int value = 0; value < 20; ++value) {
+         p.push(value);
+         ++pushed;
+      }
+   });
+   std::this_thread::sleep_for(std::chrono::milliseconds(50));
+   // one item is held by the blocked stage, four wait in its queue
+   EXPECT_EQ(5U, pushed.load());
+   EXPECT_EQ(4U, p.stats()[0].queue_depth);
+   EXPECT_DOUBLE_EQ(1.0, p.stats()[0].occupancy());
+
+   closed_gate.unlock();
+   producer.join();
+   p.close();
+   EXPECT_EQ(20U, p.stats()[0].processed);
+   EXPECT_EQ(20U, p.stats()[1].processed);
+   EXPECT_EQ(4U, p.stats()[0].queue_high_water);
+}
+
+TEST(TestOfPipeline, ReplicasAndBatches) {
+   std::mutex m;
+   std::set<std::thread::id> threads;
+   std::multiset<int> received;
+   {
+      auto p = make_pipeline<int>(
+                  stage([&](int value) {
+                     {
+                        std::lock_guard<std::mutex> lock(m);
+                        threads.insert(std::this_thread::get_id());
+                     }
+                     std::this_thread::sleep_for(std::chrono::microseconds(100));
+                     return value;
+                  }).replicas(4),
+                  stage([&](int value) { received.insert(value); }).batch(16));
+      for (int value = 0; value < 400; ++value) {
+         p.push(value);
+      }
+      p.close();
+      auto stats = p.stats();
+      EXPECT_EQ(4U, stats[0].replicas);
+      EXPECT_EQ(400U, stats[1].processed);
+      EXPECT_GT(stats[1].items_per_second, 0.0);
+   }
+   EXPECT_EQ(400U, received.size());
+   EXPECT_EQ(1U, received.count(0));
+   EXPECT_EQ(1U, received.count(399));
+   EXPECT_LT(1U, threads.size());
+}
+
+TEST(TestOfPipeline, ThrowingStageDropsTheItem) {
+   std::vector<int> received;
+   auto p = make_pipeline<int>(
+               [](int value) {
+                  if (value % 2) {
+                     throw std::runtime_error("odd");
+                  }
+                  return value;
+               },
+               [&](int value) { received.push_back(value); });
+   for (int value = 0; value < 10; ++value) {
+      p.push(value);
+   }
+   p.close();
+   EXPECT_EQ((std::vector<int>{0, 2, 4, 6, 8}), received);
+   EXPECT_EQ(10U, p.stats()[0].processed);
+   EXPECT_EQ(5U, p.stats()[0].failed);
+   EXPECT_THROW(p.push(10), std::runtime_error);
+}
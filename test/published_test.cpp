@@ -0,0 +1,111 @@
+#include "published.hpp"
+
+#include <gtest/gtest.h>
+#include <atomic>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "concurrent.hpp"
+
+namespace {
+   struct Version {
+      std::atomic<size_t>* destroyed;
+      size_t number;
+      size_t check; // always equal to number while alive
+
+      Version(std::atomic<size_t>* d, size_t n) : destroyed(d), number(n), check(n) {}
+      ~Version() {
+         check = 0;
+         ++(*destroyed);
+      }
+   };
+
+   struct Router {
+      std::vector<std::string> routes;
+   };
+} // namespace
+
+
+TEST(TestOfPublished, NothingPublishedGivesNullptr) {
+   published<std::string> snapshots;
+   EXPECT_EQ(nullptr, snapshots.snapshot());
+   EXPECT_EQ(0U, snapshots.retired());
+}
+
+TEST(TestOfPublished, PublishFromWorkerAndReadWithoutTheQueue) {
+   published<std::vector<std::string>> table;
+   concurrent<Router> router;
+   router.lambda([&table](Router& r) {
+      r.routes.push_back("/index");
+      r.routes.push_back("/login");
+      table.publish(std::make_shared<const std::vector<std::string>>(r.routes));
+   }).wait();
+
+   auto snapshot = table.snapshot();
+   ASSERT_NE(nullptr, snapshot);
+   EXPECT_EQ(2U, snapshot->size());
+   EXPECT_EQ("/login", snapshot->back());
+}
+
+TEST(TestOfPublished, SnapshotKeepsItsVersionAliveAfterRepublish) {
+   std::atomic<size_t> destroyed{0};
+   published<Version> versions{std::make_shared<const Version>(&destroyed, 1)};
+   auto first = versions.snapshot();
+
+   versions.publish(std::make_shared<const Version>(&destroyed, 2));
+   EXPECT_EQ(0U, destroyed);
+   EXPECT_EQ(1U, first->number);
+   EXPECT_EQ(2U, versions.snapshot()->number);
+
+   first.reset();
+   EXPECT_EQ(1U, destroyed);
+}
+
+TEST(TestOfPublished, ReplacedVersionsAreReclaimedWithoutReaders) {
+   std::atomic<size_t> destroyed{0};
+   {
+      published<Version> versions;
+      for (size_t number = 1; number <= 100; ++number) {
+         versions.publish(std::make_shared<const Version>(&destroyed, number));
+      }
+      EXPECT_EQ(0U, versions.retired());
+      EXPECT_EQ(99U, destroyed);
+   }
+   EXPECT_EQ(100U, destroyed);
+}
+
+TEST(TestOfPublished, ManyReadersWhilePublishing) {
+   std::atomic<size_t> destroyed{0};
+   published<Version> versions{std::make_shared<const Version>(&destroyed, 1)};
+   std::atomic<bool> stop{false};
+   std::atomic<size_t> failures{0};
+
+   std::vector<std::thread> readers;
+   for (int index = 0; index < 4; ++index) {
+      readers.emplace_back([&] {
+         size_t last = 0;
+         while (!stop) {
+            auto snapshot = versions.snapshot();
+            if (snapshot->check != snapshot->number || snapshot->number < last) {
+               ++failures;
+            }
+            last = snapshot->number;
+         }
+      });
+   }
+
+   for (size_t number = 2; number <= 20000; ++number) {
+      versions.publish(std::make_shared<const Version>(&destroyed, number));
+   }
+   stop = true;
+   for (auto& reader : readers) {
+      reader.join();
+   }
+
+   EXPECT_EQ(0U, failures);
+   EXPECT_EQ(0U, versions.retired());
+   EXPECT_EQ(20000U, versions.snapshot()->number);
+   EXPECT_EQ(19999U, destroyed);
+}
@@ -0,0 +1,133 @@
+#include "queue_select.hpp"
+
+#include <gtest/gtest.h>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "shared_queue.hpp"
+
+using namespace std::chrono_literals;
+
+TEST(TestOfQueueSelector, ReportsTheQueuesWithItems) {
+   shared_queue<int> numbers;
+   shared_queue<std::string> words;
+   queue_selector select;
+   const size_t number_index = select.add(numbers);
+   const size_t word_index = select.add(words);
+   EXPECT_EQ(2U, select.size());
+
+   std::vector<size_t> ready;
+   EXPECT_FALSE(select.wait_for(ready, 0ms));
+   EXPECT_TRUE(ready.empty());
+
+   words.push("hello");
+   ASSERT_TRUE(select.wait_for(ready, 0ms));
+   EXPECT_EQ(std::vector<size_t>{word_index}, ready);
+
+   numbers.push(1);
+   select.wait(ready); // level triggered, the word is still queued
+   EXPECT_EQ((std::vector<size_t>{number_index, word_index}), ready);
+}
+
+TEST(TestOfQueueSelector, WaitForWithoutALimit) {
+   shared_queue<int> numbers;
+   queue_selector select;
+   select.add(numbers);
+   std::thread producer{[&numbers] {
+      std::this_thread::sleep_for(20ms);
+      numbers.push(1);
+   }};
+   std::vector<size_t> ready;
+   EXPECT_TRUE(select.wait_for(ready, std::chrono::nanoseconds::max()));
+   EXPECT_TRUE(select.wait_for(ready, std::chrono::hours::max()));
+   EXPECT_EQ(std::vector<size_t>{0}, ready);
+   producer.join();
+}
+
+TEST(TestOfQueueSelector, WakesOnPushToAnyQueue) {
+   shared_queue<int> first;
+   shared_queue<int> second;
+   queue_selector select;
+   select.add(first);
+   const size_t second_index = select.add(second);
+
+   std::thread producer{[&second] {
+      std::this_thread::sleep_for(20ms);
+      second.push(42);
+   }};
+   std::vector<size_t> ready;
+   const auto start = std::chrono::steady_clock::now();
+   ASSERT_TRUE(select.wait_for(ready, 10s));
+   EXPECT_GT(5s, std::chrono::steady_clock::now() - start);
+   EXPECT_EQ(std::vector<size_t>{second_index}, ready);
+
+   int value = 0;
+   EXPECT_TRUE(second.try_and_pop(value));
+   EXPECT_EQ(42, value);
+   producer.join();
+}
+
+TEST(TestOfQueueSelector, TimesOutWithoutItems) {
+   shared_queue<int> queue;
+   queue_selector select;
+   select.add(queue);
+
+   std::vector<size_t> ready{7};
+   const auto start = std::chrono::steady_clock::now();
+   EXPECT_FALSE(select.wait_until(ready, start + 20ms));
+   EXPECT_LE(20ms, std::chrono::steady_clock::now() - start);
+   EXPECT_TRUE(ready.empty());
+}
+
+TEST(TestOfQueueSelector, OneConsumerDrainsManyProducers) {
+   const int kQueues = 4;
+   const int kItems = 1000;
+   std::vector<std::unique_ptr<shared_queue<int>>> queues;
+   queue_selector select;
+   for (int index = 0; index < kQueues; ++index) {
+      queues.emplace_back(new shared_queue<int>());
+      select.add(*queues.back());
+   }
+   std::vector<std::thread> producers;
+   for (int index = 0; index < kQueues; ++index) {
+      producers.emplace_back([&queues, index] {
+         for (int item = 0; item < kItems; ++item) {
+            queues[index]->push(item);
+         }
+      });
+   }
+
+   std::vector<int> expected(kQueues, 0);
+   std::vector<size_t> ready;
+   std::vector<int> items;
+   int received = 0;
+   while (received < kQueues * kItems) {
+      ASSERT_TRUE(select.wait_for(ready, 10s));
+      for (size_t index : ready) {
+         items.clear();
+         queues[index]->try_pop_n(items, 64);
+         for (int item : items) {
+            ASSERT_EQ(expected[index]++, item);
+            ++received;
+         }
+      }
+   }
+   for (auto& producer : producers) {
+      producer.join();
+   }
+}
+
+TEST(TestOfQueueSelector, LeavesTheQueuesWhenDestroyed) {
+   shared_queue<int> queue;
+   {
+      queue_selector select;
+      select.add(queue);
+   }
+   queue.push(1); // nobody to wake
+   int value = 0;
+   EXPECT_TRUE(queue.try_and_pop(value));
+   EXPECT_EQ(1, value);
+}
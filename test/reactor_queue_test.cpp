@@ -0,0 +1,152 @@
+#include "reactor_queue.hpp"
+
+#if defined(__linux__)
+
+#include <gtest/gtest.h>
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <string>
+#include <thread>
+#include <vector>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "concurrent.hpp"
+#include "test_helper.hpp"
+using namespace test_helper;
+
+namespace {
+   typedef reactor_queue<concurrent_helper::Callback> Reactor;
+
+   struct Endpoint {
+      std::string received;
+      std::thread::id reader;
+      std::vector<int> calls;
+      size_t calls_before_read = 0;
+      int ticks = 0;
+
+      void on_readable(int fd) {
+         char buffer[64];
+         ssize_t bytes = ::read(fd, buffer, sizeof(buffer));
+         if (bytes > 0) {
+            received.append(buffer, static_cast<size_t>(bytes));
+            reader = std::this_thread::get_id();
+            calls_before_read = calls.size();
+         }
+      }
+      void call(int sequence) { calls.push_back(sequence); }
+      void wait(std::shared_future<void> gate) { gate.wait(); }
+      std::thread::id worker() { return std::this_thread::get_id(); }
+   };
+
+   struct Pipe {
+      int fds[2];
+      Pipe() { EXPECT_EQ(0, pipe(fds)); }
+      ~Pipe() { ::close(fds[0]); ::close(fds[1]); }
+      void write(const std::string& text) { EXPECT_EQ(static_cast<ssize_t>(text.size()), ::write(fds[1], text.data(), text.size())); }
+   };
+
+   template<typename Done>
+   bool eventually(Done done) {
+      for (int attempt = 0; attempt < 1000 && !done(); ++attempt) {
+         std::this_thread::sleep_for(std::chrono::milliseconds(1));
+      }
+      return done();
+   }
+} // anonymous
+
+
+TEST(TestOfReactorQueue, ReadableDescriptorOnTheWorkerThread) {
+   concurrent<Endpoint, Reactor> endpoint;
+   Pipe pipe;
+   endpoint.watch(pipe.fds[0]);
+   pipe.write("hello");
+   EXPECT_TRUE(eventually([&] { return "hello" == endpoint.lambda([](Endpoint& e) { return e.received; }).get(); }));
+   EXPECT_EQ(endpoint.call(&Endpoint::worker).get(), endpoint.lambda([](Endpoint& e) { return e.reader; }).get());
+
+   endpoint.unwatch(pipe.fds[0]);
+   pipe.write("ignored");
+   std::this_thread::sleep_for(std::chrono::milliseconds(20));
+   EXPECT_EQ("hello", endpoint.lambda([](Endpoint& e) { return e.received; }).get());
+}
+
+TEST(TestOfReactorQueue, QueuedCallsStayFifoWhileSocketsAreServed) {
+   concurrent<Endpoint, Reactor> endpoint;
+   int sockets[2];
+   ASSERT_EQ(0, socketpair(AF_UNIX, SOCK_STREAM, 0, sockets));
+   endpoint.watch(sockets[0]);
+   std::thread writer([&] {
+      for (int message = 0; message < 100; ++message) {
+         ASSERT_EQ(1, ::write(sockets[1], "x", 1));
+         std::this_thread::sleep_for(std::chrono::microseconds(50));
+      }
+   });
+   const int kCalls = 10000;
+   for (int sequence = 0; sequence < kCalls; ++sequence) {
+      endpoint.fire(&Endpoint::call, sequence);
+   }
+   writer.join();
+   auto calls = endpoint.lambda([](Endpoint& e) { return e.calls; }).get();
+   ASSERT_EQ(static_cast<size_t>(kCalls), calls.size());
+   for (int sequence = 0; sequence < kCalls; ++sequence) {
+      ASSERT_EQ(sequence, calls[sequence]);
+   }
+   EXPECT_TRUE(eventually([&] { return 100U == endpoint.lambda([](Endpoint& e) { return e.received.size(); }).get(); }));
+   ::close(sockets[0]);
+   ::close(sockets[1]);
+}
+
+TEST(TestOfReactorQueue, BusyQueueDoesNotStarveDescriptors) {
+   concurrent<Endpoint, Reactor> endpoint;
+   Pipe pipe;
+   endpoint.watch(pipe.fds[0]);
+   std::promise<void> open;
+   endpoint.fire(&Endpoint::wait, open.get_future().share());
+   const int kCalls = 1000;
+   for (int sequence = 0; sequence < kCalls; ++sequence) {
+      endpoint.fire(&Endpoint::call, sequence);
+   }
+   pipe.write("urgent");
+   open.set_value();
+   EXPECT_TRUE(eventually([&] { return "urgent" == endpoint.lambda([](Endpoint& e) { return e.received; }).get(); }));
+   auto before = endpoint.lambda([](Endpoint& e) { return e.calls_before_read; }).get();
+   EXPECT_LT(before, static_cast<size_t>(kCalls)); // served while the calls were still queued
+   EXPECT_LE(before, Reactor::kPollEvery);
+}
+
+TEST(TestOfReactorQueue, Timers) {
+   concurrent<Endpoint, Reactor> endpoint;
+   int timer = endpoint.add_timer(std::chrono::milliseconds(5), [](Endpoint& e) { ++e.ticks; });
+   EXPECT_TRUE(eventually([&] { return endpoint.lambda([](Endpoint& e) { return e.ticks; }).get() >= 3; }));
+   endpoint.unwatch(timer);
+   int ticks = endpoint.lambda([](Endpoint& e) { return e.ticks; }).get();
+   std::this_thread::sleep_for(std::chrono::milliseconds(30));
+   EXPECT_EQ(ticks, endpoint.lambda([](Endpoint& e) { return e.ticks; }).get());
+}
+
+TEST(TestOfReactorQueue, UnwatchAFastTimerWhileItFires) {
+   concurrent<Endpoint, Reactor> endpoint;
+   const int kRounds = 50;
+   for (int round = 0; round < kRounds; ++round) {
+      const int ticks = endpoint.lambda([](Endpoint& e) { return e.ticks; }).get();
+      int timer = endpoint.add_timer(std::chrono::milliseconds(1), [](Endpoint& e) {
+         std::this_thread::sleep_for(std::chrono::microseconds(500)); // mostly inside the handler
+         ++e.ticks;
+      });
+      ASSERT_TRUE(eventually([&] { return endpoint.lambda([](Endpoint& e) { return e.ticks; }).get() > ticks; }));
+      endpoint.unwatch(timer);
+
+      // a new descriptor may get the number of the timer, the timer handler must not read it
+      Pipe pipe;
+      endpoint.watch(pipe.fds[0]);
+      pipe.write("x");
+      ASSERT_TRUE(eventually([&] { return static_cast<size_t>(round + 1) == endpoint.lambda([](Endpoint& e) { return e.received.size(); }).get(); }));
+      endpoint.unwatch(pipe.fds[0]);
+   }
+   const int ticks = endpoint.lambda([](Endpoint& e) { return e.ticks; }).get();
+   std::this_thread::sleep_for(std::chrono::milliseconds(20));
+   EXPECT_EQ(ticks, endpoint.lambda([](Endpoint& e) { return e.ticks; }).get());
+}
+
+#endif // __linux__
@@ -0,0 +1,190 @@
+#include "segmented_queue.hpp"
+
+#include <gtest/gtest.h>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <thread>
+
+#include "concurrent.hpp"
+#include "shared_queue.hpp"
+
+namespace {
+   struct Counts {
+      size_t allocations = 0;
+      size_t deallocations = 0;
+   };
+
+   /** allocator that counts what the segments cost */
+   template<typename T>
+   struct CountingAllocator {
+      typedef T value_type;
+      Counts* counts;
+
+      explicit CountingAllocator(Counts* c) : counts(c) {}
+      template<typename U>
+      CountingAllocator(const CountingAllocator<U>& other) : counts(other.counts) {}
+
+      T* allocate(size_t n) {
+         ++counts->allocations;
+         return std::allocator<T>().allocate(n);
+      }
+      void deallocate(T* p, size_t n) {
+         ++counts->deallocations;
+         std::allocator<T>().deallocate(p, n);
+      }
+      template<typename U>
+      bool operator==(const CountingAllocator<U>& other) const { return counts == other.counts; }
+      template<typename U>
+      bool operator!=(const CountingAllocator<U>& other) const { return counts != other.counts; }
+   };
+
+   typedef segmented_queue<int, 4, CountingAllocator<int>> SmallCountedQueue;
+} // namespace
+
+
+TEST(TestOfSegmentedQueue, FifoAcrossSegments) {
+   segmented_queue<std::string, 4> queue;
+   EXPECT_TRUE(queue.empty());
+   for (int value = 0; value < 100; ++value) {
+      queue.push(std::to_string(value));
+   }
+   EXPECT_EQ(100U, queue.size());
+   EXPECT_EQ(25U, queue.allocated_segments());
+
+   for (int value = 0; value < 100; ++value) {
+      ASSERT_EQ(std::to_string(value), queue.front());
+      queue.pop();
+   }
+   EXPECT_TRUE(queue.empty());
+}
+
+TEST(TestOfSegmentedQueue, SegmentsAreCacheLineAligned) {
+   segmented_queue<int, 4> queue;
+   for (int value = 0; value < 16; value += 4) {
+      queue.push(value);
+      EXPECT_EQ(0U, reinterpret_cast<std::uintptr_t>(&queue.front()) % 64);
+      queue.push(value + 1);
+      queue.push(value + 2);
+      queue.push(value + 3);
+      for (int pop = 0; pop < 4; ++pop) {
+         queue.pop();
+      }
+   }
+}
+
+TEST(TestOfSegmentedQueue, SteadyStateHasNoAllocations) {
+   Counts counts;
+   {
+      SmallCountedQueue queue{64, CountingAllocator<int>{&counts}};
+      auto swing = [&queue] {
+         for (int value = 0; value < 200; ++value) {
+            queue.push(value);
+         }
+         while (!queue.empty()) {
+            queue.pop();
+         }
+      };
+      swing();
+      const size_t warm = counts.allocations;
+      EXPECT_EQ(50U, warm);
+      for (int round = 0; round < 10; ++round) {
+         swing();
+      }
+      EXPECT_EQ(warm, counts.allocations);
+      EXPECT_EQ(0U, counts.deallocations);
+   }
+   EXPECT_EQ(counts.allocations, counts.deallocations);
+}
+
+TEST(TestOfSegmentedQueue, RetainedMemoryIsCappedAndCanBeReleased) {
+   Counts counts;
+   SmallCountedQueue queue{8, CountingAllocator<int>{&counts}};
+   for (int value = 0; value < 400; ++value) {
+      queue.push(value);
+   }
+   while (!queue.empty()) {
+      queue.pop();
+   }
+   EXPECT_EQ(8U, queue.retained_segments());
+   EXPECT_EQ(9U, queue.allocated_segments()); // the head segment plus the retained ones
+
+   queue.set_max_retained(2);
+   EXPECT_EQ(2U, queue.retained_segments());
+   queue.shrink_to_fit();
+   EXPECT_EQ(0U, queue.retained_segments());
+   EXPECT_EQ(1U, queue.allocated_segments());
+}
+
+TEST(TestOfSegmentedQueue, ItemsAreDestroyed) {
+   auto shared = std::make_shared<int>(42);
+   {
+      segmented_queue<std::shared_ptr<int>, 4> queue;
+      for (int copy = 0; copy < 10; ++copy) {
+         queue.push(shared);
+      }
+      queue.pop();
+      EXPECT_EQ(10, shared.use_count());
+   }
+   EXPECT_EQ(1, shared.use_count());
+}
+
+TEST(TestOfSegmentedQueue, AsStorageForSharedQueue) {
+   shared_queue<int, segmented_queue<int, 8>> queue{segmented_queue<int, 8>{4}};
+   std::thread producer{[&queue] {
+      for (int value = 0; value < 10000; ++value) {
+         queue.push(value);
+      }
+   }};
+   int value{-1};
+   for (int expected = 0; expected < 10000; ++expected) {
+      queue.wait_and_pop(value);
+      ASSERT_EQ(expected, value);
+   }
+   producer.join();
+   EXPECT_TRUE(queue.empty());
+   queue.shrink_to_fit();
+}
+
+TEST(TestOfSegmentedQueue, PopIntoRelocatesTheFront) {
+   segmented_queue<std::unique_ptr<int>, 4> queue;
+   for (int value = 0; value < 10; ++value) {
+      queue.push(std::unique_ptr<int>(new int(value)));
+   }
+   std::unique_ptr<int> popped(new int(-1));
+   for (int value = 0; value < 10; ++value) {
+      queue.pop(popped);
+      ASSERT_TRUE(nullptr != popped);
+      EXPECT_EQ(value, *popped);
+   }
+   EXPECT_TRUE(queue.empty());
+
+   shared_queue<std::function<int()>, segmented_queue<std::function<int()>, 4>> tasks;
+   for (int value = 0; value < 10; ++value) {
+      tasks.push([value] { return value; });
+   }
+   std::function<int()> task;
+   for (int value = 0; value < 10; ++value) {
+      ASSERT_TRUE(tasks.try_and_pop(task));
+      EXPECT_EQ(value, task());
+   }
+}
+
+TEST(TestOfSegmentedQueue, AsStorageForConcurrent) {
+   typedef concurrent_helper::Callback Callback;
+   concurrent<std::string, shared_queue<Callback, segmented_queue<Callback>>> text{"Hello"};
+   text.lambda([](std::string& s) { s.append(" World"); });
+   EXPECT_EQ("Hello World", text.lambda([](std::string& s) { return s; }).get());
+}
+
+#if defined(__cplusplus) && (__cplusplus >= 201703L)
+TEST(TestOfSegmentedQueue, PolymorphicMemoryResource) {
+   std::pmr::monotonic_buffer_resource resource;
+   pmr::segmented_queue<int, 16> queue{4, &resource};
+   for (int value = 0; value < 100; ++value) {
+      queue.push(value);
+   }
+   EXPECT_EQ(0, queue.front());
+}
+#endif
@@ -0,0 +1,156 @@
+#include "shared_call_table.hpp"
+
+#include <gtest/gtest.h>
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "concurrent.hpp"
+#include "test_helper.hpp"
+using namespace test_helper;
+
+namespace {
+   struct Catalog {
+      int lookups = 0;
+      int price = 100;
+      int lookup(std::string sku) {
+         ++lookups;
+         if (sku == "missing") {
+            throw std::runtime_error("no such sku");
+         }
+         return price;
+      }
+      void update(int new_price) { price = new_price; }
+      void wait(std::shared_future<void> gate) { gate.wait(); }
+   };
+
+   int lookups(concurrent<Catalog>& catalog) {
+      return catalog.lambda([](Catalog& c) { return c.lookups; }).get();
+   }
+} // anonymous
+
+
+TEST(TestOfSharedCalls, PendingCallsAreCollapsed) {
+   concurrent<Catalog> catalog;
+   std::promise<void> open;
+   catalog.fire(&Catalog::wait, open.get_future().share());
+
+   std::vector<std::shared_future<int>> prices;
+   for (int i = 0; i < 100; ++i) {
+      prices.push_back(catalog.call_shared("sku-1", &Catalog::lookup, "sku-1"));
+   }
+   auto other = catalog.call_shared("sku-2", &Catalog::lookup, "sku-2");
+   open.set_value();
+   for (auto& price : prices) {
+      EXPECT_EQ(100, price.get());
+   }
+   EXPECT_EQ(100, other.get());
+   EXPECT_EQ(2, lookups(catalog));
+
+   auto stats = catalog.shared_calls();
+   EXPECT_EQ(2U, stats.executed);
+   EXPECT_EQ(99U, stats.collapsed);
+   EXPECT_EQ(0U, stats.cached);
+
+   catalog.call_shared("sku-1", &Catalog::lookup, "sku-1").get(); // not pending, no cache: runs again
+   EXPECT_EQ(3, lookups(catalog));
+}
+
+TEST(TestOfSharedCalls, ManyThreads) {
+   concurrent<Catalog> catalog;
+   std::promise<void> open;
+   catalog.fire(&Catalog::wait, open.get_future().share());
+   std::vector<std::thread> callers;
+   std::atomic<int> sum{0};
+   for (int caller = 0; caller < 8; ++caller) {
+      callers.emplace_back([&] {
+         sum += catalog.call_shared(std::string("sku"), &Catalog::lookup, "sku").get();
+      });
+   }
+   while (catalog.shared_calls().executed + catalog.shared_calls().collapsed < 8) {
+      std::this_thread::yield();
+   }
+   open.set_value();
+   for (auto& caller : callers) {
+      caller.join();
+   }
+   EXPECT_EQ(800, sum.load());
+   EXPECT_EQ(1, lookups(catalog));
+}
+
+TEST(TestOfSharedCalls, CachedResultsAndInvalidationFromTheWorker) {
+   concurrent<Catalog> catalog;
+   catalog.cache_shared_calls(16);
+   EXPECT_EQ(100, catalog.call_shared(7, &Catalog::lookup, "sku-7").get());
+   EXPECT_EQ(100, catalog.call_shared(7, &Catalog::lookup, "sku-7").get());
+   EXPECT_EQ(1, lookups(catalog));
+   EXPECT_EQ(1U, catalog.shared_calls().cache_hits);
+
+   catalog.lambda([&catalog](Catalog& c) {
+      c.update(200);
+      catalog.invalidate(7);
+   }).wait();
+   EXPECT_EQ(200, catalog.call_shared(7, &Catalog::lookup, "sku-7").get());
+   EXPECT_EQ(2, lookups(catalog));
+
+   catalog.invalidate_all();
+   EXPECT_EQ(0U, catalog.shared_calls().cached);
+}
+
+TEST(TestOfSharedCalls, InvalidateDetachesThePendingCall) {
+   concurrent<Catalog> catalog;
+   catalog.cache_shared_calls(16);
+   std::promise<void> open;
+   catalog.fire(&Catalog::wait, open.get_future().share());
+
+   auto before = catalog.call_shared(7, &Catalog::lookup, "sku-7");
+   catalog.fire(&Catalog::update, 200);
+   catalog.invalidate(7); // read-your-writes: do not join the lookup queued before the update
+   auto after = catalog.call_shared(7, &Catalog::lookup, "sku-7");
+   open.set_value();
+
+   EXPECT_EQ(100, before.get());
+   EXPECT_EQ(200, after.get());
+   EXPECT_EQ(2, lookups(catalog));
+   EXPECT_EQ(200, catalog.call_shared(7, &Catalog::lookup, "sku-7").get()); // the detached 100 was not cached
+   EXPECT_EQ(2, lookups(catalog));
+}
+
+TEST(TestOfSharedCalls, LeastRecentlyUsedIsEvictedAndResultsExpire) {
+   concurrent<Catalog> catalog;
+   catalog.cache_shared_calls(2, std::chrono::milliseconds(50));
+   catalog.call_shared(1, &Catalog::lookup, "1").get();
+   catalog.call_shared(2, &Catalog::lookup, "2").get();
+   catalog.call_shared(1, &Catalog::lookup, "1").get(); // 1 is now the most recent
+   catalog.call_shared(3, &Catalog::lookup, "3").get(); // evicts 2
+   EXPECT_EQ(3, lookups(catalog));
+   catalog.call_shared(1, &Catalog::lookup, "1").get();
+   EXPECT_EQ(3, lookups(catalog));
+   catalog.call_shared(2, &Catalog::lookup, "2").get();
+   EXPECT_EQ(4, lookups(catalog));
+
+   std::this_thread::sleep_for(std::chrono::milliseconds(60));
+   catalog.call_shared(1, &Catalog::lookup, "1").get();
+   EXPECT_EQ(5, lookups(catalog));
+   EXPECT_GE(2U, catalog.shared_calls().cached);
+}
+
+TEST(TestOfSharedCalls, FailuresAreSharedButNotCached) {
+   concurrent<Catalog> catalog;
+   catalog.cache_shared_calls(16);
+   auto failed = catalog.call_shared("missing", &Catalog::lookup, "missing");
+   EXPECT_THROW(failed.get(), std::runtime_error);
+   EXPECT_EQ(1, lookups(catalog)); // the worker is done with the call
+   EXPECT_THROW(catalog.call_shared("missing", &Catalog::lookup, "missing").get(), std::runtime_error);
+   EXPECT_EQ(2, lookups(catalog));
+   EXPECT_EQ(0U, catalog.shared_calls().cached);
+}
+
+TEST(TestOfSharedCalls, NullWorker) {
+   concurrent<Catalog> catalog{std::unique_ptr<Catalog>()};
+   EXPECT_THROW(catalog.call_shared(1, &Catalog::lookup, "1").get(), std::runtime_error);
+}
@@ -5,6 +5,7 @@
 #include <chrono>
 #include <thread>
 #include <type_traits>
+#include <vector>
 
 TEST(TestOfSharedQueue, CompilerCheckForNoCopyConstructibleAndAssignable) {
    static_assert(std::is_copy_constructible<shared_queue<int>>::value == false,
@@ -104,6 +105,71 @@ TEST(TestOfSharedQueue, WaitAndPopWaitsForValue) {
    EXPECT_EQ(0U, queue.size());
 }
 
+TEST(TestOfSharedQueue, WaitAndPopForTimesOut) {
+   using namespace std::chrono_literals;
+   shared_queue<int> queue;
+
+   int value{0};
+   const auto start = std::chrono::steady_clock::now();
+   EXPECT_FALSE(queue.wait_and_pop_for(value, 20ms));
+   EXPECT_LE(20ms, std::chrono::steady_clock::now() - start);
+   EXPECT_EQ(0, value);
+
+   queue.push(12);
+   EXPECT_TRUE(queue.wait_and_pop_for(value, 0ms));
+   EXPECT_EQ(12, value);
+}
+
+TEST(TestOfSharedQueue, WaitAndPopForWithoutALimit) {
+   using namespace std::chrono_literals;
+   shared_queue<int> queue;
+   int value{0};
+   queue.push(1);
+   EXPECT_TRUE(queue.wait_and_pop_for(value, std::chrono::nanoseconds::max()));
+   EXPECT_EQ(1, value);
+
+   std::thread producer{[&queue] {
+      std::this_thread::sleep_for(20ms);
+      queue.push(2);
+   }};
+   EXPECT_TRUE(queue.wait_and_pop_for(value, std::chrono::hours::max())); // overflows the clock if added to now
+   EXPECT_EQ(2, value);
+   producer.join();
+
+   queue.push(3);
+   EXPECT_TRUE(queue.wait_and_pop_for(value, std::chrono::duration<double>::max()));
+   EXPECT_EQ(3, value);
+}
+
+TEST(TestOfSharedQueue, WaitAndPopUntilWaitsForValue) {
+   using namespace std::chrono_literals;
+   shared_queue<int> queue;
+
+   std::thread producer{[&]() {
+      std::this_thread::sleep_for(20ms);
+      queue.push(12);
+   }};
+   int value{0};
+   EXPECT_TRUE(queue.wait_and_pop_until(value, std::chrono::steady_clock::now() + 10s));
+   EXPECT_EQ(12, value);
+   producer.join();
+}
+
+TEST(TestOfSharedQueue, TryPopNTakesAtMostMax) {
+   shared_queue<int> queue;
+   std::vector<int> out;
+   EXPECT_EQ(0U, queue.try_pop_n(out, 10));
+
+   for (int value = 0; value < 5; ++value) {
+      queue.push(value);
+   }
+   EXPECT_EQ(3U, queue.try_pop_n(out, 3));
+   EXPECT_EQ((std::vector<int>{0, 1, 2}), out);
+   EXPECT_EQ(2U, queue.try_pop_n(out, 10)); // appended
+   EXPECT_EQ((std::vector<int>{0, 1, 2, 3, 4}), out);
+   EXPECT_TRUE(queue.empty());
+}
+
 namespace {
 class CopyAndMovable {
 public:
@@ -0,0 +1,157 @@
+#include "shm_queue.hpp"
+
+#if defined(__linux__)
+
+#include <gtest/gtest.h>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <vector>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "test_helper.hpp"
+using namespace test_helper;
+
+namespace {
+   struct Message {
+      uint32_t producer;
+      uint32_t sequence;
+      char text[24];
+   };
+
+   std::string unique_name(const std::string& test) {
+      return "/concurrent_" + test + "_" + std::to_string(getpid());
+   }
+
+   int wait_for_child(pid_t child) {
+      int status = 0;
+      waitpid(child, &status, 0);
+      return WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+   }
+} // anonymous
+
+
+TEST(TestOfShmQueue, CreateOpenAndRemove) {
+   typedef shm_queue<Message, 8> Queue;
+   const std::string name = unique_name("create");
+   {
+      auto owner = Queue::create(name);
+      EXPECT_THROW(Queue::create(name), std::system_error);  // exists
+      EXPECT_THROW((shm_queue<Message, 16>::open(name)), std::runtime_error); // capacity mismatch
+      auto other = Queue::open(name);
+      EXPECT_TRUE(other.empty());
+   } // the owner unlinks
+   EXPECT_THROW(Queue::open(name), std::system_error);
+   EXPECT_FALSE(Queue::remove(name));
+}
+
+TEST(TestOfShmQueue, FifoFullAndEmpty) {
+   auto queue = shm_queue<uint64_t, 4>::create(unique_name("fifo"));
+   for (uint64_t value = 0; value < 4; ++value) {
+      ASSERT_TRUE(queue.try_push(value));
+   }
+   EXPECT_FALSE(queue.try_push(4));
+   EXPECT_EQ(4U, queue.size());
+
+   uint64_t popped = 0;
+   for (uint64_t lap = 0; lap < 3; ++lap) { // wraps around
+      for (uint64_t value = 0; value < 4; ++value) {
+         ASSERT_TRUE(queue.try_and_pop(popped));
+         EXPECT_EQ(value, popped);
+         ASSERT_TRUE(queue.try_push(value));
+      }
+   }
+   EXPECT_EQ(4U, queue.size());
+   EXPECT_TRUE(queue.wait_and_pop_for(popped, std::chrono::milliseconds(1)));
+}
+
+TEST(TestOfShmQueue, WaitTimesOut) {
+   auto queue = shm_queue<uint64_t, 4>::create(unique_name("timeout"));
+   uint64_t popped = 0;
+   auto start = std::chrono::steady_clock::now();
+   EXPECT_FALSE(queue.wait_and_pop_for(popped, std::chrono::milliseconds(30)));
+   EXPECT_GE(std::chrono::steady_clock::now() - start, std::chrono::milliseconds(30));
+}
+
+TEST(TestOfShmQueue, ThrowingFillSkipsTheSlot) {
+   auto queue = shm_queue<uint64_t, 4>::create(unique_name("throwing"));
+   EXPECT_THROW(queue.try_push_with([](uint64_t&) { throw std::runtime_error("oops"); }), std::runtime_error);
+   ASSERT_TRUE(queue.try_push(42));
+   uint64_t popped = 0;
+   ASSERT_TRUE(queue.try_and_pop(popped));
+   EXPECT_EQ(42U, popped);
+   EXPECT_EQ(1U, queue.skipped());
+}
+
+TEST(TestOfShmQueue, ProducerProcessesFeedAConsumer) {
+   const std::string name = unique_name("processes");
+   const uint32_t kProducers = 3;
+   const uint32_t kMessages = 5000;
+   std::vector<uint32_t> next(kProducers, 0);
+   bool in_order = true;
+   {
+      shm_consumer<Message, 64> consumer(shm_queue<Message, 64>::create(name), [&](const Message& message) {
+         in_order = in_order && (message.sequence == next[message.producer]);
+         ++next[message.producer];
+      });
+
+      std::vector<pid_t> children;
+      for (uint32_t producer = 0; producer < kProducers; ++producer) {
+         pid_t child = fork();
+         ASSERT_NE(-1, child);
+         if (0 == child) {
+            auto queue = shm_queue<Message, 64>::open(name);
+            for (uint32_t sequence = 0; sequence < kMessages; ++sequence) {
+               Message message{producer, sequence, "hello"};
+               queue.push(message); // the ring is much smaller than the messages: producers wait
+            }
+            _exit(0);
+         }
+         children.push_back(child);
+      }
+      for (auto child : children) {
+         EXPECT_EQ(0, wait_for_child(child));
+      }
+      while (consumer.consumed() < kProducers * kMessages) {
+         std::this_thread::sleep_for(std::chrono::milliseconds(1));
+      }
+   }
+   EXPECT_TRUE(in_order); // FIFO per producer
+   for (auto count : next) {
+      EXPECT_EQ(kMessages, count);
+   }
+}
+
+TEST(TestOfShmQueue, ProducerCrashingMidWriteIsSkipped) {
+   const std::string name = unique_name("crash");
+   auto queue = shm_queue<Message, 8>::create(name);
+   pid_t child = fork();
+   ASSERT_NE(-1, child);
+   if (0 == child) {
+      auto producer = shm_queue<Message, 8>::open(name);
+      producer.try_push_with([](Message& message) {
+         message.sequence = 1;
+         _exit(0); // dies after the claim, before the message is published
+      });
+      _exit(1);
+   }
+   EXPECT_EQ(0, wait_for_child(child));
+
+   Message message{0, 2, "after the crash"};
+   ASSERT_TRUE(queue.try_push(message));
+   EXPECT_EQ(2U, queue.size());
+
+   Message popped{};
+   ASSERT_TRUE(queue.wait_and_pop_for(popped, std::chrono::seconds(1)));
+   EXPECT_EQ(2U, popped.sequence);
+   EXPECT_EQ(std::string("after the crash"), popped.text);
+   EXPECT_EQ(1U, queue.skipped());
+   EXPECT_TRUE(queue.empty());
+}
+
+#endif // __linux__
@@ -0,0 +1,152 @@
+#include "spill_queue.hpp"
+
+#include <gtest/gtest.h>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <vector>
+#include <dirent.h>
+#include <unistd.h>
+
+#include "shared_queue.hpp"
+#include "test_helper.hpp"
+using namespace test_helper;
+
+namespace {
+   /// temporary directory, removed with its files at scope exit
+   struct TemporaryDirectory {
+      std::string path;
+      TemporaryDirectory() {
+         char name[] = "/tmp/spill_queue_test_XXXXXX";
+         path = mkdtemp(name);
+      }
+      ~TemporaryDirectory() {
+         for (auto& file : files()) {
+            unlink((path + "/" + file).c_str());
+         }
+         rmdir(path.c_str());
+      }
+      std::vector<std::string> files() const {
+         std::vector<std::string> names;
+         DIR* directory = opendir(path.c_str());
+         while (dirent* entry = readdir(directory)) {
+            std::string name = entry->d_name;
+            if (name != "." && name != "..") {
+               names.push_back(name);
+            }
+         }
+         closedir(directory);
+         return names;
+      }
+   };
+
+   spill_config small_config(const std::string& directory) {
+      spill_config config;
+      config.directory = directory;
+      config.memory_items = 10;
+      config.segment_bytes = 256;
+      return config;
+   }
+} // anonymous
+
+
+TEST(TestOfSpillQueue, StaysInMemoryBelowTheThreshold) {
+   TemporaryDirectory directory;
+   spill_queue<int> queue(small_config(directory.path));
+   for (int value = 0; value < 10; ++value) {
+      queue.push(value);
+   }
+   EXPECT_EQ(10U, queue.stats().in_memory);
+   EXPECT_EQ(0U, queue.stats().spilled);
+   EXPECT_TRUE(directory.files().empty());
+}
+
+TEST(TestOfSpillQueue, FifoAcrossMemoryAndDisk) {
+   TemporaryDirectory directory;
+   spill_queue<int> queue(small_config(directory.path));
+   int pushed = 0;
+   int popped = 0;
+   for (int round = 0; round < 5; ++round) {
+      for (int count = 0; count < 200; ++count) {
+         queue.push(pushed++);
+      }
+      auto stats = queue.stats();
+      EXPECT_LE(stats.in_memory, 10U); // bounded memory
+      EXPECT_EQ(static_cast<size_t>(pushed - popped), queue.size());
+      EXPECT_LT(1U, stats.segments);   // 256 byte segments
+      for (int count = 0; count < 150; ++count) {
+         ASSERT_EQ(popped++, queue.front());
+         queue.pop();
+      }
+   }
+   while (!queue.empty()) {
+      ASSERT_EQ(popped++, queue.front());
+      queue.pop();
+   }
+   EXPECT_EQ(pushed, popped);
+
+   auto stats = queue.stats();
+   EXPECT_EQ(stats.spilled, stats.refilled);
+   EXPECT_EQ(0U, stats.on_disk);
+   EXPECT_GT(stats.spill_rate, 0.0);
+   EXPECT_LE(directory.files().size(), 1U); // the last file is kept for the next spill
+   queue.shrink_to_fit();
+   EXPECT_TRUE(directory.files().empty());
+}
+
+TEST(TestOfSpillQueue, StringsAndRecordsLargerThanASegment) {
+   TemporaryDirectory directory;
+   spill_queue<std::string> queue(small_config(directory.path));
+   std::vector<std::string> expected;
+   for (size_t length = 0; length < 60; ++length) {
+      expected.push_back(std::string(length * 17, static_cast<char>('a' + length % 26)));
+      queue.push(expected.back());
+   }
+   EXPECT_EQ(50U, queue.stats().on_disk);
+   for (auto& text : expected) {
+      ASSERT_EQ(text, queue.front());
+      queue.pop();
+   }
+   EXPECT_TRUE(queue.empty());
+}
+
+TEST(TestOfSpillQueue, FilesAreDeletedWithTheQueue) {
+   TemporaryDirectory directory;
+   {
+      spill_queue<int> queue(small_config(directory.path));
+      for (int value = 0; value < 1000; ++value) {
+         queue.push(value);
+      }
+      EXPECT_FALSE(directory.files().empty());
+   }
+   EXPECT_TRUE(directory.files().empty());
+}
+
+TEST(TestOfSpillQueue, AsStorageForSharedQueue) {
+   TemporaryDirectory directory;
+   shared_queue<int, spill_queue<int>> queue{spill_queue<int>(small_config(directory.path))};
+   const int kItems = 10000;
+   std::thread producer([&] {
+      for (int value = 0; value < kItems; ++value) {
+         queue.push(value);
+      }
+   });
+   int value = -1;
+   for (int expected = 0; expected < kItems; ++expected) {
+      queue.wait_and_pop(value);
+      ASSERT_EQ(expected, value);
+   }
+   producer.join();
+   auto stats = queue.with_storage([](const spill_queue<int>& storage) { return storage.stats(); });
+   EXPECT_EQ(stats.spilled, stats.refilled);
+   EXPECT_TRUE(queue.empty());
+}
+
+TEST(TestOfSpillQueue, MissingDirectoryThrows) {
+   spill_queue<int> queue(small_config("/nonexistent/spill_queue_test"));
+   for (int value = 0; value < 10; ++value) {
+      queue.push(value);
+   }
+   EXPECT_THROW(queue.push(10), std::system_error);
+}
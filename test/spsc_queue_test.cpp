@@ -0,0 +1,121 @@
+#include "spsc_queue.hpp"
+
+#include <gtest/gtest.h>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include "concurrent.hpp"
+#include "test_helper.hpp"
+using namespace test_helper;
+
+TEST(TestOfSpscQueue, CompilerCheckForNoCopyConstructibleAndAssignable) {
+   static_assert(std::is_copy_constructible<spsc_queue<int>>::value == false,
+      "spsc queue can't be copied by constructor");
+   static_assert(std::is_copy_assignable<spsc_queue<int>>::value == false,
+      "spsc queue can't be copied by assignment operator");
+}
+
+TEST(TestOfSpscQueue, SingleProducerTagSelectsTheRing) {
+   static_assert(std::is_same<concurrent_helper::queue_type<single_producer>::type,
+                              spsc_queue<concurrent_helper::Callback>>::value, "tag selects spsc_queue");
+   static_assert(std::is_same<concurrent_helper::queue_type<shared_queue<int>>::type,
+                              shared_queue<int>>::value, "queue types are used as is");
+}
+
+TEST(TestOfSpscQueue, FifoAndFullRing) {
+   spsc_queue<std::string, 4> queue;
+   EXPECT_TRUE(queue.empty());
+   for (int value = 0; value < 4; ++value) {
+      std::string item = std::to_string(value);
+      ASSERT_TRUE(queue.try_push(item));
+      EXPECT_TRUE(item.empty()); // moved
+   }
+   std::string rejected{"rejected"};
+   EXPECT_FALSE(queue.try_push(rejected));
+   EXPECT_EQ("rejected", rejected);
+   EXPECT_EQ(4U, queue.size());
+
+   std::string value;
+   for (int expected = 0; expected < 4; ++expected) {
+      ASSERT_TRUE(queue.try_and_pop(value));
+      EXPECT_EQ(std::to_string(expected), value);
+   }
+   EXPECT_FALSE(queue.try_and_pop(value));
+   EXPECT_TRUE(queue.empty());
+}
+
+TEST(TestOfSpscQueue, ItemsLeftAreDestroyed) {
+   auto shared = std::make_shared<int>(1);
+   {
+      spsc_queue<std::shared_ptr<int>, 8> queue;
+      queue.push(shared);
+      queue.push(shared);
+      EXPECT_EQ(3, shared.use_count());
+   }
+   EXPECT_EQ(1, shared.use_count());
+}
+
+TEST(TestOfSpscQueue, ProducerAndSleepingConsumer) {
+   spsc_queue<int, 16> queue;
+   const int kItems = 100000;
+   std::thread producer{[&queue] {
+      std::this_thread::sleep_for(std::chrono::milliseconds(50)); // consumer goes to sleep
+      for (int value = 0; value < kItems; ++value) {
+         queue.push(value);
+      }
+   }};
+   int value{-1};
+   for (int expected = 0; expected < kItems; ++expected) {
+      queue.wait_and_pop(value);
+      ASSERT_EQ(expected, value);
+   }
+   producer.join();
+   EXPECT_TRUE(queue.empty());
+}
+
+TEST(TestOfSpscQueue, ProducerHandOverBetweenThreads) {
+   spsc_queue<int, 16> queue;
+   std::thread first{[&queue] { queue.push(1); }};
+   first.join();
+   std::thread second{[&queue] { queue.push(2); }};
+   second.join();
+   int value{0};
+   queue.wait_and_pop(value);
+   EXPECT_EQ(1, value);
+   queue.wait_and_pop(value);
+   EXPECT_EQ(2, value);
+}
+
+namespace {
+   struct Sum {
+      std::vector<int>& values;
+      explicit Sum(std::vector<int>& v) : values(v) {}
+      void add(int value) { values.push_back(value); }
+   };
+} // namespace
+
+TEST(TestOfSpscQueue, ConcurrentHelloWorld) {
+   concurrent<Greeting, single_producer> hello;
+   EXPECT_EQ("Hello World", hello.call(&Greeting::sayHello).get());
+}
+
+TEST(TestOfSpscQueue, ConcurrentWithSingleProducer) {
+   std::vector<int> values;
+   {
+      concurrent<Sum, single_producer> sum{values};
+      std::thread producer{[&sum] {
+         for (int value = 0; value < 10000; ++value) {
+            sum.fire(&Sum::add, value);
+         }
+      }};
+      producer.join();
+   }
+   ASSERT_EQ(10000U, values.size());
+   for (int value = 0; value < 10000; ++value) {
+      ASSERT_EQ(value, values[value]);
+   }
+}
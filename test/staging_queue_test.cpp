@@ -0,0 +1,131 @@
+#include "staging_queue.hpp"
+
+#include <gtest/gtest.h>
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include "concurrent.hpp"
+#include "test_helper.hpp"
+using namespace test_helper;
+
+namespace {
+   staging_config slow_window() {
+      staging_config config;
+      config.buffer_items = 4;
+      config.window = std::chrono::seconds(10);
+      return config;
+   }
+
+   struct Recorder {
+      std::map<int, std::vector<int>> received; // producer -> sequence numbers
+      void record(int producer, int sequence) { received[producer].push_back(sequence); }
+   };
+} // anonymous
+
+
+TEST(TestOfStagingQueue, CompilerCheckForNoCopyConstructibleAndAssignable) {
+   static_assert(std::is_copy_constructible<staging_queue<int>>::value == false,
+      "staging queue can't be copied by constructor");
+   static_assert(std::is_copy_assignable<staging_queue<int>>::value == false,
+      "staging queue can't be copied by assignment operator");
+}
+
+TEST(TestOfStagingQueue, FullBufferIsPublished) {
+   staging_queue<int> queue(slow_window());
+   queue.push(1);
+   queue.push(2);
+   queue.push(3);
+   EXPECT_EQ(3U, queue.size()); // staged
+   queue.push(4);               // full: published
+   EXPECT_EQ(4U, queue.size());
+   EXPECT_EQ(1U, queue.producers());
+   int value = 0;
+   for (int expected = 1; expected <= 4; ++expected) {
+      ASSERT_TRUE(queue.try_and_pop(value));
+      EXPECT_EQ(expected, value);
+   }
+   EXPECT_FALSE(queue.try_and_pop(value));
+   EXPECT_TRUE(queue.empty());
+}
+
+TEST(TestOfStagingQueue, FlushAndSweep) {
+   staging_queue<std::string> queue(slow_window());
+   queue.push("flushed");
+   queue.flush();
+
+   std::thread other([&] { queue.push("staged by another thread"); });
+   other.join(); // the exiting thread publishes its buffer
+
+   queue.push("swept");
+   std::string value;
+   ASSERT_TRUE(queue.try_and_pop(value));
+   EXPECT_EQ("flushed", value);
+   ASSERT_TRUE(queue.try_and_pop(value));
+   EXPECT_EQ("staged by another thread", value);
+   ASSERT_TRUE(queue.try_and_pop(value)); // the shared queue is empty: the consumer sweeps
+   EXPECT_EQ("swept", value);
+   EXPECT_EQ(1U, queue.producers());
+}
+
+TEST(TestOfStagingQueue, WaitingConsumerSweepsAStagedItem) {
+   staging_config config;
+   config.buffer_items = 1000;
+   config.window = std::chrono::milliseconds(5);
+   staging_queue<int> queue(config);
+   std::thread consumer([&] {
+      int value = 0;
+      queue.wait_and_pop(value); // sleeps without a timeout until the push
+      EXPECT_EQ(42, value);
+   });
+   std::this_thread::sleep_for(std::chrono::milliseconds(20));
+   queue.push(42); // neither full nor flushed
+   consumer.join();
+}
+
+TEST(TestOfStagingQueue, FifoPerProducerWithConcurrent) {
+   const int kProducers = 8;
+   const int kCalls = 5000;
+   std::map<int, std::vector<int>> received;
+   {
+      concurrent<Recorder, staging_queue<concurrent_helper::Callback>> recorder;
+      std::vector<std::thread> producers;
+      for (int producer = 0; producer < kProducers; ++producer) {
+         producers.emplace_back([&recorder, producer] {
+            for (int sequence = 0; sequence < kCalls; ++sequence) {
+               recorder.fire(&Recorder::record, producer, sequence);
+            }
+            if (producer % 2) {
+               recorder.flush();
+            }
+         });
+      }
+      for (auto& producer : producers) {
+         producer.join();
+      }
+      recorder.fire(&Recorder::record, kProducers, 0); // still staged at destruction
+      received = recorder.lambda([](Recorder& r) { return r.received; }).get();
+      EXPECT_EQ(kProducers + 1, static_cast<int>(received.size()));
+   }
+   for (int producer = 0; producer < kProducers; ++producer) {
+      ASSERT_EQ(static_cast<size_t>(kCalls), received[producer].size());
+      for (int sequence = 0; sequence < kCalls; ++sequence) {
+         ASSERT_EQ(sequence, received[producer][sequence]);
+      }
+   }
+}
+
+TEST(TestOfStagingQueue, NothingStrandedAtDestruction) {
+   std::atomic<int> calls{0};
+   {
+      concurrent<DummyObject, staging_queue<concurrent_helper::Callback>> object;
+      for (int call = 0; call < 10; ++call) {
+         object.lambda([&calls](DummyObject&) { ++calls; });
+      }
+   }
+   EXPECT_EQ(10, calls.load());
+}
@@ -0,0 +1,126 @@
+#include "stall_watchdog.hpp"
+
+#include <gtest/gtest.h>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "concurrent.hpp"
+#include "test_helper.hpp"
+using namespace test_helper;
+
+namespace {
+   struct Sleeper {
+      void sleep(int ms) { std::this_thread::sleep_for(std::chrono::milliseconds(ms)); }
+   };
+
+   /// thread safe collection of the watchdog reports
+   struct Reports {
+      std::mutex m;
+      std::vector<stall_report> reports;
+
+      std::function<void(const stall_report&)> collector() {
+         return [this](const stall_report& report) {
+            std::lock_guard<std::mutex> lock(m);
+            reports.push_back(report);
+         };
+      }
+      std::vector<stall_report> get() {
+         std::lock_guard<std::mutex> lock(m);
+         return reports;
+      }
+   };
+} // anonymous
+
+
+TEST(TestOfStallWatchdog, CallSiteTagsNest) {
+   EXPECT_EQ(nullptr, concurrent_helper::call_site_tag::current());
+   {
+      concurrent_helper::call_site_tag outer("outer");
+      EXPECT_STREQ("outer", concurrent_helper::call_site_tag::current());
+      {
+         concurrent_helper::call_site_tag inner("inner");
+         EXPECT_STREQ("inner", concurrent_helper::call_site_tag::current());
+      }
+      EXPECT_STREQ("outer", concurrent_helper::call_site_tag::current());
+   }
+   EXPECT_EQ(nullptr, concurrent_helper::call_site_tag::current());
+}
+
+TEST(TestOfStallWatchdog, ReportsTheSlowTaskOnce) {
+   Reports reports;
+   concurrent<Sleeper> sleeper;
+   {
+      stall_watchdog watchdog(std::chrono::milliseconds(30), reports.collector(), std::chrono::milliseconds(5));
+      watchdog.watch(sleeper);
+      sleeper.call(&Sleeper::sleep, 1).wait(); // fast, not reported
+      {
+         concurrent_helper::call_site_tag tag("Sleeper::sleep slow");
+         sleeper.fire(&Sleeper::sleep, 150);
+      }
+      for (int i = 0; i < 3; ++i) {
+         sleeper.fire(&Sleeper::sleep, 0);
+      }
+      sleeper.call(&Sleeper::sleep, 0).wait();
+      EXPECT_EQ(1U, watchdog.reported());
+   }
+   auto all = reports.get();
+   ASSERT_EQ(1U, all.size());
+   EXPECT_EQ(sleeper.instance_id(), all[0].instance);
+   EXPECT_STREQ("Sleeper::sleep slow", all[0].tag);
+   EXPECT_GE(all[0].running, std::chrono::milliseconds(30));
+   EXPECT_LT(all[0].running, std::chrono::milliseconds(150));
+   EXPECT_EQ(4U, all[0].queue_depth);
+}
+
+TEST(TestOfStallWatchdog, UntaggedTasksAndManyObjects) {
+   Reports reports;
+   concurrent<Sleeper> first;
+   concurrent<Sleeper> second;
+   EXPECT_NE(first.instance_id(), second.instance_id());
+
+   stall_watchdog watchdog(std::chrono::milliseconds(20), reports.collector(), std::chrono::milliseconds(5));
+   watchdog.watch(first);
+   watchdog.watch(second);
+   auto a = first.call(&Sleeper::sleep, 80);
+   auto b = second.call(&Sleeper::sleep, 80);
+   a.wait();
+   b.wait();
+   first.call(&Sleeper::sleep, 0).wait();
+   second.call(&Sleeper::sleep, 0).wait();
+
+   auto all = reports.get();
+   ASSERT_EQ(2U, all.size());
+   EXPECT_NE(all[0].instance, all[1].instance);
+   for (auto& report : all) {
+      EXPECT_EQ(nullptr, report.tag);
+      EXPECT_EQ(0U, report.queue_depth);
+   }
+}
+
+TEST(TestOfStallWatchdog, ObjectsAndWatchdogCanGoInAnyOrder) {
+   Reports reports;
+   stall_watchdog watchdog(std::chrono::milliseconds(10), reports.collector(), std::chrono::milliseconds(1));
+   {
+      concurrent<Sleeper> sleeper;
+      watchdog.watch(sleeper);
+      EXPECT_EQ(1U, watchdog.watched());
+      sleeper.fire(&Sleeper::sleep, 50);
+   } // waits for the call while it is watched
+   std::this_thread::sleep_for(std::chrono::milliseconds(20));
+   EXPECT_EQ(0U, watchdog.watched());
+   EXPECT_EQ(1U, reports.get().size());
+
+   concurrent<Sleeper> outliving;
+   {
+      stall_watchdog short_lived(std::chrono::milliseconds(10), reports.collector());
+      short_lived.watch(outliving);
+      EXPECT_TRUE(outliving.monitor()->watched());
+   }
+   EXPECT_FALSE(outliving.monitor()->watched());
+   outliving.call(&Sleeper::sleep, 20).wait();
+   EXPECT_EQ(1U, reports.get().size());
+}
@@ -1,6 +1,11 @@
 #include "std2_type_traits.hpp"
 
 #include <gtest/gtest.h>
+#include <functional>
+#include <memory>
+#include <string>
+
+#include "moveoncopy.hpp"
 
 namespace {
 struct NothrowMoveConstructible {
@@ -22,8 +27,28 @@ struct ThrowMoveAssignable {
       return *this;
    }
 };
+
+struct Handle {
+   int* resource;
+   Handle() : resource(nullptr) {}
+   Handle(Handle&& other) : resource(other.resource) { other.resource = nullptr; }
+   ~Handle() { delete resource; }
+};
+
+/// knows its own address, must be moved with its move operations
+struct SelfPointing {
+   SelfPointing* self;
+   int value;
+   explicit SelfPointing(int v = 0) : self(this), value(v) {}
+   SelfPointing(SelfPointing&& other) : self(this), value(other.value) {}
+   SelfPointing& operator=(SelfPointing&& other) { value = other.value; return *this; }
+};
 } // namespace
 
+namespace std2 {
+   template<> struct is_trivially_relocatable<Handle> : std::true_type {};
+}
+
 
 TEST(TestOfStdTypeTraits, CompilerCheckForNothrowMoveConstructible) {
    static_assert(std2::is_nothrow_move_constructible_v<NothrowMoveConstructible>,
@@ -39,4 +64,40 @@ TEST(TestOfStdTypeTraits, CompilerCheckForNothrowMoveAssignable) {
       "ThrowMoveAssignable has throwing move assignment operator");
 }
 
+TEST(TestOfStdTypeTraits, CompilerCheckForTriviallyRelocatable) {
+   static_assert(std2::is_trivially_relocatable_v<int>, "trivially copyable");
+   static_assert(std2::is_trivially_relocatable_v<std::unique_ptr<int>>, "unique_ptr opts in");
+   static_assert(std2::is_trivially_relocatable_v<std::shared_ptr<int>>, "shared_ptr opts in");
+   static_assert(std2::is_trivially_relocatable_v<Handle>, "Handle opts in");
+   static_assert(std2::is_trivially_relocatable_v<MoveOnCopy<Handle>>, "relocates like what it wraps");
+   static_assert(std2::is_trivially_relocatable_v<SelfPointing> == false, "points into itself");
+   static_assert(std2::is_trivially_relocatable_v<MoveOnCopy<SelfPointing>> == false, "relocates like what it wraps");
+#if defined(__GLIBCXX__)
+   static_assert(std2::is_trivially_relocatable_v<std::function<void()>>, "libstdc++ std::function opts in");
+#endif
+}
+
+TEST(TestOfStdTypeTraits, RelocateAssign) {
+   std::aligned_storage<sizeof(Handle), alignof(Handle)>::type handle_storage;
+   Handle* from = ::new (&handle_storage) Handle;
+   from->resource = new int(42);
+   Handle to;
+   to.resource = new int(1);
+   std2::relocate_assign(to, *from); // frees the old resource of 'to', *from is gone
+   ASSERT_TRUE(nullptr != to.resource);
+   EXPECT_EQ(42, *to.resource);
 
+   std::aligned_storage<sizeof(SelfPointing), alignof(SelfPointing)>::type storage;
+   SelfPointing* source = ::new (&storage) SelfPointing(7);
+   SelfPointing target;
+   std2::relocate_assign(target, *source);
+   EXPECT_EQ(7, target.value);
+   EXPECT_EQ(&target, target.self);
+
+   std::function<std::string()> task = [] { return std::string("relocated"); };
+   std::aligned_storage<sizeof(task), alignof(std::function<std::string()>)>::type task_storage;
+   auto* queued = ::new (&task_storage) std::function<std::string()>(std::move(task));
+   std::function<std::string()> popped;
+   std2::relocate_assign(popped, *queued);
+   EXPECT_EQ("relocated", popped());
+}
@@ -0,0 +1,100 @@
+#include "wait_frame.hpp"
+
+#include <gtest/gtest.h>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "concurrent.hpp"
+#include "test_helper.hpp"
+using namespace test_helper;
+
+namespace {
+   struct Account {
+      int balance = 0;
+      std::vector<std::string> log;
+      void deposit(int amount) { balance += amount; }
+      int withdraw(int amount) {
+         if (amount > balance) {
+            throw std::runtime_error("insufficient funds");
+         }
+         balance -= amount;
+         return balance;
+      }
+      void note(const std::string& text) { log.push_back(text); }
+      std::unique_ptr<int> snapshot() { return std::unique_ptr<int>(new int(balance)); }
+      int& balance_ref() { return balance; }
+   };
+} // anonymous
+
+
+TEST(TestOfCallAndWait, ReturnsTheValueAfterTheQueuedCalls) {
+   concurrent<Account> account;
+   for (int deposit = 0; deposit < 100; ++deposit) {
+      account.fire(&Account::deposit, 10);
+   }
+   EXPECT_EQ(990, account.call_and_wait(&Account::withdraw, 10));
+   EXPECT_EQ(990, account.lambda_and_wait([](Account& a) { return a.balance; }));
+}
+
+TEST(TestOfCallAndWait, VoidMoveOnlyAndReferenceResults) {
+   concurrent<Account> account;
+   const std::string text = "opened";
+   account.call_and_wait(&Account::note, text);
+   EXPECT_EQ(std::vector<std::string>{"opened"}, account.lambda_and_wait([](Account& a) { return a.log; }));
+
+   std::unique_ptr<int> snapshot = account.call_and_wait(&Account::snapshot);
+   ASSERT_TRUE(nullptr != snapshot);
+   EXPECT_EQ(0, *snapshot);
+
+   int& balance = account.call_and_wait(&Account::balance_ref);
+   EXPECT_EQ(&balance, &account.lambda_and_wait([](Account& a) -> int& { return a.balance; }));
+}
+
+TEST(TestOfCallAndWait, TaggedAndRecordedRoundTrips) {
+   concurrent<Account> account;
+   workload_recorder recorder;
+   account.start_recording(recorder);
+   {
+      concurrent_helper::call_site_tag tag("Account::deposit");
+      account.call_and_wait(&Account::deposit, 5);
+   }
+   EXPECT_EQ(5, account.lambda_and_wait([](Account& a) { return a.balance; }));
+   account.stop_recording();
+
+   workload recorded = recorder.recorded();
+   ASSERT_EQ(2U, recorded.records.size());
+   ASSERT_EQ(2U, recorded.tags.size());
+   EXPECT_EQ("Account::deposit", recorded.tags[recorded.records[0].tag]);
+   EXPECT_EQ(0U, recorded.records[1].tag);
+   EXPECT_EQ(workload_recorder::producer_id(), recorded.records[0].producer);
+}
+
+TEST(TestOfCallAndWait, RethrowsTheException) {
+   concurrent<Account> account;
+   EXPECT_THROW(account.call_and_wait(&Account::withdraw, 1), std::runtime_error);
+   EXPECT_THROW(account.lambda_and_wait([](Account&) { throw std::logic_error("oops"); }), std::logic_error);
+   EXPECT_EQ(0, account.call_and_wait(&Account::withdraw, 0)); // still serving
+
+   concurrent<Account> empty{std::unique_ptr<Account>()};
+   EXPECT_THROW(empty.call_and_wait(&Account::withdraw, 0), std::runtime_error);
+}
+
+TEST(TestOfCallAndWait, ManyCallersSleepAndWake) {
+   concurrent<Account> account;
+   std::vector<std::thread> callers;
+   for (int caller = 0; caller < 8; ++caller) {
+      callers.emplace_back([&account] {
+         for (int round = 0; round < 1000; ++round) {
+            account.call_and_wait(&Account::deposit, 1);
+         }
+      });
+   }
+   account.lambda_and_wait([](Account&) { std::this_thread::sleep_for(std::chrono::milliseconds(5)); }); // callers go to sleep
+   for (auto& caller : callers) {
+      caller.join();
+   }
+   EXPECT_EQ(8000, account.call_and_wait(&Account::withdraw, 0));
+}
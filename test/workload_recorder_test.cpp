@@ -0,0 +1,201 @@
+#include "workload_recorder.hpp"
+
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <set>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <unistd.h>
+
+#include "concurrent.hpp"
+#include "workload_replay.hpp"
+#include "test_helper.hpp"
+using namespace test_helper;
+
+namespace {
+   struct Account {
+      int balance = 0;
+      void deposit(int amount) { balance += amount; }
+      void audit() { std::this_thread::sleep_for(std::chrono::milliseconds(2)); }
+   };
+
+   /// temporary file, removed at scope exit
+   struct TempFile {
+      std::string path;
+      TempFile() {
+         char name[] = "/tmp/workload_recorder_test_XXXXXX";
+         close(mkstemp(name));
+         path = name;
+      }
+      ~TempFile() { std::remove(path.c_str()); }
+   };
+
+   workload regular(size_t producers, size_t calls, long long gap_ns, long long service_ns) {
+      workload w;
+      w.tags.push_back("tick");
+      for (size_t call = 0; call < calls; ++call) {
+         for (uint32_t producer = 0; producer < producers; ++producer) {
+            w.records.push_back(workload_record{call * gap_ns, static_cast<uint64_t>(service_ns), producer, 1});
+         }
+      }
+      return w;
+   }
+} // anonymous
+
+
+TEST(TestOfWorkloadRecorder, RecordsTagProducerAndServiceTime) {
+   concurrent<Account> account;
+   workload_recorder recorder;
+   account.start_recording(recorder);
+   {
+      concurrent_helper::call_site_tag tag("audit");
+      account.fire(&Account::audit);
+   }
+   std::thread other([&account] { account.fire(&Account::deposit, 1); });
+   other.join();
+   account.stop_recording();
+   account.fire(&Account::deposit, 1); // not recorded
+
+   workload recorded = recorder.recorded();
+   ASSERT_EQ(2U, recorded.records.size());
+   ASSERT_EQ(2U, recorded.tags.size());
+   EXPECT_EQ("audit", recorded.tags[1]);
+
+   const workload_record& audit = recorded.records[0];
+   const workload_record& deposit = recorded.records[1];
+   EXPECT_EQ(1U, audit.tag);
+   EXPECT_EQ(0U, deposit.tag);
+   EXPECT_EQ(workload_recorder::producer_id(), audit.producer);
+   EXPECT_NE(audit.producer, deposit.producer);
+   EXPECT_LE(audit.submit_ns, deposit.submit_ns);
+   EXPECT_LE(2000000U, audit.service_ns);
+   EXPECT_GT(2000000U, deposit.service_ns);
+}
+
+TEST(TestOfWorkloadRecorder, MaxRecordsAreKept) {
+   concurrent<Account> account;
+   workload_recorder recorder(10);
+   account.start_recording(recorder);
+   for (int call = 0; call < 25; ++call) {
+      account.fire(&Account::deposit, 1);
+   }
+   account.stop_recording();
+   EXPECT_EQ(10U, recorder.recorded().records.size());
+   EXPECT_EQ(15U, recorder.missed());
+}
+
+TEST(TestOfWorkloadRecorder, SaveAndLoad) {
+   TempFile file;
+   workload saved = regular(3, 100, 1000, 500);
+   saved.tags.push_back("other");
+   saved.records[7].tag = 2;
+   saved.save(file.path);
+
+   workload loaded = workload::load(file.path);
+   EXPECT_EQ(saved.tags, loaded.tags);
+   ASSERT_EQ(saved.records.size(), loaded.records.size());
+   for (size_t index = 0; index < saved.records.size(); ++index) {
+      EXPECT_EQ(saved.records[index].submit_ns, loaded.records[index].submit_ns);
+      EXPECT_EQ(saved.records[index].service_ns, loaded.records[index].service_ns);
+      EXPECT_EQ(saved.records[index].producer, loaded.records[index].producer);
+      EXPECT_EQ(saved.records[index].tag, loaded.records[index].tag);
+   }
+}
+
+TEST(TestOfWorkloadRecorder, LoadRejectsOtherFiles) {
+   TempFile file;
+   {
+      std::ofstream out(file.path);
+      out << "not a workload";
+   }
+   EXPECT_THROW(workload::load(file.path), std::runtime_error);
+   EXPECT_THROW(workload::load(file.path + ".missing"), std::runtime_error);
+
+   regular(1, 10, 0, 0).save(file.path);
+   truncate(file.path.c_str(), 40);
+   EXPECT_THROW(workload::load(file.path), std::runtime_error);
+}
+
+namespace {
+   /// overwrite the bytes at offset in a saved file
+   template<typename Value>
+   void patch(const std::string& path, std::streamoff offset, Value value) {
+      std::fstream file(path, std::ios::binary | std::ios::in | std::ios::out);
+      file.seekp(offset);
+      file.write(reinterpret_cast<const char*>(&value), sizeof(value));
+   }
+} // anonymous
+
+TEST(TestOfWorkloadRecorder, LoadChecksCountsAgainstTheFileSize) {
+   TempFile file;
+   // magic, tag count 2, tag "" (4), tag "tick" (4 + 4), record count at 20, records at 28
+   regular(1, 10, 0, 0).save(file.path);
+   patch(file.path, 20, uint64_t(1) << 60); // would be an allocation of exabytes
+   EXPECT_THROW(workload::load(file.path), std::runtime_error);
+
+   regular(1, 10, 0, 0).save(file.path);
+   patch(file.path, 12, uint32_t(0xffffffff)); // length of "tick"
+   EXPECT_THROW(workload::load(file.path), std::runtime_error);
+
+   regular(1, 10, 0, 0).save(file.path);
+   patch(file.path, 4, uint32_t(0xffffffff)); // tag count
+   EXPECT_THROW(workload::load(file.path), std::runtime_error);
+
+   regular(1, 10, 0, 0).save(file.path);
+   truncate(file.path.c_str(), 28 + 9 * sizeof(workload_record)); // one record short
+   EXPECT_THROW(workload::load(file.path), std::runtime_error);
+
+   regular(1, 10, 0, 0).save(file.path);
+   patch(file.path, 28 + 20, uint32_t(2)); // the first record's tag, there are 2 tags
+   EXPECT_THROW(workload::load(file.path), std::runtime_error);
+
+   workload unknown_tag = regular(1, 10, 0, 0);
+   unknown_tag.records[3].tag = 7;
+   EXPECT_THROW(replay(unknown_tag), std::runtime_error);
+}
+
+TEST(TestOfWorkloadReplay, RejectsSpeedsThatAreNotPositiveOrTooSmall) {
+   EXPECT_THROW(replay(regular(1, 10, 0, 0), 0.0), std::invalid_argument);
+   EXPECT_THROW(replay(regular(1, 10, 0, 0), -1.0), std::invalid_argument);
+   EXPECT_THROW(replay(regular(1, 10, 0, 0), std::nan("")), std::invalid_argument);
+   EXPECT_THROW(replay(regular(1, 10, 1000000, 0), 1e-300), std::invalid_argument);
+}
+
+TEST(TestOfWorkloadReplay, KeepsArrivalsAndServiceTimes) {
+   const long long kGap = 2000000;
+   const long long kService = 200000;
+   workload recorded = regular(2, 20, kGap, kService);
+   replay_result result = replay(recorded);
+
+   ASSERT_EQ(recorded.records.size(), result.latency_ns.size());
+   for (long long latency : result.latency_ns) {
+      EXPECT_LE(kService, latency);
+   }
+   EXPECT_LE(19 * kGap, std::chrono::duration_cast<std::chrono::nanoseconds>(result.elapsed).count());
+}
+
+TEST(TestOfWorkloadReplay, ReplayedCallsCanBeRecordedAgain) {
+   workload recorded = regular(2, 50, 1000000, 1000);
+   workload_recorder recorder;
+   {
+      concurrent<Account> account;
+      account.start_recording(recorder);
+      for (auto& record : recorded.records) {
+         concurrent_helper::call_site_tag tag(recorded.tags[record.tag].c_str());
+         account.fire(&Account::deposit, 1);
+      }
+      account.stop_recording();
+   }
+   workload again = recorder.recorded();
+   EXPECT_EQ(recorded.records.size(), again.records.size());
+   EXPECT_TRUE(std::find(again.tags.begin(), again.tags.end(), "tick") != again.tags.end());
+
+   replay_result fast = replay(recorded, 10.0);
+   EXPECT_GT(std::chrono::duration_cast<std::chrono::nanoseconds>(fast.elapsed).count(), 0);
+   EXPECT_GT(49 * 1000000LL, std::chrono::duration_cast<std::chrono::nanoseconds>(fast.elapsed).count());
+}